@@ -0,0 +1,80 @@
+#pragma once
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replaces the global allocation functions so that benchmarks can
+ * report how many heap allocations each iteration makes.
+ * 
+ * This must only be included by a single translation unit
+ * in each benchmark executable.
+ */
+namespace allocation_counter
+{
+	std::atomic<size_t> g_allocations(0);
+	std::atomic<size_t> g_allocated_bytes(0);
+
+	/**
+	 * Captures the counters when constructed, and reports the
+	 * difference per iteration to a benchmark's state.
+	 */
+	class Scope
+	{
+	public:
+		Scope()
+		{
+			m_allocations = g_allocations.load();
+			m_allocated_bytes = g_allocated_bytes.load();
+		}
+
+		void report(benchmark::State &state) const
+		{
+			state.counters["allocs/op"] = benchmark::Counter(
+				static_cast<double>(g_allocations.load() - m_allocations),
+				benchmark::Counter::kAvgIterations);
+			state.counters["alloc_bytes/op"] = benchmark::Counter(
+				static_cast<double>(g_allocated_bytes.load() - m_allocated_bytes),
+				benchmark::Counter::kAvgIterations);
+		}
+	private:
+		size_t m_allocations;
+		size_t m_allocated_bytes;
+	};
+}
+
+void *operator new(std::size_t size)
+{
+	allocation_counter::g_allocations.fetch_add(1, std::memory_order_relaxed);
+	allocation_counter::g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	void *ptr = std::malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <fstream>
+#include <string>
+
+/**
+ * Writes a DML module file shaped like the modules shipped with the
+ * game: a _ProtocolInfo record followed by message_count templates,
+ * each with the usual metadata and a mix of payload fields.
+ */
+inline void write_bench_module(const std::string &filepath,
+	const int message_count, const int service_id = 5)
+{
+	std::ofstream ofs(filepath);
+	ofs << "<BenchMessages>\n";
+	ofs << "\t<_ProtocolInfo>\n\t\t<RECORD>\n";
+	ofs << "\t\t\t<ServiceID TYPE=\"UBYT\">" << service_id << "</ServiceID>\n";
+	ofs << "\t\t\t<ProtocolType TYPE=\"STR\">BENCH" << service_id << "</ProtocolType>\n";
+	ofs << "\t\t\t<ProtocolVersion TYPE=\"INT\">1</ProtocolVersion>\n";
+	ofs << "\t\t\t<ProtocolDescription TYPE=\"STR\">Benchmark Messages</ProtocolDescription>\n";
+	ofs << "\t\t</RECORD>\n\t</_ProtocolInfo>\n";
+
+	for (int i = 0; i < message_count; ++i)
+	{
+		const std::string name = "MSG_BENCH_" + std::to_string(i);
+		ofs << "\t<" << name << ">\n\t\t<RECORD>\n";
+		ofs << "\t\t\t<_MsgName TYPE=\"STR\" NOXFER=\"TRUE\">" << name << "</_MsgName>\n";
+		ofs << "\t\t\t<_MsgDescription TYPE=\"STR\" NOXFER=\"TRUE\">Benchmark message " << i << "</_MsgDescription>\n";
+		ofs << "\t\t\t<_MsgHandler TYPE=\"STR\" NOXFER=\"TRUE\">MSG_Bench" << i << "</_MsgHandler>\n";
+		ofs << "\t\t\t<_MsgAccessLvl TYPE=\"UBYT\" NOXFER=\"TRUE\">0</_MsgAccessLvl>\n";
+		ofs << "\t\t\t<ZoneID TYPE=\"UINT\">305419896</ZoneID>\n";
+		ofs << "\t\t\t<GlobalID TYPE=\"GID\">1234605616436508552</GlobalID>\n";
+		ofs << "\t\t\t<LocationX TYPE=\"FLT\">1.5</LocationX>\n";
+		ofs << "\t\t\t<LocationY TYPE=\"FLT\">-2.5</LocationY>\n";
+		ofs << "\t\t\t<LocationZ TYPE=\"FLT\">100</LocationZ>\n";
+		ofs << "\t\t\t<Direction TYPE=\"SHRT\">180</Direction>\n";
+		ofs << "\t\t\t<Flags TYPE=\"UBYT\">3</Flags>\n";
+		ofs << "\t\t\t<ZoneName TYPE=\"STR\">WizardCity/WC_Hub</ZoneName>\n";
+		ofs << "\t\t\t<DisplayName TYPE=\"WSTR\">Merle Ambrose</DisplayName>\n";
+		ofs << "\t\t\t<Health TYPE=\"INT\">1250</Health>\n";
+		ofs << "\t\t</RECORD>\n\t</" << name << ">\n";
+	}
+	ofs << "</BenchMessages>\n";
+}
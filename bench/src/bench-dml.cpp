@@ -0,0 +1,249 @@
+#include "AllocationCounter.h"
+#include <ki/dml/Record.h>
+#include <ki/util/Arena.h>
+#include <sstream>
+
+using namespace ki::dml;
+
+namespace
+{
+	// Sample values to encode for each DML type
+	template <typename ValueT>
+	ValueT sample_value() { return ValueT(0x7F); }
+
+	template <>
+	STR sample_value<STR>() { return "The quick brown fox jumps over the lazy dog"; }
+
+	template <>
+	WSTR sample_value<WSTR>() { return u"The quick brown fox jumps over the lazy dog"; }
+
+	template <>
+	FLT sample_value<FLT>() { return 3.14159f; }
+
+	template <>
+	DBL sample_value<DBL>() { return 3.141592653589793; }
+
+	/**
+	 * Builds a record with a mix of field types, similar
+	 * to a typical game message.
+	 */
+	void populate_record(Record &record)
+	{
+		record.add_field<UINT>("m_zoneID")->set_value(0x12345678);
+		record.add_field<GID>("m_globalID")->set_value(0x1122334455667788);
+		record.add_field<FLT>("m_locationX")->set_value(1.5f);
+		record.add_field<FLT>("m_locationY")->set_value(-2.5f);
+		record.add_field<FLT>("m_locationZ")->set_value(100.0f);
+		record.add_field<SHRT>("m_direction")->set_value(180);
+		record.add_field<UBYT>("m_flags")->set_value(3);
+		record.add_field<STR>("m_zoneName")->set_value("WizardCity/WC_Hub");
+		record.add_field<WSTR>("m_displayName")->set_value(u"Merle Ambrose");
+		record.add_field<INT>("m_health")->set_value(1250);
+		record.add_field<USHRT>("m_level")->set_value(60);
+		record.add_field<DBL>("m_timestamp")->set_value(1234567.891);
+	}
+}
+
+template <typename ValueT>
+static void BM_Field_Encode(benchmark::State &state)
+{
+	Record record;
+	auto *field = record.add_field<ValueT>("TestField");
+	field->set_value(sample_value<ValueT>());
+
+	std::ostringstream oss;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		oss.seekp(0);
+		field->write_to(oss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * field->get_size());
+}
+
+template <typename ValueT>
+static void BM_Field_Decode(benchmark::State &state)
+{
+	Record record;
+	auto *field = record.add_field<ValueT>("TestField");
+	field->set_value(sample_value<ValueT>());
+
+	std::ostringstream oss;
+	field->write_to(oss);
+	std::istringstream iss(oss.str());
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		iss.seekg(0);
+		field->read_from(iss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * field->get_size());
+}
+
+template <typename ValueT>
+static void BM_Field_ToString(benchmark::State &state)
+{
+	Record record;
+	auto *field = record.add_field<ValueT>("TestField");
+	field->set_value(sample_value<ValueT>());
+
+	std::string buffer;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		buffer.clear();
+		field->append_value_string(buffer);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	allocations.report(state);
+}
+
+template <typename ValueT>
+static void BM_Field_FromString(benchmark::State &state)
+{
+	Record record;
+	auto *field = record.add_field<ValueT>("TestField");
+	field->set_value(sample_value<ValueT>());
+	const std::string value = field->get_value_string();
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+		field->set_value_from_string(value.data(), value.data() + value.length());
+	allocations.report(state);
+}
+
+#define KI_BENCHMARK_FIELD(type) \
+	BENCHMARK_TEMPLATE(BM_Field_Encode, type); \
+	BENCHMARK_TEMPLATE(BM_Field_Decode, type); \
+	BENCHMARK_TEMPLATE(BM_Field_ToString, type); \
+	BENCHMARK_TEMPLATE(BM_Field_FromString, type)
+
+KI_BENCHMARK_FIELD(BYT);
+KI_BENCHMARK_FIELD(UBYT);
+KI_BENCHMARK_FIELD(SHRT);
+KI_BENCHMARK_FIELD(USHRT);
+KI_BENCHMARK_FIELD(INT);
+KI_BENCHMARK_FIELD(UINT);
+KI_BENCHMARK_FIELD(STR);
+KI_BENCHMARK_FIELD(WSTR);
+KI_BENCHMARK_FIELD(FLT);
+KI_BENCHMARK_FIELD(DBL);
+KI_BENCHMARK_FIELD(GID);
+
+static void BM_Record_Copy(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		Record copy(record);
+		benchmark::DoNotOptimize(copy.get_field_count());
+	}
+	allocations.report(state);
+}
+BENCHMARK(BM_Record_Copy);
+
+static void BM_Record_CopyIntoArena(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	ki::util::Arena arena;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		auto *copy = arena.create<Record>(record, &arena);
+		benchmark::DoNotOptimize(copy->get_field_count());
+		arena.reset();
+	}
+	allocations.report(state);
+}
+BENCHMARK(BM_Record_CopyIntoArena);
+
+static void BM_Record_Serialize(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	std::ostringstream oss;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		oss.seekp(0);
+		record.write_to(oss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * record.get_size());
+}
+BENCHMARK(BM_Record_Serialize);
+
+static void BM_Record_Deserialize(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	std::ostringstream oss;
+	record.write_to(oss);
+	std::istringstream iss(oss.str());
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		iss.seekg(0);
+		record.read_from(iss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * record.get_size());
+}
+BENCHMARK(BM_Record_Deserialize);
+
+static void BM_Record_GetSize(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(record.get_size());
+}
+BENCHMARK(BM_Record_GetSize);
+
+static void BM_Record_AsXml(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	// This only builds the document; printing it would cost more
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		rapidxml::xml_document<> doc;
+		doc.append_node(record.as_xml(doc));
+		benchmark::DoNotOptimize(doc.first_node());
+	}
+	allocations.report(state);
+}
+BENCHMARK(BM_Record_AsXml);
+
+static void BM_Record_WriteXml(benchmark::State &state)
+{
+	Record record;
+	populate_record(record);
+
+	std::string buffer;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		buffer.clear();
+		record.write_xml(buffer);
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	allocations.report(state);
+}
+BENCHMARK(BM_Record_WriteXml);
+
+BENCHMARK_MAIN();
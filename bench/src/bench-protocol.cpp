@@ -0,0 +1,267 @@
+#include "AllocationCounter.h"
+#include "BenchModule.h"
+#include <ki/protocol/dml/MessageManager.h>
+#include <ki/protocol/net/Session.h>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace ki::protocol;
+
+namespace
+{
+	const char *bench_module_path = "bench-module.xml";
+	const int bench_module_size = 200;
+
+	/**
+	 * A session with a transport that discards everything, so that
+	 * only framing and serialization are measured.
+	 */
+	class BenchSession : public net::Session
+	{
+	public:
+		size_t packets_received = 0;
+
+		bool is_alive() const override { return true; }
+
+		void receive(const char *data, const size_t size)
+		{
+			process_data(data, size);
+		}
+	protected:
+		void on_application_message(const net::PacketHeader &) override
+		{
+			packets_received++;
+		}
+
+		void send_packet_data(const char *data, const size_t) override
+		{
+			benchmark::DoNotOptimize(data);
+		}
+
+		void close(net::SessionCloseErrorCode) override {}
+	};
+
+	/**
+	 * A manager with the benchmark module loaded, shared between benchmarks.
+	 */
+	const dml::MessageManager &get_manager()
+	{
+		static dml::MessageManager *manager = nullptr;
+		if (!manager)
+		{
+			write_bench_module(bench_module_path, bench_module_size);
+			manager = new dml::MessageManager();
+			manager->load_module(bench_module_path);
+		}
+		return *manager;
+	}
+
+	std::string serialize_message(const dml::Message &message)
+	{
+		std::ostringstream oss;
+		message.write_to(oss);
+		return oss.str();
+	}
+}
+
+static void BM_MessageManager_LoadModule(benchmark::State &state)
+{
+	get_manager();
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		dml::MessageManager manager;
+		benchmark::DoNotOptimize(manager.load_module(bench_module_path));
+	}
+	allocations.report(state);
+	state.SetItemsProcessed(state.iterations() * bench_module_size);
+}
+BENCHMARK(BM_MessageManager_LoadModule)->Unit(benchmark::kMillisecond);
+
+static void BM_MessageManager_LoadModuleLazily(benchmark::State &state)
+{
+	get_manager();
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		dml::MessageManager manager;
+		manager.set_load_templates_lazily(true);
+		benchmark::DoNotOptimize(manager.load_module(bench_module_path));
+	}
+	allocations.report(state);
+	state.SetItemsProcessed(state.iterations() * bench_module_size);
+}
+BENCHMARK(BM_MessageManager_LoadModuleLazily)->Unit(benchmark::kMillisecond);
+
+static ki::dml::Record *create_bench_record(const int value)
+{
+	auto *record = new ki::dml::Record();
+	record->add_field<ki::dml::INT>("Value")->set_value(value);
+	return record;
+}
+
+static void BM_MessageModule_AddTemplates(benchmark::State &state)
+{
+	for (auto _ : state)
+	{
+		dml::MessageModule module(5, "BENCH");
+		for (int i = 0; i < state.range(0); ++i)
+			module.add_message_template("MSG_BENCH_" + std::to_string(i), create_bench_record(i));
+		benchmark::DoNotOptimize(module.get_message_template(1));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MessageModule_AddTemplates)->Arg(50)->Arg(250);
+
+static void BM_MessageModuleBuilder_Build(benchmark::State &state)
+{
+	for (auto _ : state)
+	{
+		dml::MessageModuleBuilder builder(5, "BENCH");
+		for (int i = 0; i < state.range(0); ++i)
+			builder.add_message_template("MSG_BENCH_" + std::to_string(i), create_bench_record(i));
+		std::unique_ptr<dml::MessageModule> module(builder.build());
+		benchmark::DoNotOptimize(module->get_message_template(1));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MessageModuleBuilder_Build)->Arg(50)->Arg(250);
+
+static void BM_MessageManager_MessageFromBinary(benchmark::State &state)
+{
+	const auto &manager = get_manager();
+	auto *message = manager.create_message("BENCH5", "MSG_BENCH_100");
+	const auto data = serialize_message(*message);
+	delete message;
+
+	std::istringstream iss(data);
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		iss.clear();
+		iss.seekg(0);
+		delete manager.message_from_binary(iss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_MessageManager_MessageFromBinary);
+
+/**
+ * Decodes a buffer of 4096 messages, in runs of 8 with the same type,
+ * using a pool of state.range(0) threads (or no pool if 0).
+ */
+static void BM_MessageManager_DecodeBatch(benchmark::State &state)
+{
+	const auto &manager = get_manager();
+	const size_t message_count = 4096;
+	std::ostringstream oss;
+	for (size_t i = 0; i < message_count; ++i)
+	{
+		const auto name = "MSG_BENCH_" + std::to_string((i / 8) % bench_module_size);
+		auto *message = manager.create_message("BENCH5", name);
+		message->write_to(oss);
+		delete message;
+	}
+	const auto data = oss.str();
+
+	std::unique_ptr<ki::util::WorkStealingPool> pool;
+	if (state.range(0) > 0)
+		pool.reset(new ki::util::WorkStealingPool(state.range(0)));
+
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		const auto messages = manager.decode_batch(data.data(), data.size(), pool.get());
+		if (messages.size() != message_count)
+			state.SkipWithError("Decoded the wrong number of messages");
+		for (auto it = messages.begin(); it != messages.end(); ++it)
+			delete *it;
+	}
+	allocations.report(state);
+	state.SetItemsProcessed(state.iterations() * message_count);
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_MessageManager_DecodeBatch)->Arg(0)->Arg(4)->UseRealTime();
+
+static void BM_Message_Serialize(benchmark::State &state)
+{
+	const auto &manager = get_manager();
+	auto *message = manager.create_message("BENCH5", "MSG_BENCH_100");
+
+	std::ostringstream oss;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		oss.seekp(0);
+		message->write_to(oss);
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * message->get_size());
+	delete message;
+}
+BENCHMARK(BM_Message_Serialize);
+
+static void BM_Session_SendPacket(benchmark::State &state)
+{
+	const auto &manager = get_manager();
+	auto *message = manager.create_message("BENCH5", "MSG_BENCH_100");
+
+	BenchSession session;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+		session.send_packet(false, 0, *message);
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * (message->get_size() + 8));
+	delete message;
+}
+BENCHMARK(BM_Session_SendPacket);
+
+/**
+ * Frames packets through process_data, delivering the input
+ * in chunks of state.range(0) bytes.
+ */
+static void BM_Session_ProcessData(benchmark::State &state)
+{
+	const auto &manager = get_manager();
+	auto *message = manager.create_message("BENCH5", "MSG_BENCH_100");
+	const auto payload = serialize_message(*message);
+	delete message;
+
+	// Frame 64 copies of the message into one buffer
+	std::vector<char> input;
+	for (int i = 0; i < 64; ++i)
+	{
+		const size_t size = payload.size() + 4;
+		const char frame_header[] = {
+			'\x0D', '\xF0',
+			static_cast<char>(size & 0xFF), static_cast<char>(size >> 8),
+			'\x00', '\x00', '\x00', '\x00'
+		};
+		input.insert(input.end(), frame_header, frame_header + sizeof(frame_header));
+		input.insert(input.end(), payload.begin(), payload.end());
+	}
+
+	const size_t chunk_size = state.range(0);
+	BenchSession session;
+	allocation_counter::Scope allocations;
+	for (auto _ : state)
+	{
+		for (size_t position = 0; position < input.size(); position += chunk_size)
+		{
+			const size_t size = std::min(chunk_size, input.size() - position);
+			session.receive(&input[position], size);
+		}
+	}
+	allocations.report(state);
+	state.SetBytesProcessed(state.iterations() * input.size());
+	state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_Session_ProcessData)->Arg(1)->Arg(16)->Arg(64)->Arg(1460)->Arg(1 << 16);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,345 @@
+#include <ki/protocol/dml/MessageManager.h>
+#include <ki/protocol/net/Capture.h>
+#include <ki/protocol/net/ClientDMLSession.h>
+#include <ki/protocol/net/ServerDMLSession.h>
+#include <ki/protocol/exception.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace ki::protocol;
+
+namespace
+{
+	typedef std::chrono::steady_clock clock_type;
+
+	/**
+	 * One end of an in-memory connection. Everything sent by a session
+	 * is appended to its peer's inbox, and delivered the next time the
+	 * connection is pumped.
+	 */
+	struct Endpoint
+	{
+		std::vector<char> inbox;
+	};
+
+	/**
+	 * A server session that echoes every message it receives.
+	 */
+	class LoadServerSession : public net::ServerDMLSession
+	{
+	public:
+		LoadServerSession(uint16_t id, const dml::MessageManager &manager, Endpoint &peer)
+			: Session(id), ServerDMLSession(id, manager), m_peer(peer)
+		{
+			// Don't reject messages that require an access level
+			set_access_level(0xFF);
+		}
+
+		void start() { on_connected(); }
+		void receive(std::vector<char> &data)
+		{
+			process_data(data.data(), data.size());
+			data.clear();
+		}
+	protected:
+		void on_message(const dml::Message *message) override
+		{
+			send_message(*message);
+		}
+
+		void send_packet_data(const char *data, const size_t size) override
+		{
+			m_peer.inbox.insert(m_peer.inbox.end(), data, data + size);
+		}
+
+		void close(net::SessionCloseErrorCode error) override
+		{
+			std::cerr << "Server session " << get_id() << " closed (error=" << (int)error << ")" << std::endl;
+		}
+	private:
+		Endpoint &m_peer;
+	};
+
+	/**
+	 * A client session that keeps a window of messages in flight, and
+	 * measures the time taken for each of them to be echoed back.
+	 */
+	class LoadClientSession : public net::ClientDMLSession
+	{
+	public:
+		LoadClientSession(uint16_t id, const dml::MessageManager &manager, Endpoint &peer,
+			const std::vector<const dml::Message *> &messages, size_t message_count, size_t window)
+			: Session(id), ClientDMLSession(id, manager), m_peer(peer), m_messages(messages)
+		{
+			m_message_count = message_count;
+			m_window = window;
+			m_sent = 0;
+			m_received = 0;
+			m_next_message = id % messages.size();
+			m_closed = false;
+			set_access_level(0xFF);
+			on_connected();
+		}
+
+		// Closed sessions will never receive the rest of their messages
+		bool is_done() const { return m_received >= m_message_count || m_closed; }
+		size_t get_received() const { return m_received; }
+		const std::vector<uint64_t> &get_latencies() const { return m_latencies; }
+
+		void receive(std::vector<char> &data)
+		{
+			process_data(data.data(), data.size());
+			data.clear();
+		}
+
+		void send_pending()
+		{
+			if (!is_established())
+				return;
+
+			while (m_sent < m_message_count && m_in_flight.size() < m_window)
+			{
+				send_message(*m_messages[m_next_message]);
+				m_next_message = (m_next_message + 1) % m_messages.size();
+				m_in_flight.push_back(clock_type::now());
+				m_sent++;
+
+				// Exercise keep-alives alongside application traffic
+				if (m_sent % 1000 == 0)
+					send_keep_alive();
+			}
+		}
+	protected:
+		void on_message(const dml::Message *) override
+		{
+			// Echoes come back in the order they were sent
+			const auto latency = clock_type::now() - m_in_flight.front();
+			m_in_flight.pop_front();
+			m_latencies.push_back(static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+			m_received++;
+		}
+
+		void on_invalid_message(net::InvalidDMLMessageErrorCode error) override
+		{
+			std::cerr << "Client session " << get_id() << " received an invalid message (error="
+				<< (int)error << ")" << std::endl;
+		}
+
+		void send_packet_data(const char *data, const size_t size) override
+		{
+			m_peer.inbox.insert(m_peer.inbox.end(), data, data + size);
+		}
+
+		void close(net::SessionCloseErrorCode error) override
+		{
+			std::cerr << "Client session " << get_id() << " closed (error=" << (int)error << ")" << std::endl;
+			m_closed = true;
+		}
+	private:
+		Endpoint &m_peer;
+		const std::vector<const dml::Message *> &m_messages;
+		size_t m_message_count;
+		size_t m_window;
+		size_t m_sent;
+		size_t m_received;
+		size_t m_next_message;
+		bool m_closed;
+		std::deque<clock_type::time_point> m_in_flight;
+		std::vector<uint64_t> m_latencies;
+	};
+
+	/**
+	 * A client and server session joined by a pair of in-memory endpoints.
+	 */
+	struct Connection
+	{
+		Endpoint client_endpoint;
+		Endpoint server_endpoint;
+		std::unique_ptr<LoadServerSession> server;
+		std::unique_ptr<LoadClientSession> client;
+
+		Connection(uint16_t id, const dml::MessageManager &manager,
+			const std::vector<const dml::Message *> &messages, size_t message_count, size_t window)
+		{
+			server.reset(new LoadServerSession(id, manager, client_endpoint));
+			client.reset(new LoadClientSession(id, manager, server_endpoint,
+				messages, message_count, window));
+			server->start();
+		}
+
+		void pump()
+		{
+			client->send_pending();
+			if (!server_endpoint.inbox.empty())
+				server->receive(server_endpoint.inbox);
+			if (!client_endpoint.inbox.empty())
+				client->receive(client_endpoint.inbox);
+		}
+	};
+
+	uint64_t percentile(const std::vector<uint64_t> &sorted, const double p)
+	{
+		if (sorted.empty())
+			return 0;
+		const size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+		return sorted[index];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	// Get command-line arguments
+	if (argc < 2)
+	{
+		std::cout << "usage: example-dml-loadgen.exe <module_file> [module_file...] "
+			"[-c clients] [-n messages_per_client] [-w window] [-t threads] [-d deadline_seconds] "
+			"[-o capture_file]" << std::endl;
+		std::cout << "Echoes messages from the specified modules between simulated "
+			"client and server sessions, and reports throughput and latency." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> module_paths;
+	size_t client_count = 64;
+	size_t message_count = 10000;
+	size_t window = 16;
+	size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+	double deadline_seconds = 60.0;
+	std::string capture_path;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-c" && i + 1 < argc)
+			client_count = std::stoul(argv[++i]);
+		else if (arg == "-n" && i + 1 < argc)
+			message_count = std::stoul(argv[++i]);
+		else if (arg == "-w" && i + 1 < argc)
+			window = std::stoul(argv[++i]);
+		else if (arg == "-t" && i + 1 < argc)
+			thread_count = std::stoul(argv[++i]);
+		else if (arg == "-d" && i + 1 < argc)
+			deadline_seconds = std::stod(argv[++i]);
+		else if (arg == "-o" && i + 1 < argc)
+			capture_path = argv[++i];
+		else
+			module_paths.push_back(arg);
+	}
+	thread_count = std::max<size_t>(1, std::min(thread_count, client_count));
+
+	// Load the message modules
+	dml::MessageManager manager;
+	for (auto it = module_paths.begin(); it != module_paths.end(); ++it)
+	{
+		try
+		{
+			manager.load_module(*it);
+		}
+		catch (runtime_error &e)
+		{
+			std::cout << "Failed to load message module: " << *it << " (" << e.what() << ")" << std::endl;
+			return 1;
+		}
+	}
+
+	// Create one message from every template to use as the message mix
+	std::vector<const dml::Message *> messages;
+	const auto modules = manager.get_modules();
+	for (auto module_it = modules.begin();
+		module_it != modules.end(); ++module_it)
+	{
+		for (auto it = (*module_it)->templates_begin();
+			it != (*module_it)->templates_end(); ++it)
+			messages.push_back((*it)->create_message());
+	}
+	if (messages.empty())
+	{
+		std::cout << "The loaded modules do not contain any messages." << std::endl;
+		return 1;
+	}
+
+	// Create the connections; the SESSION_OFFER/SESSION_ACCEPT handshake
+	// is completed by the first pump.
+	std::vector<std::unique_ptr<Connection>> connections;
+	for (size_t i = 0; i < client_count; ++i)
+		connections.emplace_back(new Connection(static_cast<uint16_t>(i + 1),
+			manager, messages, message_count, window));
+
+	// Record the traffic seen by the clients
+	std::unique_ptr<net::CaptureWriter> capture_writer;
+	if (!capture_path.empty())
+	{
+		capture_writer.reset(new net::CaptureWriter(capture_path));
+		for (auto it = connections.begin(); it != connections.end(); ++it)
+			(*it)->client->set_capture_writer(capture_writer.get());
+	}
+
+	// Each thread drives an equal share of the connections, until they
+	// are done or the deadline passes (such as when a session never
+	// becomes established).
+	const auto start_time = clock_type::now();
+	const auto start_cpu = std::clock();
+	const auto deadline = start_time + std::chrono::duration_cast<clock_type::duration>(
+		std::chrono::duration<double>(deadline_seconds));
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < thread_count; ++t)
+	{
+		threads.emplace_back([t, thread_count, deadline, &connections]()
+		{
+			bool done = false;
+			while (!done && clock_type::now() < deadline)
+			{
+				done = true;
+				for (size_t i = t; i < connections.size(); i += thread_count)
+				{
+					connections[i]->pump();
+					done = done && connections[i]->client->is_done();
+				}
+			}
+		});
+	}
+	for (auto it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+	const auto elapsed = std::chrono::duration<double>(clock_type::now() - start_time).count();
+	const auto cpu_seconds = static_cast<double>(std::clock() - start_cpu) / CLOCKS_PER_SEC;
+
+	// Merge the latency samples from every client
+	std::vector<uint64_t> latencies;
+	size_t total_messages = 0;
+	size_t incomplete_clients = 0;
+	for (auto it = connections.begin(); it != connections.end(); ++it)
+	{
+		const auto &client_latencies = (*it)->client->get_latencies();
+		latencies.insert(latencies.end(), client_latencies.begin(), client_latencies.end());
+		total_messages += (*it)->client->get_received();
+		if ((*it)->client->get_received() < message_count)
+			incomplete_clients++;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	// Each echoed message is sent and received twice
+	std::cout << "Clients: " << client_count << ", Threads: " << thread_count
+		<< ", Window: " << window << ", Message Types: " << messages.size() << std::endl;
+	std::cout << "Messages Echoed: " << total_messages << " in " << elapsed << "s" << std::endl;
+	if (incomplete_clients > 0)
+		std::cout << "Incomplete Clients: " << incomplete_clients
+			<< " (closed, or still running at the deadline)" << std::endl;
+	std::cout << "Throughput: " << (total_messages / elapsed) << " echoes/s" << std::endl;
+	std::cout << "Latency (us): p50=" << percentile(latencies, 0.5) / 1000.0
+		<< " p99=" << percentile(latencies, 0.99) / 1000.0
+		<< " p999=" << percentile(latencies, 0.999) / 1000.0 << std::endl;
+	std::cout << "CPU per echo: " << (cpu_seconds * 1e9 / std::max<size_t>(1, total_messages))
+		<< "ns" << std::endl;
+
+	for (auto it = messages.begin(); it != messages.end(); ++it)
+		delete *it;
+
+	// Exit successfully
+	return 0;
+}
@@ -33,6 +33,7 @@ int main(int argc, char **argv)
 	// Print some information about the module itself
 	std::cout << "Service ID: " << (uint16_t)message_module->get_service_id() << std::endl;
 	std::cout << "Protocol Type: " << message_module->get_protocol_type() << std::endl;
+	std::cout << "Load Time: " << message_module->get_load_time().count() << "us" << std::endl;
 
 	// Get the message template from the module we just loaded
 	const std::string message_name = argv[2];
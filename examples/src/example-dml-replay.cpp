@@ -0,0 +1,94 @@
+#include <ki/protocol/dml/MessageManager.h>
+#include <ki/protocol/net/Capture.h>
+#include <ki/protocol/exception.h>
+#include <ki/util/WorkStealingPool.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ki::protocol;
+
+int main(int argc, char **argv)
+{
+	// Get command-line arguments
+	if (argc < 3)
+	{
+		std::cout << "usage: example-dml-replay.exe <capture_file> <module_file> [module_file...] "
+			"[-t threads]" << std::endl;
+		std::cout << "Decodes every DML message in a capture file, and reports "
+			"the decoding throughput." << std::endl;
+		return 1;
+	}
+
+	const std::string capture_path = argv[1];
+	std::vector<std::string> module_paths;
+	size_t thread_count = 0;
+	for (int i = 2; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+			thread_count = std::stoul(argv[++i]);
+		else
+			module_paths.push_back(arg);
+	}
+
+	// Load the message modules
+	dml::MessageManager manager;
+	for (auto it = module_paths.begin(); it != module_paths.end(); ++it)
+	{
+		try
+		{
+			manager.load_module(*it);
+		}
+		catch (runtime_error &e)
+		{
+			std::cout << "Failed to load message module: " << *it << " (" << e.what() << ")" << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		net::CaptureReader reader(capture_path);
+		if (reader.is_truncated())
+			std::cout << "Warning: the last frame in the capture is incomplete." << std::endl;
+
+		std::unique_ptr<ki::util::WorkStealingPool> pool;
+		if (thread_count != 1)
+			pool.reset(new ki::util::WorkStealingPool(thread_count));
+
+		const net::CaptureDirection directions[] = {
+			net::CaptureDirection::INBOUND, net::CaptureDirection::OUTBOUND
+		};
+		for (auto direction : directions)
+		{
+			std::vector<char> buffer;
+			reader.append_dml_messages(buffer, direction);
+
+			const auto start_time = std::chrono::steady_clock::now();
+			const auto messages = manager.decode_batch(buffer.data(), buffer.size(), pool.get());
+			const auto elapsed = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start_time).count();
+
+			std::cout << (direction == net::CaptureDirection::INBOUND ? "Inbound" : "Outbound")
+				<< ": " << messages.size() << " messages (" << buffer.size() << " bytes) in "
+				<< elapsed << "s" << std::endl;
+			if (elapsed > 0)
+				std::cout << "Throughput: " << (messages.size() / elapsed) << " messages/s, "
+					<< (buffer.size() / elapsed / 1e6) << " MB/s" << std::endl;
+
+			for (auto it = messages.begin(); it != messages.end(); ++it)
+				delete *it;
+		}
+	}
+	catch (runtime_error &e)
+	{
+		std::cout << "Failed to replay capture: " << e.what() << std::endl;
+		return 1;
+	}
+
+	// Exit successfully
+	return 0;
+}
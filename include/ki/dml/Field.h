@@ -2,8 +2,11 @@
 #include "FieldBase.h"
 #include "types.h"
 #include "exception.h"
+#include "../util/TextConversion.h"
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace ki
 {
@@ -15,25 +18,40 @@ namespace dml
 		friend Record;
 		friend FieldBase;
 	public:
-		Field(std::string name) : FieldBase(name)
+		Field(std::string name) : FieldBase(std::move(name))
 		{
 			m_type_hash = typeid(ValueT).hash_code();
 			m_value = ValueT();
 		}
 		virtual ~Field() = default;
 
-		ValueT get_value() const
+		/**
+		* Returns a reference to this field's value, which remains valid
+		* until the value is next changed or the field is destroyed.
+		*/
+		const ValueT &get_value() const
 		{
 			return m_value;
 		}
 
-		void set_value(ValueT value)
+		void set_value(const ValueT &value)
 		{
 			m_value = value;
 		}
 
+		void set_value(ValueT &&value)
+		{
+			m_value = std::move(value);
+		}
+
 		const char *get_type_name() const override final;
 
+		bool is_fixed_size() const override final
+		{
+			return !std::is_same<ValueT, STR>::value &&
+				!std::is_same<ValueT, WSTR>::value;
+		}
+
 		void write_to(std::ostream &ostream) const override final;
 		void read_from(std::istream &istream) override final;
 		size_t get_size() const override final;
@@ -49,8 +67,10 @@ namespace dml
 			// Create the node:
 			// Copy our current name and value into buffers that are
 			// lifetime-dependant on the xml_document, rather than this Field.
+			std::string value;
+			append_value_string(value);
 			char *name_buffer = doc.allocate_string(m_name.c_str(), 0);
-			char *value_buffer = doc.allocate_string(get_value_string().c_str(), 0);
+			char *value_buffer = doc.allocate_string(value.c_str(), value.length() + 1);
 			auto *node = doc.allocate_node(
 				rapidxml::node_type::node_element, name_buffer, value_buffer);
 
@@ -70,6 +90,26 @@ namespace dml
 			return node;
 		}
 
+		void write_xml(std::string &buffer) const final
+		{
+			buffer.push_back('<');
+			buffer.append(m_name);
+			buffer.append(" TYPE=\"");
+			buffer.append(get_type_name());
+			buffer.push_back('"');
+			if (!m_transferable)
+				buffer.append(" NOXFER=\"TRUE\"");
+			buffer.push_back('>');
+
+			const size_t value_position = buffer.size();
+			append_value_string(buffer);
+			util::escape_xml(buffer, value_position);
+
+			buffer.append("</");
+			buffer.append(m_name);
+			buffer.push_back('>');
+		}
+
 		/**
 		* Loads data from an XML Field node into this field.
 		* Example: <FieldName TYPE="STR">Value</FieldName>
@@ -81,44 +121,41 @@ namespace dml
 		{
 			// Use the name of the node as the field name and,
 			// default transferable to TRUE.
-			m_name = node->name();
+			m_name.assign(node->name(), node->name_size());
 			m_transferable = true;
 
 			for (auto *attr = node->first_attribute();
 				attr; attr = attr->next_attribute())
 			{
-				const std::string name = attr->name();
-				if (name == "TYPE")
+				if (xml_text_equals(attr->name(), attr->name_size(), "TYPE"))
 				{
-					const std::string value = attr->value();
-					if (value != get_type_name())
+					if (!xml_text_equals(attr->value(), attr->value_size(), get_type_name()))
 					{
 						std::ostringstream oss;
 						oss << "XML Field node has incorrect TYPE attribute value. ";
-						oss << "(value=\"" << value << "\", expected=\"" << get_type_name() << "\". ";
+						oss << "(value=\"" << std::string(attr->value(), attr->value_size())
+							<< "\", expected=\"" << get_type_name() << "\". ";
 						throw value_error(oss.str());
 					}
 				}
-				else if (name == "NOXFER")
-				{
-					const std::string value = attr->value();
-					m_transferable = value != "TRUE";
-				}
+				else if (xml_text_equals(attr->name(), attr->name_size(), "NOXFER"))
+					m_transferable = !xml_text_equals(attr->value(), attr->value_size(), "TRUE");
 				else
 				{
 					std::ostringstream oss;
-					oss << "XML Field node has unknown attribute \"" << name << "\".";
+					oss << "XML Field node has unknown attribute \""
+						<< std::string(attr->name(), attr->name_size()) << "\".";
 					throw value_error(oss.str());
 				}
 			}
 
-			const std::string value = node->value();
-			if (!value.empty())
-				set_value_from_string(value);
+			if (node->value_size() > 0)
+				set_value_from_string(node->value(), node->value() + node->value_size());
 		}
 
-		std::string get_value_string() const override final;
-		void set_value_from_string(std::string value) override final;
+		using FieldBase::set_value_from_string;
+		void append_value_string(std::string &buffer) const override final;
+		void set_value_from_string(const char *begin, const char *end) override final;
 	private:
 		ValueT m_value;
 
@@ -126,9 +163,13 @@ namespace dml
 		* Returns a new Field with the same name, transferability,
 		* type, and value but with a different owner Record.
 		*/
-		Field<ValueT> *clone() const override final
+		Field<ValueT> *clone(util::Arena *arena) const override final
 		{
-			auto *clone = new Field<ValueT>(m_name);
+			Field<ValueT> *clone;
+			if (arena)
+				clone = arena->create_uncollected<Field<ValueT>>(m_name);
+			else
+				clone = new Field<ValueT>(m_name);
 			clone->m_transferable = m_transferable;
 			clone->m_value = m_value;
 			return clone;
@@ -169,42 +210,39 @@ namespace dml
 	typedef Field<GID> GidField;
 
 	template <typename ValueT>
-	std::string Field<ValueT>::get_value_string() const
+	void Field<ValueT>::append_value_string(std::string &buffer) const
 	{
-		std::ostringstream oss;
-		oss << m_value;
-		return oss.str();
+		util::append_number(buffer, m_value);
 	}
 
 	template <typename ValueT>
-	void Field<ValueT>::set_value_from_string(const std::string value)
+	void Field<ValueT>::set_value_from_string(const char *begin, const char *end)
 	{
-		std::istringstream iss(value);
-		iss >> m_value;
+		if (!util::parse_number(begin, end, m_value))
+		{
+			std::ostringstream oss;
+			oss << "Invalid " << get_type_name() << " value \"" << std::string(begin, end)
+				<< "\" (" << m_name << ").";
+			throw value_error(oss.str());
+		}
 	}
 
 	template <>
-	std::string BytField::get_value_string() const;
-
-	template <>
-	void BytField::set_value_from_string(std::string value);
-
-	template <>
-	std::string UBytField::get_value_string() const;
+	void BytField::set_value_from_string(const char *begin, const char *end);
 
 	template <>
-	void UBytField::set_value_from_string(std::string value);
+	void UBytField::set_value_from_string(const char *begin, const char *end);
 
 	template <>
-	std::string StrField::get_value_string() const;
+	void StrField::append_value_string(std::string &buffer) const;
 
 	template <>
-	void StrField::set_value_from_string(std::string value);
+	void StrField::set_value_from_string(const char *begin, const char *end);
 
 	template <>
-	std::string WStrField::get_value_string() const;
+	void WStrField::append_value_string(std::string &buffer) const;
 
 	template <>
-	void WStrField::set_value_from_string(std::string value);
+	void WStrField::set_value_from_string(const char *begin, const char *end);
 }
 }
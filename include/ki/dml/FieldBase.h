@@ -5,6 +5,8 @@
 #include <typeinfo>
 #include <rapidxml.hpp>
 #include "../util/Serializable.h"
+#include "../util/Allocation.h"
+#include "../util/Arena.h"
 
 namespace ki
 {
@@ -19,12 +21,25 @@ namespace dml
 	{
 		friend Record;
 	public:
+		/**
+		 * Fields are allocated from a per-thread pool of small blocks,
+		 * or through util::allocate when built with KI_ALLOCATION_STATS.
+		 */
+		static void *operator new(size_t size);
+		static void operator delete(void *ptr, size_t size);
+
 		FieldBase(std::string name);
 		virtual ~FieldBase() = default;
 
-		std::string get_name() const;
+		const std::string &get_name() const;
 		bool is_transferable() const;
 
+		/**
+		 * Returns true if this field's serialized size never
+		 * depends on its value.
+		 */
+		virtual bool is_fixed_size() const = 0;
+
 		template <typename ValueT>
 		bool is_type() const
 		{
@@ -40,12 +55,21 @@ namespace dml
 		 */
 		virtual rapidxml::xml_node<> *as_xml(rapidxml::xml_document<> &doc) const = 0;
 
+		/**
+		 * Appends this field to a buffer as an XML element, in the same
+		 * format as as_xml, without building a document first.
+		 */
+		virtual void write_xml(std::string &buffer) const = 0;
+
 		/**
 		 * Loads data from an XML Field node into this field.
 		 * Example: <FieldName TYPE="STR">Value</FieldName>
 		 * 
 		 * If the field in the XML data does not have the same type
 		 * as this field, then an exception is thrown.
+		 * 
+		 * Names and values are read using their sizes, so the node may
+		 * come from a document parsed with parse_no_string_terminators.
 		 */
 		virtual void from_xml(const rapidxml::xml_node<> *node) = 0;
 
@@ -54,8 +78,21 @@ namespace dml
 		 */
 		static FieldBase *create_from_xml(const rapidxml::xml_node<> *node);
 
-		virtual std::string get_value_string() const = 0;
-		virtual void set_value_from_string(std::string value) = 0;
+		/**
+		 * Appends a text representation of this field's value
+		 * to a buffer.
+		 */
+		virtual void append_value_string(std::string &buffer) const = 0;
+		std::string get_value_string() const;
+
+		/**
+		 * Sets this field's value from the text in [begin, end).
+		 * 
+		 * If the text is not a valid value for this field's type,
+		 * then a value_error is thrown.
+		 */
+		virtual void set_value_from_string(const char *begin, const char *end) = 0;
+		void set_value_from_string(const std::string &value);
 	protected:
 		std::string m_name;
 		bool m_transferable;
@@ -64,17 +101,35 @@ namespace dml
 		/**
 		 * Returns a new Field with the same name, transferability
 		 * and value but with a different owner Record.
+		 * 
+		 * If an arena is given, the new Field is constructed inside it.
 		 */
-		virtual FieldBase *clone() const = 0;
+		virtual FieldBase *clone(util::Arena *arena) const = 0;
 
 		/**
 		 * Copies the value of another Field into this one
 		 * if the types are the same.
 		 */
 		virtual void set_value(FieldBase *other) = 0;
+
+		/**
+		 * Returns true if the size bytes at data are equal to text,
+		 * for comparing XML names and values that may not be
+		 * null-terminated.
+		 */
+		static bool xml_text_equals(const char *data, size_t size, const char *text);
 	};
 
 	typedef std::vector<FieldBase *> FieldList;
 	typedef std::map<std::string, FieldBase *> FieldNameMap;
+
+	/**
+	 * The containers that Records keep their fields in, which allocate
+	 * from the Record's arena if it has one.
+	 */
+	typedef std::vector<FieldBase *, util::ArenaAllocator<
+		FieldBase *, util::AllocationCategory::RECORD>> ArenaFieldList;
+	typedef std::map<std::string, FieldBase *, std::less<std::string>, util::ArenaAllocator<
+		std::pair<const std::string, FieldBase *>, util::AllocationCategory::RECORD>> ArenaFieldNameMap;
 }
 }
@@ -12,30 +12,65 @@ namespace dml
 	class Record final : public util::Serializable
 	{
 	public:
+		KI_ALLOCATION_CATEGORY(ki::util::AllocationCategory::RECORD)
+
+		/**
+		 * The type returned by fields_begin and fields_end.
+		 * 
+		 * Fields are kept in an ArenaFieldList, so this is no longer
+		 * FieldList::const_iterator; code that named that type should
+		 * use Record::const_iterator (or auto) instead.
+		 */
+		typedef ArenaFieldList::const_iterator const_iterator;
+
 		Record();
 		Record(const Record &record);
+
+		/**
+		 * Takes ownership of another record's fields, leaving it empty.
+		 * The new record shares the other record's arena.
+		 */
+		Record(Record &&record);
+
+		/**
+		 * Creates a record whose fields are allocated from an arena.
+		 * The record must be destroyed before the arena is reset.
+		 */
+		explicit Record(util::Arena *arena);
+		Record(const Record &record, util::Arena *arena);
+
 		virtual ~Record();
 
+		/**
+		 * Assigning to a record keeps its own arena. Fields are only
+		 * moved when both records share an arena, and are copied
+		 * otherwise.
+		 */
+		Record &operator=(const Record &record);
+		Record &operator=(Record &&record);
+
+		util::Arena *get_arena() const;
+
 		/**
 		 * Returns true if a field of any type has the name
 		 * specified.
 		 */
-		bool has_field(std::string name) const;
+		bool has_field(const std::string &name) const;
 
 		/**
 		 * Returns true if a field exists with the specified
 		 * name and type.
 		 */
 		template <typename ValueT>
-		bool has_field(std::string name) const
+		bool has_field(const std::string &name) const
 		{
 			if (!has_field(name))
 				return false;
 			return m_field_map.at(name)->is_type<ValueT>();
 		}
 
-		FieldBase *get_field(std::string name);
-		const FieldBase *get_field(std::string name) const;
+		FieldBase *get_field(const std::string &name);
+		const FieldBase *get_field(const std::string &name) const;
 
 		/**
 		* Returns a previously added field with the specified name
@@ -45,7 +80,7 @@ namespace dml
 		* returned.
 		*/
 		template <typename ValueT>
-		Field<ValueT> *get_field(std::string name)
+		Field<ValueT> *get_field(const std::string &name)
 		{
 			if (has_field<ValueT>(name))
 				return dynamic_cast<Field<ValueT> *>(m_field_map.at(name));
@@ -60,7 +95,7 @@ namespace dml
 		 * returned.
 		 */
 		template <typename ValueT>
-		const Field<ValueT> *get_field(std::string name) const
+		const Field<ValueT> *get_field(const std::string &name) const
 		{
 			if (has_field<ValueT>(name))
 				return dynamic_cast<Field<ValueT> *>(m_field_map.at(name));
@@ -91,21 +126,56 @@ namespace dml
 			}
 
 			// Create the field
-			auto *field = new Field<ValueT>(name);
+			Field<ValueT> *field;
+			if (m_arena)
+				field = m_arena->create_uncollected<Field<ValueT>>(std::move(name));
+			else
+				field = new Field<ValueT>(std::move(name));
 			field->m_transferable = transferable;
 			add_field(field);
 			return field;
 		}
 
+		/**
+		 * Removes and deletes the field with the specified name.
+		 * 
+		 * Returns false if no such field exists.
+		 */
+		bool remove_field(const std::string &name);
+
 		size_t get_field_count() const;
 
-		FieldList::const_iterator fields_begin() const;
-		FieldList::const_iterator fields_end() const;
+		const_iterator fields_begin() const;
+		const_iterator fields_end() const;
 
 		void write_to(std::ostream &ostream) const override final;
 		void read_from(std::istream &istream) override final;
+
+		/**
+		 * Returns the serialized size of this record's transferable
+		 * fields. Only variable-length fields are visited; the size of
+		 * the rest is kept up to date as fields are added and removed.
+		 */
 		size_t get_size() const override final;
 
+		/**
+		 * Returns true if every transferable field has a fixed size.
+		 */
+		bool is_fixed_size() const;
+
+		/**
+		 * Returns the smallest size this record can serialize to,
+		 * which is when every variable-length field is empty.
+		 */
+		size_t get_minimum_size() const;
+
+		/**
+		 * Returns a hash of the names, types, order and transferability
+		 * of this record's fields (but not their values), which is the
+		 * same in every process. See util::Fingerprint.
+		 */
+		uint64_t get_fingerprint() const;
+
 		/**
 		* Creates an XML node from this record's data.
 		*
@@ -114,6 +184,12 @@ namespace dml
 		*/
 		rapidxml::xml_node<> *as_xml(rapidxml::xml_document<> &doc) const;
 
+		/**
+		* Appends this record to a buffer as a <RECORD> element, without
+		* building a document first.
+		*/
+		void write_xml(std::string &buffer) const;
+
 		/**
 		* Loads data from an XML Record node into this record.
 		* 
@@ -124,10 +200,19 @@ namespace dml
 		*/
 		void from_xml(rapidxml::xml_node<> *node);
 	private:
-		FieldList m_fields;
-		FieldNameMap m_field_map;
+		ArenaFieldList m_fields;
+		ArenaFieldNameMap m_field_map;
+		util::Arena *m_arena;
+
+		// The total size of transferable fixed-size fields, and the
+		// transferable fields whose size depends on their value
+		size_t m_fixed_size;
+		ArenaFieldList m_variable_fields;
 
 		void add_field(FieldBase *field);
+		void destroy_field(FieldBase *field) const;
+		void clear();
+		void update_sizes();
 	};
 }
 }
@@ -0,0 +1,82 @@
+#pragma once
+#include "MessageManager.h"
+#include "../../util/Serializable.h"
+#include <cstdint>
+#include <vector>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	/**
+	 * A template that differs between two FingerprintTables. A message
+	 * type of 0 means that the module differs as a whole; it is missing
+	 * from one of the tables, or only its names have changed.
+	 */
+	struct FingerprintMismatch
+	{
+		uint8_t service_id;
+		uint8_t message_type;
+	};
+
+	/**
+	 * The fingerprints of every module and template that a MessageManager
+	 * has loaded, which can be sent to another process and compared with
+	 * its own to check that both can decode each other's messages.
+	 */
+	class FingerprintTable final : public util::Serializable
+	{
+	public:
+		FingerprintTable();
+		explicit FingerprintTable(const MessageManager &manager);
+
+		/**
+		 * Returns the fingerprint of the whole manager.
+		 * See MessageManager::get_fingerprint.
+		 */
+		uint64_t get_fingerprint() const;
+
+		/**
+		 * Returns the fingerprint of the module with the specified
+		 * service ID, or 0 if there isn't one.
+		 */
+		uint64_t get_module_fingerprint(uint8_t service_id) const;
+
+		/**
+		 * Returns the fingerprint of the specified template,
+		 * or 0 if there isn't one.
+		 */
+		uint64_t get_template_fingerprint(uint8_t service_id, uint8_t message_type) const;
+
+		/**
+		 * Returns every template that differs from another table, in order
+		 * of service ID and message type. If the whole fingerprints match,
+		 * then nothing else is compared.
+		 */
+		std::vector<FingerprintMismatch> compare(const FingerprintTable &other) const;
+
+		void write_to(std::ostream &ostream) const override final;
+		void read_from(std::istream &istream) override final;
+		size_t get_size() const override final;
+	private:
+		struct ModuleEntry
+		{
+			uint8_t service_id;
+			uint64_t fingerprint;
+
+			// Pairs of message type and fingerprint, in order of type
+			std::vector<std::pair<uint8_t, uint64_t>> templates;
+		};
+
+		uint64_t m_fingerprint;
+
+		// In order of service ID
+		std::vector<ModuleEntry> m_modules;
+
+		const ModuleEntry *find_module(uint8_t service_id) const;
+	};
+}
+}
+}
@@ -2,6 +2,7 @@
 #include "MessageHeader.h"
 #include "../../util/Serializable.h"
 #include "../../dml/Record.h"
+#include "../../util/Allocation.h"
 #include <iostream>
 
 namespace ki
@@ -15,22 +16,49 @@ namespace dml
 	class Message final : public util::Serializable
 	{
 	public:
-		Message(const MessageTemplate *message_template = nullptr);
+		KI_ALLOCATION_CATEGORY(ki::util::AllocationCategory::MESSAGE)
+
+		/**
+		 * If an arena is given, the message's record and fields are
+		 * allocated from it, and the message must be destroyed before the
+		 * arena is reset. Creating the message itself with Arena::create
+		 * takes care of this.
+		 */
+		Message(const MessageTemplate *message_template = nullptr,
+			util::Arena *arena = nullptr);
+
+		/**
+		 * Copies are always allocated on the heap, even when the
+		 * original message belongs to an arena.
+		 */
+		Message(const Message &message);
+
+		/**
+		 * Takes ownership of another message's record, leaving it
+		 * without a template. The new message shares the other
+		 * message's arena.
+		 */
+		Message(Message &&message);
 		virtual ~Message();
 
+		Message &operator=(const Message &message);
+		Message &operator=(Message &&message);
+
+		util::Arena *get_arena() const;
+
 		const MessageTemplate *get_template() const;
 		void set_template(const MessageTemplate *message_template);
 
 		ki::dml::Record *get_record();
 		const ki::dml::Record *get_record() const;
 
-		ki::dml::FieldBase *get_field(std::string name);
-		const ki::dml::FieldBase *get_field(std::string name) const;
+		ki::dml::FieldBase *get_field(const std::string &name);
+		const ki::dml::FieldBase *get_field(const std::string &name) const;
 
 		uint8_t get_service_id() const;
 		uint8_t get_type() const;
 		uint16_t get_message_size() const;
-		std::string get_handler() const;
+		const std::string &get_handler() const;
 		uint8_t get_access_level() const;
 
 		void write_to(std::ostream &ostream) const override final;
@@ -39,11 +67,21 @@ namespace dml
 	private:
 		const MessageTemplate *m_template;
 		ki::dml::Record *m_record;
+		util::Arena *m_arena;
 
 		// This is used to store raw data when a Message is
 		// constructed without a MessageTemplate.
 		MessageHeader m_header;
 		std::vector<char> m_raw_data;
+
+		/**
+		 * Switches to another template, keeping the message counts
+		 * that MessageManager::collect_retired relies on up to date.
+		 */
+		void reference_template(const MessageTemplate *message_template);
+
+		void create_record();
+		void destroy_record();
 	};
 }
 }
@@ -0,0 +1,127 @@
+#pragma once
+#include "Message.h"
+#include "MessageTemplate.h"
+#include "../../util/Serializable.h"
+#include "../../util/ValueBytes.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define KI_COLUMNS_MAGIC 0x4C4F4349
+#define KI_COLUMNS_VERSION 1
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	/**
+	 * The values of one field across every message in a MessageColumns.
+	 *
+	 * Fixed-size values are stored back to back in data. Strings are
+	 * stored back to back in data as well, and the bytes of row i are
+	 * data[offsets[i]] up to data[offsets[i + 1]]. WSTR values are
+	 * stored as UTF-16. Every value is little endian.
+	 */
+	struct MessageColumn
+	{
+		std::string name;
+		std::string type_name;
+
+		// The size of each value, or 0 for strings
+		size_t value_size;
+		std::vector<char> data;
+		std::vector<uint32_t> offsets;
+
+		bool is_fixed_size() const { return value_size != 0; }
+
+		template <typename ValueT>
+		ValueT get_value(const size_t row) const
+		{
+			ValueBytes<ValueT> bytes;
+			std::memcpy(bytes.buff, &data[row * sizeof(ValueT)], sizeof(ValueT));
+			convert_little_endian(bytes);
+			return bytes.value;
+		}
+
+		std::string get_string(const size_t row) const
+		{
+			return std::string(&data[offsets[row]], offsets[row + 1] - offsets[row]);
+		}
+	};
+
+	/**
+	 * Converts decoded messages of a single template into columns,
+	 * one per transferable field, for offline analysis.
+	 *
+	 * When serialized, a header (the magic "ICOL", a 2-byte version,
+	 * a 2-byte column count and a 4-byte row count) is followed by each
+	 * column's name and type as length-prefixed strings, and then its
+	 * data. String columns write their row_count + 1 offsets before
+	 * their data.
+	 */
+	class MessageColumns final : public util::Serializable
+	{
+	public:
+		/**
+		 * Creates empty columns, to be filled by read_from.
+		 */
+		MessageColumns();
+
+		/**
+		 * Creates a column for every transferable field in the
+		 * template's message record.
+		 */
+		explicit MessageColumns(const MessageTemplate &message_template);
+
+		const MessageTemplate *get_template() const;
+		size_t get_row_count() const;
+		size_t get_column_count() const;
+
+		const MessageColumn &get_column(size_t index) const;
+
+		/**
+		 * Returns the column with the specified name, or a nullptr
+		 * if there is no such column.
+		 */
+		const MessageColumn *get_column(const std::string &name) const;
+
+		/**
+		 * Appends the values of a message's fields as a new row.
+		 *
+		 * If the message was not created from this template, or its
+		 * record no longer has the template's layout, then a value_error
+		 * is thrown and no row is added.
+		 */
+		void append(const Message &message);
+
+		/**
+		 * Removes every row, keeping the columns.
+		 */
+		void clear();
+
+		void write_to(std::ostream &ostream) const override final;
+		void read_from(std::istream &istream) override final;
+		size_t get_size() const override final;
+	private:
+		struct Appender
+		{
+			bool (*matches)(const ki::dml::FieldBase &field);
+			void (*append)(MessageColumn &column, const ki::dml::FieldBase &field);
+		};
+
+		const MessageTemplate *m_template;
+		size_t m_row_count;
+		std::vector<MessageColumn> m_columns;
+
+		// The index of each column's field in the message record,
+		// and the function that appends its value.
+		std::vector<size_t> m_field_indices;
+		std::vector<Appender> m_appenders;
+	};
+}
+}
+}
@@ -1,8 +1,17 @@
 #pragma once
 #include "Message.h"
 #include "MessageModule.h"
+#include "MessageModuleBuilder.h"
 #include "../../dml/Record.h"
+#include "../../util/ReclamationDomain.h"
+#include "../../util/WorkStealingPool.h"
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#define KI_DECODE_BATCH_CHUNK_SIZE 256
 
 namespace ki
 {
@@ -10,16 +19,120 @@ namespace protocol
 {
 namespace dml
 {
+	/**
+	 * Loads message modules, and creates and decodes messages with them.
+	 * 
+	 * Modules can be added or replaced while other threads are looking
+	 * them up, as each change publishes a new set of lookups rather than
+	 * modifying the current one. Lookups and modules that are replaced
+	 * are kept until collect_retired is called, which can be done while
+	 * other threads are still using the manager.
+	 * 
+	 * Modules returned by get_module and get_modules remain valid until
+	 * they have been replaced and collect_retired is then called.
+	 */
 	class MessageManager
 	{
 	public:
-		MessageManager() = default;
+		MessageManager();
 		~MessageManager();
 
+		MessageManager(const MessageManager &) = delete;
+		MessageManager &operator=(const MessageManager &) = delete;
+
+		bool is_stripping_template_metadata() const;
+
+		/**
+		 * If enabled, templates in modules loaded from now on leave their
+		 * non-transferable _Msg* metadata fields out of message records.
+		 * See MessageTemplate::set_metadata_stripped.
+		 */
+		void set_strip_template_metadata(bool strip);
+
+		bool is_loading_templates_lazily() const;
+
+		/**
+		 * If enabled, load_module only finds where each template's record
+		 * is in the file (along with its name, order and metadata), and
+		 * the record is built the first time that it is used.
+		 * 
+		 * The file stays mapped until the module is destroyed, and errors
+		 * in a record are only found when it is built.
+		 */
+		void set_load_templates_lazily(bool lazy);
+
 		const MessageModule *load_module(std::string filepath);
+
+		/**
+		 * Adds a module, such as one created by a MessageModuleBuilder,
+		 * and takes ownership of it.
+		 * 
+		 * If a module with the same service ID or protocol type has
+		 * already been added, then the module is deleted and a
+		 * value_error is thrown.
+		 */
+		const MessageModule *add_module(MessageModule *message_module);
+
+		/**
+		 * Loads a module and replaces the loaded module with the same
+		 * service ID or protocol type, or adds it if there isn't one.
+		 * The module is loaded before anything is locked, so lookups
+		 * are never blocked by it.
+		 * 
+		 * Messages created from the replaced module's templates remain
+		 * valid, and DMLHandlerTables must be bound again to see the
+		 * new templates (see DMLHandlerTable::is_current).
+		 */
+		MessageModuleDiff reload_module(const std::string &filepath);
+
+		/**
+		 * Calls reload_module on another thread.
+		 */
+		std::future<MessageModuleDiff> reload_module_async(std::string filepath);
+
+		/**
+		 * Replaces the module with the same service ID or protocol type,
+		 * or adds the module if there isn't one, and takes ownership of it.
+		 * 
+		 * If the service ID and protocol type belong to two different
+		 * modules, then the module is deleted and a value_error is thrown.
+		 */
+		MessageModuleDiff replace_module(MessageModule *message_module);
+
+		/**
+		 * Deletes the modules that have been replaced, once there are no
+		 * Messages using their templates, along with old lookups. Returns
+		 * the number of replaced modules that are still in use.
+		 * 
+		 * This first waits for calls on other threads that may still be
+		 * reading an old lookup to return, but doesn't block them, or
+		 * calls that start while it waits.
+		 */
+		size_t collect_retired();
 		const MessageModule *get_module(uint8_t service_id) const;
 		const MessageModule *get_module(const std::string &protocol_type) const;
 
+		/**
+		 * Returns a hash of the fingerprints of every module,
+		 * in order of service ID.
+		 */
+		uint64_t get_fingerprint() const;
+
+		/**
+		 * Returns a copy of the list of loaded modules, taken from a
+		 * single lookup so that it stays consistent while modules are
+		 * being reloaded. Replaced modules in the list remain valid
+		 * until collect_retired is called.
+		 */
+		MessageModuleList get_modules() const;
+
+		/**
+		 * Returns a number that changes whenever a module is added or
+		 * replaced, so that anything built from the loaded modules can
+		 * tell whether it is out of date.
+		 */
+		uint64_t get_revision() const;
+
 		Message *create_message(uint8_t service_id, uint8_t message_type) const;
 		Message *create_message(uint8_t service_id, const std::string &message_name) const;
 		Message *create_message(const std::string &protocol_type, uint8_t message_type) const;
@@ -32,12 +145,63 @@ namespace dml
 		 * 
 		 * To verify if the record was completely parsed, get_record 
 		 * should return a valid Record pointer, rather than nullptr.
+		 * 
+		 * If an arena is given, the message is created inside it and is
+		 * destroyed when the arena is reset, so it must not be deleted.
 		 */
-		const Message *message_from_binary(std::istream &istream) const;
+		const Message *message_from_binary(std::istream &istream,
+			util::Arena *arena = nullptr) const;
+
+		/**
+		 * Decodes every message in a buffer of back-to-back DML
+		 * messages, and returns them in order. The caller owns the
+		 * returned messages.
+		 * 
+		 * Message boundaries are found from the size in each header
+		 * before anything is decoded, so if a pool is given, chunks of
+		 * KI_DECODE_BATCH_CHUNK_SIZE messages are decoded in parallel.
+		 * The calling thread decodes chunks too, so this is safe to
+		 * call from inside one of the pool's tasks.
+		 * 
+		 * If any message cannot be decoded, then none are returned and
+		 * the first error in buffer order is thrown.
+		 */
+		std::vector<const Message *> decode_batch(const char *data, size_t size,
+			util::WorkStealingPool *pool = nullptr) const;
 	private:
-		MessageModuleList m_modules;
-		MessageModuleServiceIdMap m_service_id_map;
-		MessageModuleProtocolTypeMap m_protocol_type_map;
+		bool m_strip_template_metadata;
+		bool m_load_templates_lazily;
+
+		/**
+		 * The modules seen by lookups. A lookup is never modified once
+		 * it has been published.
+		 */
+		struct ModuleLookup
+		{
+			MessageModuleList modules;
+			MessageModuleServiceIdMap service_id_map;
+			MessageModuleProtocolTypeMap protocol_type_map;
+		};
+		std::atomic<const ModuleLookup *> m_lookup;
+
+		std::atomic<uint64_t> m_revision;
+
+		// Every read of m_lookup is guarded, so that collect_retired
+		// knows when no reader can still be using a retired lookup
+		util::ReclamationDomain m_readers;
+
+		// Changes to the lookup are made one at a time
+		std::mutex m_lookup_mutex;
+		std::vector<const ModuleLookup *> m_retired_lookups;
+		MessageModuleList m_retired_modules;
+
+		MessageModule *read_module(const std::string &filepath) const;
+		void publish_lookup(const ModuleLookup *lookup);
+
+		const MessageTemplate *get_message_template(
+			uint8_t service_id, uint8_t message_type) const;
+		void decode_range(const char *data, const std::vector<size_t> &offsets,
+			size_t begin, size_t end, std::vector<const Message *> &messages) const;
 	};
 }
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include "Message.h"
 #include "MessageTemplate.h"
+#include <chrono>
 #include <cstdint>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <map>
@@ -12,6 +14,19 @@ namespace protocol
 {
 namespace dml
 {
+	/**
+	 * The names of the templates that differ between two
+	 * versions of a module.
+	 */
+	struct MessageModuleDiff
+	{
+		std::vector<std::string> added;
+		std::vector<std::string> removed;
+
+		// Templates whose type or record changed
+		std::vector<std::string> changed;
+	};
+
 	class MessageModule
 	{
 	public:
@@ -21,26 +36,79 @@ namespace dml
 		uint8_t get_service_id() const;
 		void set_service_id(uint8_t service_id);
 
-		std::string get_protocol_type() const;
+		const std::string &get_protocol_type() const;
 		void set_protocol_type(std::string protocol_type);
 
-		std::string get_protocol_desription() const;
+		const std::string &get_protocol_desription() const;
 		void set_protocol_description(std::string protocol_description);
 
+		/**
+		 * Returns how long MessageManager::load_module took to load this
+		 * module, or zero if it was not loaded from a file.
+		 */
+		std::chrono::microseconds get_load_time() const;
+		void set_load_time(std::chrono::microseconds load_time);
+
+		/**
+		 * Adds a template to this module, taking ownership of its record.
+		 * 
+		 * If auto_sort is true, message types are reassigned after adding
+		 * a template without _MsgOrder, which gets slower as the module
+		 * grows. Use a MessageModuleBuilder to add many templates.
+		 */
 		const MessageTemplate *add_message_template(std::string name,
 			ki::dml::Record *record, bool auto_sort = true);
+
+		/**
+		 * Adds an existing template to this module. A template type of 0
+		 * means that it is assigned from the alphabetical order of names.
+		 * 
+		 * Ownership is taken only if the returned template is the given
+		 * one; if a template with the same name already exists, then that
+		 * is returned instead, and nullptr is returned if the type is taken.
+		 */
+		const MessageTemplate *add_message_template(
+			MessageTemplate *message_template, bool auto_sort = true);
 		const MessageTemplate *get_message_template(uint8_t type) const;
-		const MessageTemplate *get_message_template(std::string name) const;
+		const MessageTemplate *get_message_template(const std::string &name) const;
+
+		std::vector<MessageTemplate *>::const_iterator templates_begin() const;
+		std::vector<MessageTemplate *>::const_iterator templates_end() const;
 
 		void sort_lookup();
 
+		/**
+		 * Enables or disables metadata stripping on every template
+		 * in this module. See MessageTemplate::set_metadata_stripped.
+		 */
+		void set_metadata_stripped(bool stripped);
+
+		/**
+		 * Writes this module in the XML format read by
+		 * MessageManager::load_module, one template at a time.
+		 */
+		void write_xml(std::ostream &ostream) const;
+
+		/**
+		 * Compares this module with a newer version of it. If previous
+		 * is nullptr, then every template in this module was added.
+		 */
+		MessageModuleDiff diff_from(const MessageModule *previous) const;
+
+		/**
+		 * Returns a hash of this module's service ID, protocol type,
+		 * and the type, name and fingerprint of each template.
+		 */
+		uint64_t get_fingerprint() const;
+
 		Message *create_message(uint8_t message_type) const;
-		Message *create_message(std::string message_name) const;
+		Message *create_message(const std::string &message_name) const;
 	private:
 		uint8_t m_service_id;
 		std::string m_protocol_type;
 		std::string m_protocol_description;
 		uint8_t m_last_message_type;
+		std::chrono::microseconds m_load_time;
 
 		std::vector<MessageTemplate *> m_templates;
 		std::map<uint8_t, MessageTemplate *> m_message_type_map;
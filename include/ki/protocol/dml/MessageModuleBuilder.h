@@ -0,0 +1,79 @@
+#pragma once
+#include "MessageModule.h"
+#include "../../dml/Record.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	/**
+	 * Collects message templates for a new MessageModule, and creates
+	 * the module with its types and lookups resolved in a single pass.
+	 *
+	 * Adding templates to a MessageModule one at a time re-sorts the
+	 * module after every unordered template, so this should be used
+	 * whenever a module is built from many templates.
+	 */
+	class MessageModuleBuilder
+	{
+	public:
+		MessageModuleBuilder(uint8_t service_id = 0, std::string protocol_type = "");
+		~MessageModuleBuilder();
+
+		MessageModuleBuilder(const MessageModuleBuilder &) = delete;
+		MessageModuleBuilder &operator=(const MessageModuleBuilder &) = delete;
+
+		void set_service_id(uint8_t service_id);
+		void set_protocol_type(std::string protocol_type);
+		void set_protocol_description(std::string protocol_description);
+
+		/**
+		 * Adds a template to the module, taking ownership of its record.
+		 *
+		 * As with MessageModule::add_message_template, the record's _MsgName
+		 * and _MsgOrder fields take priority over the given name and the
+		 * alphabetical order of template names.
+		 */
+		void add_message_template(std::string name, ki::dml::Record *record);
+
+		/**
+		 * Adds an existing template to the module, such as one that builds
+		 * its record from XML on first use, and takes ownership of it.
+		 * Its service ID is replaced with the module's.
+		 */
+		void add_message_template(MessageTemplate *message_template);
+		size_t get_template_count() const;
+
+		/**
+		 * Creates the module from every template added so far, and leaves
+		 * this builder empty. The caller owns the returned module.
+		 *
+		 * If several templates have the same name, only the first is kept.
+		 * If a template has an invalid or duplicate _MsgOrder, or there are
+		 * too many templates, then a value_error is thrown.
+		 */
+		MessageModule *build();
+	private:
+		uint8_t m_service_id;
+		std::string m_protocol_type;
+		std::string m_protocol_description;
+
+		// Either a record and its name, or a whole template
+		struct Entry
+		{
+			std::string name;
+			ki::dml::Record *record;
+			MessageTemplate *message_template;
+		};
+		std::vector<Entry> m_templates;
+
+		void clear();
+	};
+}
+}
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "../../dml/Record.h"
 #include "Message.h"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
 #include <string>
 
 namespace ki
@@ -11,12 +14,39 @@ namespace dml
 {
 	class MessageTemplate
 	{
+		friend Message;
 	public:
+		/**
+		 * Creates a template that takes ownership of a record.
+		 * 
+		 * As with MessageModule::add_message_template, the record's
+		 * _MsgName and (non-zero) _MsgOrder fields take priority over
+		 * the given name and type. They are only read here, along with
+		 * the rest of the metadata, so that none of it has to be looked
+		 * up again for each message.
+		 */
 		MessageTemplate(std::string name, uint8_t type,
 			uint8_t service_id, ki::dml::Record *record);
+
+		/**
+		 * Creates a template whose record is only built from its XML
+		 * (a complete <RECORD> element) the first time it is needed.
+		 * The template owns the XML, so it does not depend on the file
+		 * that it came from after this.
+		 * 
+		 * The handler, access level and fingerprint are given up front so
+		 * that they can be used without building the record. has_handler
+		 * is false if the record has no _MsgHandler field.
+		 */
+		MessageTemplate(std::string name, uint8_t type, uint8_t service_id,
+			std::string record_xml,
+			std::string handler, bool has_handler, uint8_t access_level, uint64_t fingerprint);
 		~MessageTemplate();
 
-		std::string get_name() const;
+		MessageTemplate(const MessageTemplate &) = delete;
+		MessageTemplate &operator=(const MessageTemplate &) = delete;
+
+		const std::string &get_name() const;
 		void set_name(std::string name);
 
 		uint8_t get_type() const;
@@ -25,22 +55,95 @@ namespace dml
 		uint8_t get_service_id() const;
 		void set_service_id(uint8_t service_id);
 
-		std::string get_handler() const;
+		const std::string &get_handler() const;
 		void set_handler(std::string handler);
 
 		uint8_t get_access_level() const;
 		void set_access_level(uint8_t access_level);
 
+		/**
+		 * Returns the template record, building it first if this
+		 * template was created from XML. Building the record is
+		 * thread-safe, and a parse_error is thrown if it fails.
+		 */
 		const ki::dml::Record &get_record() const;
 		void set_record(ki::dml::Record *record);
 
+		/**
+		 * Returns false if this template was created from XML and
+		 * its record has not been built yet.
+		 */
+		bool is_record_loaded() const;
+
+		/**
+		 * Returns the fingerprint of the template record, which is
+		 * computed whenever the record changes.
+		 * See ki::dml::Record::get_fingerprint.
+		 */
+		uint64_t get_fingerprint() const;
+
+		/**
+		 * Returns the record that new messages are copied from.
+		 * 
+		 * This is the template record itself unless metadata
+		 * stripping is enabled.
+		 */
+		const ki::dml::Record &get_message_record() const;
+
+		bool is_metadata_stripped() const;
+
+		/**
+		 * If enabled, non-transferable metadata fields (those beginning
+		 * with "_Msg", such as _MsgHandler and _MsgAccessLvl) are left out of
+		 * the records of messages created from this template.
+		 * 
+		 * The metadata is still available through this template.
+		 */
+		void set_metadata_stripped(bool stripped);
+
+		/**
+		 * Returns true if this template's record has the same fields as
+		 * another's, with the same types, transferability and values.
+		 * 
+		 * Templates that were lazily loaded from identical XML are equal
+		 * without either record being built.
+		 */
+		bool has_same_record(const MessageTemplate &other) const;
+
+		/**
+		 * Returns the number of Messages that currently use this template.
+		 */
+		size_t get_message_count() const;
+
 		Message *create_message() const;
 	private:
 		std::string m_name;
 		uint8_t m_type;
 		uint8_t m_service_id;
-		ki::dml::Record *m_record;
+		mutable ki::dml::Record *m_record;
+
+		// Metadata resolved from the record when it is assigned
+		std::string m_handler;
+		bool m_has_handler;
+		uint8_t m_access_level;
+		uint64_t m_fingerprint;
+
+		// The record copied by new messages when metadata is stripped
+		bool m_metadata_stripped;
+		mutable ki::dml::Record *m_message_record;
+
+		// The XML that a lazily loaded record is built from
+		std::string m_record_xml;
+		mutable std::once_flag m_record_once;
+		mutable std::atomic<bool> m_record_loaded;
+
+		// Updated by Message as it takes and releases this template
+		mutable std::atomic<size_t> m_message_count;
+
+		void load_record() const;
+		void update_metadata();
+		void update_message_record() const;
 	};
 }
 }
-}
\ No newline at end of file
+}
@@ -47,7 +47,9 @@ namespace protocol
 			DML_INVALID_SERVICE,
 			DML_INVALID_PROTOCOL_TYPE,
 			DML_INVALID_MESSAGE_TYPE,
-			DML_INVALID_MESSAGE_NAME
+			DML_INVALID_MESSAGE_NAME,
+			DML_UNREGISTERED_HANDLER,
+			DML_UNKNOWN_HANDLER
 		};
 
 		explicit value_error(std::string message, code error = code::NONE)
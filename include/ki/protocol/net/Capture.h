@@ -0,0 +1,117 @@
+#pragma once
+#include "../../util/MappedFile.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define KI_CAPTURE_MAGIC 0x5043494B
+#define KI_CAPTURE_VERSION 1
+#define KI_CAPTURE_FILE_HEADER_SIZE 8
+#define KI_CAPTURE_FRAME_HEADER_SIZE 16
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	enum class CaptureDirection : uint8_t
+	{
+		INBOUND,
+		OUTBOUND
+	};
+
+	/**
+	 * A single framed packet from a capture file.
+	 * 
+	 * The data includes the start signal and length, so it can be
+	 * passed straight back into Session::process_data.
+	 */
+	struct CaptureFrame
+	{
+		// Microseconds since the Unix epoch
+		uint64_t timestamp;
+		uint16_t session_id;
+		CaptureDirection direction;
+		const char *data;
+		size_t size;
+	};
+
+	/**
+	 * Writes framed packets to a capture file.
+	 * 
+	 * A capture file begins with an 8-byte header (the magic "KICP",
+	 * a 2-byte version, and 2 reserved bytes). Each frame is preceded
+	 * by a 16-byte header: the timestamp (8 bytes), session id
+	 * (2 bytes), direction (1 byte), 1 reserved byte, and the frame
+	 * size (4 bytes). Every value is little endian.
+	 * 
+	 * One writer can be shared between sessions on different threads.
+	 */
+	class CaptureWriter
+	{
+	public:
+		explicit CaptureWriter(const std::string &filepath);
+
+		CaptureWriter(const CaptureWriter &) = delete;
+		CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+		void write_frame(uint16_t session_id, CaptureDirection direction,
+			const char *data, size_t size);
+		void flush();
+
+		size_t get_frame_count() const;
+	private:
+		mutable std::mutex m_mutex;
+		std::ofstream m_stream;
+		size_t m_frame_count;
+	};
+
+	/**
+	 * Reads frames from a memory-mapped capture file.
+	 * 
+	 * Frame data points directly into the mapping, and remains valid
+	 * for as long as the reader exists.
+	 */
+	class CaptureReader
+	{
+	public:
+		explicit CaptureReader(const std::string &filepath);
+
+		CaptureReader(const CaptureReader &) = delete;
+		CaptureReader &operator=(const CaptureReader &) = delete;
+
+		/**
+		 * Reads the next frame. Returns false once there are no
+		 * frames left.
+		 */
+		bool next(CaptureFrame &frame);
+		void rewind();
+
+		/**
+		 * Returns true if the last frame in the file was incomplete,
+		 * which happens if the writer was not shut down cleanly.
+		 */
+		bool is_truncated() const;
+
+		/**
+		 * Appends the DML message from every application packet sent in
+		 * the specified direction, so that they can all be decoded with
+		 * MessageManager::decode_batch.
+		 * 
+		 * Returns the number of messages that were appended.
+		 */
+		size_t append_dml_messages(std::vector<char> &buffer,
+			CaptureDirection direction) const;
+	private:
+		util::MappedFile m_file;
+		size_t m_position;
+		bool m_truncated;
+
+		bool read_frame(size_t &position, CaptureFrame &frame) const;
+	};
+}
+}
+}
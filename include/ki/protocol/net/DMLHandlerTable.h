@@ -0,0 +1,137 @@
+#pragma once
+#include "../dml/MessageManager.h"
+#include "../../util/ReclamationDomain.h"
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	class DMLSession;
+
+	/**
+	 * Routes DML messages to callbacks based on the _MsgHandler
+	 * value of their template.
+	 * 
+	 * Handlers are registered by name, and then resolved against the
+	 * templates of a MessageManager with bind. After binding, looking up
+	 * the handler for a message is a pair of indexed loads keyed by
+	 * service id and message type.
+	 * 
+	 * Each bind publishes a new binding with its own copy of the
+	 * handlers, so handlers can be registered and bound again while
+	 * sessions are dispatching messages on other threads. Replaced
+	 * bindings are kept until collect_retired is called.
+	 * 
+	 * A binding is made from the templates that were loaded at the time.
+	 * After a module is reloaded, the table keeps routing by the old
+	 * templates' message types until it is bound again, which is_current
+	 * can be used to detect.
+	 */
+	class DMLHandlerTable
+	{
+	public:
+		typedef std::function<void(DMLSession &session, const dml::Message &message)> Handler;
+
+		DMLHandlerTable();
+		~DMLHandlerTable();
+
+		DMLHandlerTable(const DMLHandlerTable &) = delete;
+		DMLHandlerTable &operator=(const DMLHandlerTable &) = delete;
+
+		/**
+		 * Registers a handler for messages whose template has a
+		 * _MsgHandler value equal to name.
+		 * 
+		 * Registering the same name twice replaces the previous handler.
+		 * bind must be called again for the change to take effect, and
+		 * until then, messages are still dispatched to the old handler.
+		 */
+		void register_handler(std::string name, Handler handler);
+
+		/**
+		 * Resolves every registered handler to the (service id, message type)
+		 * pairs of the templates that use it.
+		 * 
+		 * A value_error is thrown if a registered handler isn't used by any
+		 * loaded template. If require_all is true, a value_error is also thrown
+		 * if any loaded template has a handler that hasn't been registered.
+		 */
+		void bind(const dml::MessageManager &manager, bool require_all = false);
+
+		/**
+		 * Deletes the bindings that have been replaced, once every
+		 * dispatch that could still be using one has returned.
+		 * 
+		 * This must not be called from inside a handler, as it would
+		 * wait for the handler to return.
+		 */
+		void collect_retired();
+
+		/**
+		 * Returns whether the table was last bound to the specified
+		 * manager, and no module has been added or replaced since.
+		 */
+		bool is_current(const dml::MessageManager &manager) const;
+
+		/**
+		 * Returns the handler bound to the specified message, or nullptr if
+		 * no handler was bound.
+		 * 
+		 * The handler remains valid until the table has been bound again
+		 * and collect_retired is then called. Use dispatch to call a
+		 * handler while the table may be bound on another thread.
+		 */
+		const Handler *get_handler(uint8_t service_id, uint8_t message_type) const;
+
+		/**
+		 * Calls the handler bound to the message, if there is one, and
+		 * returns whether there was.
+		 */
+		bool dispatch(DMLSession &session, const dml::Message &message) const;
+	private:
+		typedef std::array<const Handler *, 256> DispatchPage;
+
+		/**
+		 * The handlers seen by dispatch. A binding is never modified
+		 * once it has been published.
+		 */
+		struct Binding
+		{
+			std::map<std::string, Handler> handlers;
+			std::array<std::unique_ptr<DispatchPage>, 256> dispatch;
+			const dml::MessageManager *manager;
+			uint64_t revision;
+
+			const Handler *get_handler(uint8_t service_id, uint8_t message_type) const
+			{
+				const auto &page = dispatch[service_id];
+				if (page)
+					return (*page)[message_type];
+				return nullptr;
+			}
+		};
+		std::atomic<const Binding *> m_binding;
+
+		// Every read of m_binding is guarded, so that collect_retired
+		// knows when no dispatch can still be using a retired binding
+		util::ReclamationDomain m_readers;
+
+		// Registering and binding are done one at a time
+		std::mutex m_handlers_mutex;
+		std::map<std::string, Handler> m_handlers;
+		std::vector<const Binding *> m_retired_bindings;
+	};
+}
+}
+}
@@ -1,6 +1,15 @@
 #pragma once
 #include "Session.h"
+#include "DMLHandlerTable.h"
+#include "DMLStatistics.h"
 #include "../dml/MessageManager.h"
+#include "../../util/WorkStealingPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace ki
 {
@@ -27,17 +36,117 @@ namespace net
 	{
 	public:
 		DMLSession(uint16_t id, const dml::MessageManager &manager);
-		virtual ~DMLSession() = default;
+		virtual ~DMLSession();
 
 		const dml::MessageManager &get_manager() const;
 
-		void send_message(const dml::Message &message);
+		void send_message(const dml::Message &message, bool urgent = false);
+
+		const DMLHandlerTable *get_handler_table() const;
+
+		/**
+		 * Routes incoming messages through a bound handler table.
+		 * Messages without a bound handler still go to on_message.
+		 * The table must outlive this session.
+		 */
+		void set_handler_table(const DMLHandlerTable *handler_table);
+
+		DMLStatistics *get_message_statistics() const;
+
+		/**
+		 * Counts the messages this session decodes, handles and sends,
+		 * along with the time spent decoding and handling them. The same
+		 * statistics may be shared by several sessions, and must outlive
+		 * them. Passing nullptr stops counting.
+		 */
+		void set_message_statistics(DMLStatistics *statistics);
+
+		util::WorkStealingPool *get_dispatch_pool() const;
+
+		/**
+		 * Enables asynchronous dispatch of incoming messages.
+		 * 
+		 * When a pool is set, decoded messages are queued and on_message is
+		 * invoked on the pool's workers instead of the thread that called
+		 * process_data. Messages from the same session are always handled
+		 * one at a time, in the order they were received.
+		 * 
+		 * Handlers running on the pool must use post_message rather than
+		 * send_message. The pool must outlive this session, and every
+		 * class that overrides on_message must call stop_dispatch in its
+		 * destructor (see stop_dispatch).
+		 * 
+		 * Passing nullptr restores synchronous dispatch.
+		 */
+		void set_dispatch_pool(util::WorkStealingPool *pool);
+
+		/**
+		 * Blocks until every queued message has been handled.
+		 */
+		void wait_for_dispatch();
+
+		/**
+		 * Waits for every queued message to be handled, and then
+		 * restores synchronous dispatch.
+		 * 
+		 * Workers call the virtual on_message, so this must be called in
+		 * the destructor of the most derived session class, before any of
+		 * its members are destroyed. By the time ~DMLSession runs, the
+		 * derived parts of the session are gone, and a worker that is
+		 * still handling a message would call into a half-destroyed object.
+		 */
+		void stop_dispatch();
+
+		/**
+		 * Queues a message to be sent by the next call to
+		 * flush_posted_messages. Safe to call from any thread.
+		 */
+		void post_message(const dml::Message &message);
+
+		/**
+		 * Sends every message queued by post_message.
+		 * This must be called from the thread that owns the transport.
+		 */
+		void flush_posted_messages();
 	protected:
 		void on_application_message(const PacketHeader& header) override;
 		virtual void on_message(const dml::Message *message) {}
 		virtual void on_invalid_message(InvalidDMLMessageErrorCode error) {}
+
+		/**
+		 * Called when post_message queues a message while none were
+		 * pending, so the transport can schedule flush_posted_messages on
+		 * its own thread. This may be called from any thread.
+		 */
+		virtual void on_messages_posted() {}
 	private:
 		const dml::MessageManager &m_manager;
+		const DMLHandlerTable *m_handler_table;
+		std::atomic<DMLStatistics *> m_message_statistics;
+
+		// Asynchronous dispatch state
+		util::WorkStealingPool *m_dispatch_pool;
+		std::mutex m_dispatch_mutex;
+		std::condition_variable m_dispatch_condition;
+		std::deque<const dml::Message *> m_dispatch_queue;
+		bool m_dispatch_scheduled;
+
+		// Packets posted by handlers, waiting to be sent, along with
+		// what to count them as once they have been
+		struct PostedPacket
+		{
+			std::string data;
+			uint8_t service_id;
+			uint8_t message_type;
+			size_t message_size;
+		};
+		std::mutex m_posted_mutex;
+		std::vector<PostedPacket> m_posted_packets;
+
+		void dispatch_message(const dml::Message *message);
+		void handle_message(const dml::Message *message);
+		void invoke_handler(const dml::Message *message);
+		void drain_dispatch_queue();
 	};
 }
 }
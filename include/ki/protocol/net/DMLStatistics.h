@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	class MessageManager;
+}
+
+namespace net
+{
+	/**
+	 * A copy of the counters for one (service ID, message type) pair.
+	 *
+	 * Byte counts include the DML message header, but not the packet
+	 * header or framing.
+	 */
+	struct DMLMessageStatistics
+	{
+		uint8_t service_id;
+		uint8_t message_type;
+
+		uint64_t messages_decoded;
+		uint64_t bytes_decoded;
+		std::chrono::nanoseconds decode_time;
+
+		// Messages passed to a bound handler or on_message
+		uint64_t messages_handled;
+		std::chrono::nanoseconds handler_time;
+
+		// Messages accepted for sending; ones that the send queue's
+		// limits discard are not counted
+		uint64_t messages_encoded;
+		uint64_t bytes_encoded;
+	};
+
+	/**
+	 * Counts decoded, handled and encoded messages for every
+	 * (service ID, message type) pair, so that the message types that
+	 * use the most time or bandwidth can be found.
+	 *
+	 * Each service gets a dense array of counters, indexed by message
+	 * type, the first time one of its messages is counted. Counters are
+	 * relaxed atomics, so one instance can be shared by every session,
+	 * and snapshots can be taken from any thread.
+	 */
+	class DMLStatistics
+	{
+	public:
+		DMLStatistics();
+		~DMLStatistics();
+
+		DMLStatistics(const DMLStatistics &) = delete;
+		DMLStatistics &operator=(const DMLStatistics &) = delete;
+
+		void add_decoded(uint8_t service_id, uint8_t message_type,
+			size_t size, std::chrono::nanoseconds time);
+		void add_handled(uint8_t service_id, uint8_t message_type,
+			std::chrono::nanoseconds time);
+		void add_encoded(uint8_t service_id, uint8_t message_type, size_t size);
+
+		/**
+		 * Returns the counters of every pair that has been counted at
+		 * least once, in order of service ID and then message type.
+		 */
+		std::vector<DMLMessageStatistics> get_snapshot() const;
+
+		/**
+		 * Writes a snapshot as a table with one line per message type.
+		 * If a manager is given, it is used to name protocols and messages.
+		 */
+		void write_text(std::ostream &ostream,
+			const dml::MessageManager *manager = nullptr) const;
+
+		/**
+		 * Writes a snapshot as a JSON array with one object per message
+		 * type. Times are in nanoseconds. If a manager is given, it is
+		 * used to name protocols and messages.
+		 */
+		void write_json(std::ostream &ostream,
+			const dml::MessageManager *manager = nullptr) const;
+	private:
+		struct Counters
+		{
+			std::atomic<uint64_t> messages_decoded;
+			std::atomic<uint64_t> bytes_decoded;
+			std::atomic<uint64_t> decode_time;
+			std::atomic<uint64_t> messages_handled;
+			std::atomic<uint64_t> handler_time;
+			std::atomic<uint64_t> messages_encoded;
+			std::atomic<uint64_t> bytes_encoded;
+		};
+		using CounterRow = std::array<Counters, 256>;
+
+		std::array<std::atomic<CounterRow *>, 256> m_rows;
+
+		Counters &get_counters(uint8_t service_id, uint8_t message_type);
+	};
+}
+}
+}
@@ -1,15 +1,23 @@
 #pragma once
 #include "PacketHeader.h"
+#include "SessionStatistics.h"
 #include "../control/Opcode.h"
 #include "../../util/Serializable.h"
+#include "../../util/Allocation.h"
 #include <cstdint>
 #include <sstream>
 #include <chrono>
+#include <deque>
+#include <limits>
 #include <type_traits>
+#include <vector>
 
 #define KI_DEFAULT_MAXIMUM_RECEIVE_SIZE 0x2000
 #define KI_START_SIGNAL 0xF00D
 #define KI_CONNECTION_TIMEOUT 3
+#define KI_DEFAULT_SEND_QUEUE_HIGH_WATER_BYTES 0x40000
+#define KI_DEFAULT_SEND_QUEUE_HIGH_WATER_PACKETS 0x1000
+#define KI_DEFAULT_SEND_QUEUE_LOW_WATER_BYTES 0x10000
 
 namespace ki
 {
@@ -17,6 +25,8 @@ namespace protocol
 {
 namespace net
 {
+	class CaptureWriter;
+
 	enum class SessionCloseErrorCode
 	{
 		NONE,
@@ -30,7 +40,21 @@ namespace net
 		INVALID_MESSAGE,
 
 		SESSION_OFFER_TIMED_OUT,
-		SESSION_DIED
+		SESSION_DIED,
+
+		SEND_QUEUE_OVERFLOW
+	};
+
+	enum class SendQueuePolicy
+	{
+		// Keep queueing, and notify via on_send_queue_high.
+		NOTIFY,
+
+		// Discard packets sent while the queue is over its limits.
+		DROP,
+
+		// Close the session with SEND_QUEUE_OVERFLOW.
+		CLOSE
 	};
 
 	enum class ReceiveState
@@ -65,12 +89,112 @@ namespace net
 		uint8_t get_access_level() const;
 		void set_access_level(uint8_t access_level);
 
+		/**
+		 * Returns the round trip time of the last keep alive,
+		 * in milliseconds.
+		 */
 		uint16_t get_latency() const;
 
+		/**
+		 * Returns a snapshot of this session's traffic counters and
+		 * round trip times. Safe to call from any thread.
+		 */
+		SessionStatistics get_statistics() const;
+
 		virtual bool is_alive() const = 0;
 
-		void send_packet(bool is_control, uint8_t opcode,
-			const util::Serializable &data);
+		/**
+		 * Frames and sends a packet.
+		 * 
+		 * Urgent packets bypass coalescing, and cause anything that is
+		 * currently being coalesced to be written along with them.
+		 * Control packets are always treated as urgent.
+		 * 
+		 * Returns false if the packet was discarded because the send
+		 * queue is over its limits.
+		 */
+		bool send_packet(bool is_control, uint8_t opcode,
+			const util::Serializable &data, bool urgent = false);
+
+		bool is_coalescing() const;
+		std::chrono::microseconds get_coalescing_delay() const;
+		size_t get_coalescing_threshold() const;
+
+		/**
+		 * Enables coalescing of small packets.
+		 * 
+		 * While coalescing, packets are buffered instead of being written
+		 * straight away. The buffer is written as one send_packet_data call
+		 * once it holds at least threshold bytes, when a packet is sent more
+		 * than max_delay after the oldest buffered packet, when an urgent
+		 * packet is sent, or when flush or flush_expired is called.
+		 * 
+		 * A max_delay of zero disables coalescing.
+		 * This has no effect while the send queue is enabled.
+		 */
+		void set_coalescing(std::chrono::microseconds max_delay, size_t threshold);
+
+		/**
+		 * Writes everything that is currently buffered in one call.
+		 */
+		void flush();
+
+		/**
+		 * Writes the coalescing buffer if its oldest packet has been
+		 * waiting for longer than the coalescing delay.
+		 * 
+		 * This should be called periodically (for example, from a timer
+		 * in the event loop) so that the latency cap holds even when no
+		 * more packets are sent. Returns true if anything was written.
+		 */
+		bool flush_expired();
+
+		bool is_send_queue_enabled() const;
+
+		/**
+		 * Enables the outbound queue.
+		 * 
+		 * When enabled, framed packets are appended to the queue instead of
+		 * being passed to send_packet_data immediately, and the transport
+		 * is expected to call flush_send_queue whenever it can write.
+		 * Disabling the queue flushes anything that is still queued.
+		 */
+		void set_send_queue_enabled(bool enabled);
+
+		/**
+		 * Sets the queue limits. The queue is over its limits once it holds
+		 * more than high_water_bytes bytes or high_water_packets packets, and
+		 * stays that way until it drains to low_water_bytes bytes or fewer.
+		 */
+		void set_send_queue_limits(size_t high_water_bytes,
+			size_t high_water_packets, size_t low_water_bytes);
+
+		SendQueuePolicy get_send_queue_policy() const;
+		void set_send_queue_policy(SendQueuePolicy policy);
+
+		size_t get_queued_bytes() const;
+		size_t get_queued_packets() const;
+		bool is_send_queue_over_limits() const;
+
+		/**
+		 * Coalesces whole packets from the front of the queue, up to
+		 * maximum_bytes (but always at least one packet), into a single
+		 * send_packet_data call.
+		 * 
+		 * Returns the number of bytes that were written.
+		 */
+		size_t flush_send_queue(size_t maximum_bytes = std::numeric_limits<size_t>::max());
+
+		CaptureWriter *get_capture_writer() const;
+
+		/**
+		 * Sets the writer that every complete packet sent or received
+		 * by this session is recorded to, or nullptr to stop capturing.
+		 * 
+		 * Outbound packets are recorded when they are framed, rather than
+		 * when the transport writes them.
+		 */
+		void set_capture_writer(CaptureWriter *writer);
 	protected:
 		/* Higher-level session members */
 		uint16_t m_id;
@@ -86,8 +210,11 @@ namespace net
 		bool m_waiting_for_keep_alive_response;
 		uint16_t m_latency;
 
+		/* Statistics members */
+		SessionCounters m_counters;
+
 		// The packet data stream
-		std::stringstream m_data_stream;
+		util::CategoryStringStream<util::AllocationCategory::SESSION_BUFFER> m_data_stream;
 
 		/**
 		 * Reads a serializable structure from the data stream.
@@ -105,8 +232,9 @@ namespace net
 
 		/**
 		* Frames raw data into a Packet, and transmits it.
+		* Returns false if the send queue's limits discarded it.
 		*/
-		void send_data(const char *data, size_t size);
+		bool send_data(const char *data, size_t size, bool urgent = false);
 
 		/**
 		* Process incoming raw data into Packets.
@@ -120,6 +248,13 @@ namespace net
 		virtual void on_control_message(const PacketHeader &header) {}
 		virtual void on_application_message(const PacketHeader &header) {}
 
+		/**
+		 * Called when the send queue goes over its limits, and when it
+		 * has drained back down to its low water mark.
+		 */
+		virtual void on_send_queue_high() {}
+		virtual void on_send_queue_low() {}
+
 		/* Low-level socket methods */
 		virtual void send_packet_data(const char *data, const size_t size) = 0;
 		virtual void close(SessionCloseErrorCode error) = 0;
@@ -131,7 +266,31 @@ namespace net
 		uint16_t m_incoming_packet_size;
 		uint8_t m_shift;
 
+		/* Outbound queue members */
+		bool m_send_queue_enabled;
+		SendQueuePolicy m_send_queue_policy;
+		size_t m_send_queue_high_water_bytes;
+		size_t m_send_queue_high_water_packets;
+		size_t m_send_queue_low_water_bytes;
+		bool m_send_queue_over_limits;
+
+		// Framed packets waiting to be written, starting at
+		// m_send_buffer_offset, and the size of each of them.
+		util::CategoryVector<char, util::AllocationCategory::SESSION_BUFFER> m_send_buffer;
+		size_t m_send_buffer_offset;
+		std::deque<size_t> m_queued_packet_sizes;
+
+		/* Coalescing members */
+		std::chrono::microseconds m_coalescing_delay;
+		size_t m_coalescing_threshold;
+		std::chrono::steady_clock::time_point m_coalescing_start_time;
+
+		/* Capture members */
+		CaptureWriter *m_capture_writer;
+		std::vector<char> m_capture_buffer;
+
 		void on_packet_available();
+		bool check_send_queue_limits(size_t size);
 	};
 }
 }
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#define KI_SESSION_DECODE_ERROR_CODES 8
+#define KI_SESSION_RTT_HISTOGRAM_BUCKETS 32
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	enum class InvalidDMLMessageErrorCode;
+
+	/**
+	 * A copy of a session's traffic counters and round trip times.
+	 * 
+	 * Frame and byte counts include the 4-byte framing header. Bytes
+	 * received are counted as they arrive, even if they never become a
+	 * complete frame, and sent frames are counted when they are framed.
+	 */
+	struct SessionStatistics
+	{
+		uint64_t frames_received;
+		uint64_t bytes_received;
+		uint64_t control_messages_received;
+		uint64_t application_messages_received;
+
+		uint64_t frames_sent;
+		uint64_t bytes_sent;
+		uint64_t control_messages_sent;
+		uint64_t application_messages_sent;
+
+		// Frames with an invalid start signal, size or packet header
+		uint64_t invalid_packets;
+
+		// Indexed by InvalidDMLMessageErrorCode
+		std::array<uint64_t, KI_SESSION_DECODE_ERROR_CODES> decode_errors;
+
+		/**
+		 * Round trip times measured from keep alives. The smoothed time and
+		 * jitter are updated as in RFC 6298, with gains of 1/8 and 1/4.
+		 */
+		uint64_t rtt_samples;
+		std::chrono::microseconds last_rtt;
+		std::chrono::microseconds smoothed_rtt;
+		std::chrono::microseconds rtt_jitter;
+
+		// Bucket i counts times from 2^i up to 2^(i+1) microseconds,
+		// and bucket 0 also counts times below 1 microsecond.
+		std::array<uint64_t, KI_SESSION_RTT_HISTOGRAM_BUCKETS> rtt_histogram;
+
+		uint64_t get_decode_errors(InvalidDMLMessageErrorCode error) const;
+
+		/**
+		 * Returns the upper bound of the histogram bucket that contains
+		 * the given fraction (between 0 and 1) of round trip times, or
+		 * zero if there are no samples.
+		 */
+		std::chrono::microseconds get_rtt_percentile(double fraction) const;
+	};
+
+	/**
+	 * The live counters behind SessionStatistics.
+	 * 
+	 * Counters are relaxed atomics, so updating them never locks or
+	 * allocates, and a snapshot can be taken from any thread. Each value
+	 * in a snapshot is exact, but they may not all be from the same moment.
+	 */
+	class SessionCounters
+	{
+	public:
+		SessionCounters();
+
+		SessionCounters(const SessionCounters &) = delete;
+		SessionCounters &operator=(const SessionCounters &) = delete;
+
+		void add_bytes_received(size_t size);
+		void add_frame_received();
+		void add_message_received(bool is_control);
+		void add_frame_sent(size_t size, bool is_control);
+		void add_invalid_packet();
+		void add_decode_error(InvalidDMLMessageErrorCode error);
+
+		/**
+		 * Records a round trip time. This must only be called from
+		 * one thread at a time.
+		 */
+		void add_rtt_sample(std::chrono::microseconds rtt);
+
+		SessionStatistics get_snapshot() const;
+	private:
+		std::atomic<uint64_t> m_frames_received;
+		std::atomic<uint64_t> m_bytes_received;
+		std::atomic<uint64_t> m_control_messages_received;
+		std::atomic<uint64_t> m_application_messages_received;
+		std::atomic<uint64_t> m_frames_sent;
+		std::atomic<uint64_t> m_bytes_sent;
+		std::atomic<uint64_t> m_control_messages_sent;
+		std::atomic<uint64_t> m_application_messages_sent;
+		std::atomic<uint64_t> m_invalid_packets;
+		std::array<std::atomic<uint64_t>, KI_SESSION_DECODE_ERROR_CODES> m_decode_errors;
+
+		std::atomic<uint64_t> m_rtt_samples;
+		std::atomic<int64_t> m_last_rtt;
+		std::atomic<int64_t> m_smoothed_rtt;
+		std::atomic<int64_t> m_rtt_jitter;
+		std::array<std::atomic<uint64_t>, KI_SESSION_RTT_HISTOGRAM_BUCKETS> m_rtt_histogram;
+	};
+}
+}
+}
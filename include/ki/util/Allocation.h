@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * The kinds of internal allocations that the library can track.
+	 */
+	enum class AllocationCategory
+	{
+		FIELD,
+		RECORD,
+		MESSAGE,
+		SESSION_BUFFER,
+
+		COUNT
+	};
+
+	/**
+	 * An interface for the allocator that internal allocations are
+	 * routed through when the library is built with KI_ALLOCATION_STATS.
+	 */
+	class Allocator
+	{
+	public:
+		virtual ~Allocator() = default;
+
+		virtual void *allocate(size_t size, AllocationCategory category) = 0;
+		virtual void deallocate(void *ptr, size_t size, AllocationCategory category) = 0;
+	};
+
+	/**
+	 * Allocation counters for a single category.
+	 */
+	struct AllocationCounters
+	{
+		size_t allocations;
+		size_t deallocations;
+		size_t bytes_allocated;
+		size_t bytes_deallocated;
+	};
+
+	/**
+	 * A snapshot of the allocation counters of every category.
+	 */
+	struct AllocationStats
+	{
+		AllocationCounters categories[static_cast<size_t>(AllocationCategory::COUNT)];
+
+		const AllocationCounters &get(AllocationCategory category) const
+		{
+			return categories[static_cast<size_t>(category)];
+		}
+	};
+
+	/**
+	 * Returns true if the library was built with KI_ALLOCATION_STATS.
+	 * Otherwise, internal allocations are not routed through the
+	 * allocator and the stats are always zero.
+	 */
+	bool is_allocation_tracking_enabled();
+
+	/**
+	 * Replaces the allocator that internal allocations are routed through.
+	 * Passing nullptr restores the default allocator (::operator new).
+	 * 
+	 * This should only be called before any tracked objects exist, since
+	 * objects must be deallocated by the allocator that allocated them.
+	 */
+	void set_allocator(Allocator *allocator);
+	Allocator *get_allocator();
+
+	AllocationStats get_allocation_stats();
+	void reset_allocation_stats();
+
+	void *allocate(size_t size, AllocationCategory category);
+	void deallocate(void *ptr, size_t size, AllocationCategory category);
+
+	/**
+	 * A standard library allocator that routes through allocate and
+	 * deallocate with a fixed category.
+	 */
+	template <typename T, AllocationCategory Category>
+	class CategoryAllocator
+	{
+	public:
+		typedef T value_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef CategoryAllocator<U, Category> other;
+		};
+
+		CategoryAllocator() = default;
+
+		template <typename U>
+		CategoryAllocator(const CategoryAllocator<U, Category> &) {}
+
+		T *allocate(size_t n)
+		{
+			return static_cast<T *>(util::allocate(n * sizeof(T), Category));
+		}
+
+		void deallocate(T *ptr, size_t n)
+		{
+			util::deallocate(ptr, n * sizeof(T), Category);
+		}
+
+		template <typename U>
+		bool operator==(const CategoryAllocator<U, Category> &) const { return true; }
+
+		template <typename U>
+		bool operator!=(const CategoryAllocator<U, Category> &) const { return false; }
+	};
+
+#ifdef KI_ALLOCATION_STATS
+	template <typename T, AllocationCategory Category>
+	using CategoryVector = std::vector<T, CategoryAllocator<T, Category>>;
+
+	template <AllocationCategory Category>
+	using CategoryStringStream = std::basic_stringstream<char,
+		std::char_traits<char>, CategoryAllocator<char, Category>>;
+#else
+	template <typename T, AllocationCategory Category>
+	using CategoryVector = std::vector<T>;
+
+	template <AllocationCategory Category>
+	using CategoryStringStream = std::stringstream;
+#endif
+}
+}
+
+/**
+ * Routes heap allocations of a class (and, for polymorphic classes,
+ * its subclasses) through ki::util::allocate when the library is built
+ * with KI_ALLOCATION_STATS. Otherwise, this expands to nothing.
+ */
+#ifdef KI_ALLOCATION_STATS
+#define KI_ALLOCATION_CATEGORY(category) \
+	static void *operator new(size_t size) \
+	{ \
+		return ki::util::allocate(size, category); \
+	} \
+	static void operator delete(void *ptr, size_t size) \
+	{ \
+		ki::util::deallocate(ptr, size, category); \
+	}
+#else
+#define KI_ALLOCATION_CATEGORY(category)
+#endif
@@ -0,0 +1,165 @@
+#pragma once
+#include "Allocation.h"
+#include "FixedSizePool.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * A bump allocator that frees everything it has allocated at once.
+	 * 
+	 * Memory is carved out of large blocks, which are kept and reused
+	 * after a reset. Objects created with create are destroyed, in
+	 * reverse order, when the arena is reset or destroyed; memory from
+	 * allocate is simply reclaimed.
+	 */
+	class Arena
+	{
+	public:
+		explicit Arena(size_t block_size = 0x10000);
+		~Arena();
+
+		Arena(const Arena &) = delete;
+		Arena &operator=(const Arena &) = delete;
+
+		/**
+		 * Returns uninitialized memory that remains valid
+		 * until the next reset.
+		 */
+		void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		/**
+		 * Constructs an object inside the arena. If the object isn't
+		 * trivially destructible, its destructor is called on reset.
+		 */
+		template <typename T, typename... Args>
+		T *create(Args&&... args)
+		{
+			void *memory = allocate(sizeof(T), alignof(T));
+			T *object = ::new (memory) T(std::forward<Args>(args)...);
+			if (!std::is_trivially_destructible<T>::value)
+				register_destructor(object, &destroy<T>);
+			return object;
+		}
+
+		/**
+		 * Constructs an object inside the arena without registering its
+		 * destructor. The owner is responsible for destroying it before
+		 * the arena is reset.
+		 */
+		template <typename T, typename... Args>
+		T *create_uncollected(Args&&... args)
+		{
+			void *memory = allocate(sizeof(T), alignof(T));
+			return ::new (memory) T(std::forward<Args>(args)...);
+		}
+
+		/**
+		 * Destroys every object created with create, and makes all
+		 * of the memory available again.
+		 */
+		void reset();
+
+		size_t get_bytes_used() const;
+		size_t get_bytes_reserved() const;
+	private:
+		struct Block
+		{
+			char *data;
+			size_t size;
+		};
+
+		struct DestructorNode
+		{
+			void (*destructor)(void *);
+			void *object;
+			DestructorNode *next;
+		};
+
+		size_t m_block_size;
+		std::vector<Block> m_blocks;
+		size_t m_current_block;
+		size_t m_position;
+		size_t m_bytes_used;
+		DestructorNode *m_destructors;
+
+		void register_destructor(void *object, void (*destructor)(void *));
+
+		template <typename T>
+		static void destroy(void *object)
+		{
+			static_cast<T *>(object)->~T();
+		}
+	};
+
+	/**
+	 * A standard library allocator that allocates from an arena if it
+	 * has one, or from the per-thread FixedSizePool otherwise.
+	 * 
+	 * Memory from an arena is never freed individually.
+	 */
+	template <typename T, AllocationCategory Category>
+	class ArenaAllocator
+	{
+		template <typename U, AllocationCategory>
+		friend class ArenaAllocator;
+	public:
+		typedef T value_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef ArenaAllocator<U, Category> other;
+		};
+
+		ArenaAllocator(Arena *arena = nullptr) : m_arena(arena) {}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U, Category> &other) : m_arena(other.m_arena) {}
+
+		Arena *get_arena() const { return m_arena; }
+
+		T *allocate(size_t n)
+		{
+			if (m_arena)
+				return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+#ifdef KI_ALLOCATION_STATS
+			return static_cast<T *>(util::allocate(n * sizeof(T), Category));
+#else
+			return static_cast<T *>(FixedSizePool::allocate(n * sizeof(T)));
+#endif
+		}
+
+		void deallocate(T *ptr, size_t n)
+		{
+			if (m_arena)
+				return;
+#ifdef KI_ALLOCATION_STATS
+			util::deallocate(ptr, n * sizeof(T), Category);
+#else
+			FixedSizePool::deallocate(ptr, n * sizeof(T));
+#endif
+		}
+
+		template <typename U>
+		bool operator==(const ArenaAllocator<U, Category> &other) const
+		{
+			return m_arena == other.m_arena;
+		}
+
+		template <typename U>
+		bool operator!=(const ArenaAllocator<U, Category> &other) const
+		{
+			return m_arena != other.m_arena;
+		}
+	private:
+		Arena *m_arena;
+	};
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * Builds a 64-bit FNV-1a hash from a sequence of values.
+	 * 
+	 * Values are hashed in little endian byte order, and strings are
+	 * prefixed with their size, so the result is the same on every
+	 * platform and can be compared between processes.
+	 */
+	class Fingerprint
+	{
+	public:
+		Fingerprint();
+
+		void add(const char *data, size_t size);
+		void add(const std::string &value);
+		void add(uint64_t value);
+
+		uint64_t get_value() const;
+	private:
+		uint64_t m_value;
+
+		void add_bytes(const char *data, size_t size);
+	};
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * Caches freed blocks of small, fixed sizes so that they can be
+	 * reused without going back to the heap.
+	 * 
+	 * Each thread has its own cache, so no locking is required. Blocks
+	 * may be freed on a different thread to the one that allocated them.
+	 * Allocations larger than the largest size class go straight
+	 * to ::operator new.
+	 */
+	class FixedSizePool
+	{
+	public:
+		static const size_t size_class_granularity = 16;
+		static const size_t maximum_pooled_size = 256;
+		static const size_t maximum_cached_blocks = 1024;
+
+		static void *allocate(size_t size);
+		static void deallocate(void *ptr, size_t size);
+	};
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * A read-only view of a whole file, mapped into memory.
+	 */
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		/**
+		 * Maps the file at the specified path, closing any file
+		 * that is currently mapped.
+		 * 
+		 * Returns false if the file could not be opened or mapped.
+		 * Empty files can be opened, but have no data.
+		 * 
+		 * If copy_on_write is true, the data can also be modified through
+		 * get_mutable_data. Only the pages that are modified are copied,
+		 * and changes are never written back to the file.
+		 */
+		bool open(const std::string &filepath, bool copy_on_write = false);
+		void close();
+
+		bool is_open() const;
+		const char *get_data() const;
+		size_t get_size() const;
+
+		/**
+		 * Returns the mapped data if the file was opened with
+		 * copy_on_write, or a nullptr otherwise.
+		 */
+		char *get_mutable_data() const;
+
+		/**
+		 * Returns true if the byte after the data can be read and is
+		 * zero. Mappings are zero-filled to the end of their last page,
+		 * so this is true unless the size is a multiple of the page size.
+		 */
+		bool has_null_terminator() const;
+	private:
+		const char *m_data;
+		size_t m_size;
+		bool m_open;
+		bool m_copy_on_write;
+
+#ifdef _WIN32
+		void *m_file_handle;
+		void *m_mapping_handle;
+#endif
+	};
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <streambuf>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * A read-only stream buffer over memory owned by someone else.
+	 *
+	 * This lets a std::istream read from an existing buffer without
+	 * copying it into a std::string first, and can be pointed at a new
+	 * buffer without reconstructing the stream.
+	 */
+	class MemoryStreambuf : public std::streambuf
+	{
+	public:
+		MemoryStreambuf(const char *data = nullptr, const size_t size = 0)
+		{
+			reset(data, size);
+		}
+
+		void reset(const char *data, const size_t size)
+		{
+			char *begin = const_cast<char *>(data);
+			setg(begin, begin, begin + size);
+		}
+
+		size_t get_remaining() const
+		{
+			return egptr() - gptr();
+		}
+	};
+}
+}
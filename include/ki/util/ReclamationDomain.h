@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#define KI_RECLAMATION_STRIPES 16
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * Tracks readers of data that is published through atomic pointers,
+	 * so that data which has been replaced can be freed once no reader
+	 * can still be using it.
+	 *
+	 * Readers hold a ReadGuard for as long as they use anything they
+	 * loaded from a published pointer. A writer that has unpublished
+	 * something calls synchronize, which waits for every guard that
+	 * existed when it was called to be released. After that, nothing can
+	 * reach the unpublished data, and it can be freed.
+	 *
+	 * The published pointers must be stored and loaded with
+	 * std::memory_order_seq_cst (the default), so that a reader that
+	 * synchronize doesn't wait for is certain to see the new data.
+	 *
+	 * Entering and leaving a guard is one atomic increment and decrement
+	 * of a counter, spread over KI_RECLAMATION_STRIPES cache lines so
+	 * that threads rarely share one. Guards can be nested.
+	 */
+	class ReclamationDomain
+	{
+	public:
+		class ReadGuard
+		{
+		public:
+			explicit ReadGuard(const ReclamationDomain &domain);
+			~ReadGuard();
+
+			ReadGuard(const ReadGuard &) = delete;
+			ReadGuard &operator=(const ReadGuard &) = delete;
+		private:
+			std::atomic<size_t> *m_counter;
+		};
+
+		ReclamationDomain();
+
+		ReclamationDomain(const ReclamationDomain &) = delete;
+		ReclamationDomain &operator=(const ReclamationDomain &) = delete;
+
+		/**
+		 * Blocks until every ReadGuard that was held when this was
+		 * called has been released. Guards taken after this is called
+		 * don't delay it.
+		 *
+		 * This must not be called while the calling thread holds a
+		 * ReadGuard on the same domain, as it would wait for itself.
+		 */
+		void synchronize();
+	private:
+		// Padded so that each counter has a cache line to itself
+		struct Counter
+		{
+			std::atomic<size_t> readers;
+			char padding[64 - sizeof(std::atomic<size_t>)];
+		};
+		typedef std::array<Counter, KI_RECLAMATION_STRIPES> CounterStripes;
+
+		// Readers count themselves in the stripes chosen by the parity
+		// of the epoch, which synchronize advances.
+		mutable std::array<CounterStripes, 2> m_counters;
+		std::atomic<size_t> m_epoch;
+		std::mutex m_synchronize_mutex;
+
+		void wait_for_readers(const CounterStripes &stripes) const;
+	};
+}
+}
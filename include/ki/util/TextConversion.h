@@ -0,0 +1,136 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * Appends the decimal representation of an integer to a buffer.
+	 * 
+	 * Unlike iostreams, this is unaffected by the current locale, and
+	 * 8-bit integers are written as numbers rather than characters.
+	 */
+	template <typename IntT>
+	void append_number(std::string &buffer, const IntT value)
+	{
+		static_assert(std::is_integral<IntT>::value, "IntT must be an integer type.");
+		typedef typename std::make_unsigned<IntT>::type UnsignedT;
+
+		// Negate in unsigned arithmetic so that the minimum value works
+		UnsignedT magnitude = static_cast<UnsignedT>(value);
+		const bool negative = value < 0;
+		if (negative)
+			magnitude = static_cast<UnsignedT>(0 - magnitude);
+
+		char digits[24];
+		char *end = digits + sizeof(digits);
+		char *begin = end;
+		do
+		{
+			*--begin = static_cast<char>('0' + magnitude % 10);
+			magnitude /= 10;
+		} while (magnitude != 0);
+		if (negative)
+			*--begin = '-';
+
+		buffer.append(begin, end);
+	}
+
+	/**
+	 * Appends a decimal representation of a floating point number that
+	 * parses back to exactly the same value, in the same format as %g
+	 * with just enough precision for that.
+	 * 
+	 * The digits are found with Grisu2, which gives the shortest ones for
+	 * nearly every value. Neither this nor parse_number depend on the
+	 * current locale, and the decimal point is always '.'.
+	 */
+	void append_number(std::string &buffer, float value);
+	void append_number(std::string &buffer, double value);
+
+	/**
+	 * Narrows the range [begin, end) to exclude leading and trailing
+	 * whitespace, as recognised by isspace in the C locale.
+	 */
+	inline void trim_whitespace(const char *&begin, const char *&end)
+	{
+		while (begin != end && (*begin == ' ' || (*begin >= '\t' && *begin <= '\r')))
+			++begin;
+		while (begin != end && (end[-1] == ' ' || (end[-1] >= '\t' && end[-1] <= '\r')))
+			--end;
+	}
+
+	/**
+	 * Parses a decimal integer from the range [begin, end).
+	 * 
+	 * Leading and trailing whitespace is ignored. Returns false, leaving
+	 * value untouched, if the range holds anything else or the number
+	 * does not fit in IntT.
+	 */
+	template <typename IntT>
+	bool parse_number(const char *begin, const char *end, IntT &value)
+	{
+		static_assert(std::is_integral<IntT>::value, "IntT must be an integer type.");
+
+		trim_whitespace(begin, end);
+
+		bool negative = false;
+		if (begin != end && (*begin == '-' || *begin == '+'))
+		{
+			negative = *begin == '-';
+			++begin;
+			if (negative && !std::is_signed<IntT>::value)
+				return false;
+		}
+		if (begin == end)
+			return false;
+
+		// The largest magnitude allowed, which is one more than the
+		// maximum for negative signed values.
+		uint64_t limit = static_cast<uint64_t>(std::numeric_limits<IntT>::max());
+		if (negative)
+			limit += 1;
+
+		uint64_t magnitude = 0;
+		for (; begin != end; ++begin)
+		{
+			if (*begin < '0' || *begin > '9')
+				return false;
+
+			const unsigned digit = *begin - '0';
+			if (magnitude > (limit - digit) / 10)
+				return false;
+			magnitude = magnitude * 10 + digit;
+		}
+
+		if (negative)
+			value = static_cast<IntT>(0 - magnitude);
+		else
+			value = static_cast<IntT>(magnitude);
+		return true;
+	}
+
+	/**
+	 * Parses a floating point number from the range [begin, end), in
+	 * the same format as strtod in the C locale, without hexadecimal
+	 * numbers. The result is correctly rounded.
+	 * 
+	 * Leading and trailing whitespace is ignored. Returns false, leaving
+	 * value untouched, if the range holds anything else.
+	 */
+	bool parse_number(const char *begin, const char *end, float &value);
+	bool parse_number(const char *begin, const char *end, double &value);
+
+	/**
+	 * Replaces the characters in buffer from position onwards that
+	 * can't appear as-is in XML text or attribute values (&, <, > and ")
+	 * with their entity references.
+	 */
+	void escape_xml(std::string &buffer, size_t position);
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * Appends the UTF-8 encoding of the UTF-16 range [begin, end)
+	 * to a buffer.
+	 *
+	 * Returns false if the range contains an unpaired surrogate, in
+	 * which case the buffer is left as it was.
+	 */
+	bool append_utf8(std::string &buffer, const char16_t *begin, const char16_t *end);
+
+	/**
+	 * Appends the UTF-16 encoding of the UTF-8 range [begin, end)
+	 * to a buffer.
+	 *
+	 * Returns false if the range is not valid UTF-8 (including overlong
+	 * forms, encoded surrogates and code points above U+10FFFF), in which
+	 * case the buffer is left as it was.
+	 */
+	bool append_utf16(std::u16string &buffer, const char *begin, const char *end);
+}
+}
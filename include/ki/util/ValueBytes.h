@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 
 namespace ki
 {
@@ -7,4 +10,49 @@ namespace ki
 		ValueT value = 0;
 		char buff[sizeof(ValueT)];
 	};
+
+	/**
+	 * Returns true if this machine stores the most significant
+	 * byte of a value first.
+	 */
+	inline bool is_big_endian()
+	{
+		ValueBytes<uint16_t> endianness_check;
+		endianness_check.value = 0x0102;
+		return endianness_check.buff[0] == 0x01;
+	}
+
+	/**
+	 * Converts the bytes of a value between little endian (the byte
+	 * order that DML uses) and this machine's byte order. The same
+	 * call works in both directions.
+	 */
+	template <typename ValueT>
+	void convert_little_endian(ValueBytes<ValueT> &data)
+	{
+		if (is_big_endian())
+			std::reverse(&data.buff[0], &data.buff[sizeof(ValueT)]);
+	}
+
+	/**
+	 * Writes an integer to a buffer in little endian byte order.
+	 */
+	template <typename IntT>
+	void write_le(char *buffer, const IntT value)
+	{
+		for (size_t i = 0; i < sizeof(IntT); ++i)
+			buffer[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+	}
+
+	/**
+	 * Reads an integer from a buffer in little endian byte order.
+	 */
+	template <typename IntT>
+	IntT read_le(const char *buffer)
+	{
+		IntT value = 0;
+		for (size_t i = 0; i < sizeof(IntT); ++i)
+			value |= static_cast<IntT>(static_cast<uint8_t>(buffer[i])) << (i * 8);
+		return value;
+	}
 }
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ki
+{
+namespace util
+{
+	/**
+	 * A fixed-size thread pool where each worker owns a task queue.
+	 * 
+	 * Tasks submitted from a worker thread are pushed onto that worker's
+	 * own queue; tasks submitted from any other thread are distributed
+	 * round-robin. Idle workers steal from the front of other workers'
+	 * queues, while owners pop from the back.
+	 */
+	class WorkStealingPool
+	{
+	public:
+		typedef std::function<void()> Task;
+
+		/**
+		 * Creates a pool with the specified number of workers.
+		 * If thread_count is 0, the hardware concurrency is used.
+		 */
+		explicit WorkStealingPool(size_t thread_count = 0);
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool &) = delete;
+		WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+		size_t get_thread_count() const;
+
+		/**
+		 * Queues a task to be executed by one of the workers.
+		 */
+		void submit(Task task);
+
+		/**
+		 * Blocks until every submitted task has finished executing.
+		 */
+		void wait_idle();
+	private:
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::vector<std::thread> m_threads;
+		std::atomic<size_t> m_next_worker;
+		// Signed, as a worker may take a task before submit counts it
+		std::atomic<std::ptrdiff_t> m_queued_tasks;
+		std::atomic<size_t> m_pending_tasks;
+		bool m_stopping;
+
+		std::mutex m_wake_mutex;
+		std::condition_variable m_wake_condition;
+		std::condition_variable m_idle_condition;
+
+		void run(size_t index);
+		bool pop_task(size_t index, Task &task);
+		bool steal_task(size_t index, Task &task);
+	};
+}
+}
@@ -1,5 +1,7 @@
 #include "ki/dml/FieldBase.h"
 #include "ki/dml/Field.h"
+#include "ki/util/FixedSizePool.h"
+#include <cstring>
 
 namespace ki
 {
@@ -7,12 +9,30 @@ namespace dml
 {
 	FieldBase::FieldBase(std::string name)
 	{
-		m_name = name;
+		m_name = std::move(name);
 		m_transferable = true;
 		m_type_hash = 0;
 	}
 
-	std::string FieldBase::get_name() const
+	void *FieldBase::operator new(const size_t size)
+	{
+#ifdef KI_ALLOCATION_STATS
+		return util::allocate(size, util::AllocationCategory::FIELD);
+#else
+		return util::FixedSizePool::allocate(size);
+#endif
+	}
+
+	void FieldBase::operator delete(void *ptr, const size_t size)
+	{
+#ifdef KI_ALLOCATION_STATS
+		util::deallocate(ptr, size, util::AllocationCategory::FIELD);
+#else
+		util::FixedSizePool::deallocate(ptr, size);
+#endif
+	}
+
+	const std::string &FieldBase::get_name() const
 	{
 		return m_name;
 	}
@@ -22,44 +42,64 @@ namespace dml
 		return m_transferable;
 	}
 
+	std::string FieldBase::get_value_string() const
+	{
+		std::string value;
+		append_value_string(value);
+		return value;
+	}
+
+	void FieldBase::set_value_from_string(const std::string &value)
+	{
+		set_value_from_string(value.data(), value.data() + value.length());
+	}
+
+	bool FieldBase::xml_text_equals(const char *data, const size_t size, const char *text)
+	{
+		return std::strlen(text) == size && std::memcmp(data, text, size) == 0;
+	}
+
 	FieldBase* FieldBase::create_from_xml(const rapidxml::xml_node<>* node)
 	{
 		auto *type_attr = node->first_attribute("TYPE");
 		if (!type_attr)
 		{
 			std::ostringstream oss;
-			oss << "XML Field node is missing required TYPE attribute (" << node->name() << ").";
+			oss << "XML Field node is missing required TYPE attribute ("
+				<< std::string(node->name(), node->name_size()) << ").";
 			throw value_error(oss.str());
 		}
-		const std::string type = type_attr->value();
+		const char *type = type_attr->value();
+		const size_t type_size = type_attr->value_size();
 
 		FieldBase *field;
-		if (type == "BYT")
+		if (xml_text_equals(type, type_size, "BYT"))
 			field = new BytField("");
-		else if (type == "UBYT")
+		else if (xml_text_equals(type, type_size, "UBYT"))
 			field = new UBytField("");
-		else if (type == "SHRT")
+		else if (xml_text_equals(type, type_size, "SHRT"))
 			field = new ShrtField("");
-		else if (type == "USHRT")
+		else if (xml_text_equals(type, type_size, "USHRT"))
 			field = new UShrtField("");
-		else if (type == "INT")
+		else if (xml_text_equals(type, type_size, "INT"))
 			field = new IntField("");
-		else if (type == "UINT")
+		else if (xml_text_equals(type, type_size, "UINT"))
 			field = new UIntField("");
-		else if (type == "STR")
+		else if (xml_text_equals(type, type_size, "STR"))
 			field = new StrField("");
-		else if (type == "WSTR")
+		else if (xml_text_equals(type, type_size, "WSTR"))
 			field = new WStrField("");
-		else if (type == "FLT")
+		else if (xml_text_equals(type, type_size, "FLT"))
 			field = new FltField("");
-		else if (type == "DBL")
+		else if (xml_text_equals(type, type_size, "DBL"))
 			field = new DblField("");
-		else if (type == "GID")
+		else if (xml_text_equals(type, type_size, "GID"))
 			field = new GidField("");
 		else
 		{
 			std::ostringstream oss;
-			oss << "Unknown DML type \"" << type << "\" in XML Field node: " << node->name() << ".";
+			oss << "Unknown DML type \"" << std::string(type, type_size) << "\" in XML Field node: "
+				<< std::string(node->name(), node->name_size()) << ".";
 			throw value_error(oss.str());
 		}
 
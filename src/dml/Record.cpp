@@ -1,5 +1,7 @@
 #include "ki/dml/Record.h"
+#include "ki/util/Fingerprint.h"
 #include <algorithm>
+#include <cstring>
 
 namespace ki
 {
@@ -7,54 +9,138 @@ namespace dml
 {
 	Record::Record()
 	{
-		m_fields = FieldList();
-		m_field_map = FieldNameMap();
+		m_fields = ArenaFieldList();
+		m_field_map = ArenaFieldNameMap();
+		m_arena = nullptr;
+		m_fixed_size = 0;
+	}
+
+	Record::Record(util::Arena *arena)
+		: m_fields(ArenaFieldList::allocator_type(arena)),
+		m_field_map(ArenaFieldNameMap::key_compare(), ArenaFieldNameMap::allocator_type(arena)),
+		m_variable_fields(ArenaFieldList::allocator_type(arena))
+	{
+		m_arena = arena;
+		m_fixed_size = 0;
 	}
 
 	Record::~Record()
 	{
-		for (auto it = m_fields.begin(); it != m_fields.end(); ++it)
-			delete *it;
-		m_fields.clear();
-		m_field_map.clear();
+		clear();
 	}
 
 	Record::Record(const Record& record)
 	{
+		m_arena = nullptr;
+		m_fixed_size = 0;
+		m_fields.reserve(record.m_fields.size());
+		for (auto it = record.fields_begin(); it != record.fields_end(); ++it)
+			add_field((*it)->clone(nullptr));
+	}
+
+	Record::Record(const Record& record, util::Arena *arena)
+		: m_fields(ArenaFieldList::allocator_type(arena)),
+		m_field_map(ArenaFieldNameMap::key_compare(), ArenaFieldNameMap::allocator_type(arena)),
+		m_variable_fields(ArenaFieldList::allocator_type(arena))
+	{
+		m_arena = arena;
+		m_fixed_size = 0;
+		m_fields.reserve(record.m_fields.size());
+		for (auto it = record.fields_begin(); it != record.fields_end(); ++it)
+			add_field((*it)->clone(m_arena));
+	}
+
+	Record::Record(Record &&record)
+		: m_fields(std::move(record.m_fields)),
+		m_field_map(std::move(record.m_field_map)),
+		m_variable_fields(std::move(record.m_variable_fields))
+	{
+		m_arena = record.m_arena;
+		m_fixed_size = record.m_fixed_size;
+		record.m_fields.clear();
+		record.m_field_map.clear();
+		record.m_variable_fields.clear();
+		record.m_fixed_size = 0;
+	}
+
+	Record &Record::operator=(const Record &record)
+	{
+		if (this == &record)
+			return *this;
+
+		clear();
+		m_fields.reserve(record.m_fields.size());
 		for (auto it = record.fields_begin(); it != record.fields_end(); ++it)
-			add_field((*it)->clone());
+			add_field((*it)->clone(m_arena));
+		return *this;
 	}
 
-	bool Record::has_field(std::string name) const
+	Record &Record::operator=(Record &&record)
+	{
+		// Fields can only change hands within the same arena
+		if (m_arena != record.m_arena)
+			return *this = static_cast<const Record &>(record);
+
+		if (this != &record)
+		{
+			clear();
+			m_fields.swap(record.m_fields);
+			m_field_map.swap(record.m_field_map);
+			m_variable_fields.swap(record.m_variable_fields);
+			std::swap(m_fixed_size, record.m_fixed_size);
+		}
+		return *this;
+	}
+
+	util::Arena *Record::get_arena() const
+	{
+		return m_arena;
+	}
+
+	bool Record::has_field(const std::string &name) const
 	{
 		return m_field_map.count(name);
 	}
 
-	FieldBase *Record::get_field(std::string name)
+	FieldBase *Record::get_field(const std::string &name)
 	{
 		if (has_field(name))
 			return m_field_map.at(name);
 		return nullptr;
 	}
 
-	const FieldBase *Record::get_field(std::string name) const
+	const FieldBase *Record::get_field(const std::string &name) const
 	{
 		if (has_field(name))
 			return m_field_map.at(name);
 		return nullptr;
 	}
 
+	bool Record::remove_field(const std::string &name)
+	{
+		auto it = m_field_map.find(name);
+		if (it == m_field_map.end())
+			return false;
+
+		FieldBase *field = it->second;
+		m_field_map.erase(it);
+		m_fields.erase(std::find(m_fields.begin(), m_fields.end(), field));
+		destroy_field(field);
+		update_sizes();
+		return true;
+	}
+
 	size_t Record::get_field_count() const
 	{
 		return m_fields.size();
 	}
 
-	FieldList::const_iterator Record::fields_begin() const
+	Record::const_iterator Record::fields_begin() const
 	{
 		return m_fields.begin();
 	}
 
-	FieldList::const_iterator Record::fields_end() const
+	Record::const_iterator Record::fields_end() const
 	{
 		return m_fields.end();
 	}
@@ -79,19 +165,81 @@ namespace dml
 
 	size_t Record::get_size() const
 	{
-		size_t size = 0;
+		size_t size = m_fixed_size;
+		for (auto it = m_variable_fields.begin(); it != m_variable_fields.end(); ++it)
+			size += (*it)->get_size();
+		return size;
+	}
+
+	bool Record::is_fixed_size() const
+	{
+		return m_variable_fields.empty();
+	}
+
+	size_t Record::get_minimum_size() const
+	{
+		// Variable-length values are prefixed with a USHRT length
+		return m_fixed_size + m_variable_fields.size() * sizeof(USHRT);
+	}
+
+	uint64_t Record::get_fingerprint() const
+	{
+		util::Fingerprint fingerprint;
 		for (auto it = m_fields.begin(); it != m_fields.end(); ++it)
 		{
-			if ((*it)->is_transferable())
-				size += (*it)->get_size();
+			const auto *field = *it;
+			fingerprint.add(field->get_name());
+			fingerprint.add(field->get_type_name(), std::strlen(field->get_type_name()));
+			fingerprint.add(static_cast<uint64_t>(field->is_transferable()));
 		}
-		return size;
+		return fingerprint.get_value();
 	}
 
 	void Record::add_field(FieldBase* field)
 	{
 		m_fields.push_back(field);
 		m_field_map.insert({ field->get_name(), field });
+
+		if (!field->is_transferable())
+			return;
+		if (field->is_fixed_size())
+			m_fixed_size += field->get_size();
+		else
+			m_variable_fields.push_back(field);
+	}
+
+	void Record::update_sizes()
+	{
+		m_fixed_size = 0;
+		m_variable_fields.clear();
+		for (auto it = m_fields.begin(); it != m_fields.end(); ++it)
+		{
+			if (!(*it)->is_transferable())
+				continue;
+			if ((*it)->is_fixed_size())
+				m_fixed_size += (*it)->get_size();
+			else
+				m_variable_fields.push_back(*it);
+		}
+	}
+
+	void Record::destroy_field(FieldBase* field) const
+	{
+		// Fields inside an arena are freed when the arena is reset
+		if (m_arena)
+			field->~FieldBase();
+		else
+			delete field;
+	}
+
+	void Record::clear()
+	{
+		for (auto it = m_fields.begin(); it != m_fields.end(); ++it)
+			destroy_field(*it);
+		m_fields.clear();
+		m_field_map.clear();
+		m_variable_fields.clear();
+		m_fixed_size = 0;
 	}
 
 	rapidxml::xml_node<> *Record::as_xml(rapidxml::xml_document<> &doc) const
@@ -102,14 +250,22 @@ namespace dml
 		return node;
 	}
 
+	void Record::write_xml(std::string &buffer) const
+	{
+		buffer.append("<RECORD>");
+		for (auto it = m_fields.begin(); it != m_fields.end(); ++it)
+			(*it)->write_xml(buffer);
+		buffer.append("</RECORD>");
+	}
+
 	void Record::from_xml(rapidxml::xml_node<> *node)
 	{
 		// Make sure that we've been passed a <RECORD> element.
-		const std::string node_name = node->name();
-		if (node_name != "RECORD")
+		if (!FieldBase::xml_text_equals(node->name(), node->name_size(), "RECORD"))
 		{
 			std::ostringstream oss;
-			oss << "Expected <RECORD> node but got <" << node->name() << ">.";
+			oss << "Expected <RECORD> node but got <"
+				<< std::string(node->name(), node->name_size()) << ">.";
 			throw value_error(oss.str());
 		}
 
@@ -121,6 +277,14 @@ namespace dml
 				continue;
 
 			FieldBase *field = FieldBase::create_from_xml(field_node);
+			if (m_arena)
+			{
+				// Move the new field into our arena
+				FieldBase *arena_field = field->clone(m_arena);
+				delete field;
+				field = arena_field;
+			}
+
 			if (has_field(field->get_name()))
 			{
 				// Is the old field the same type as the one created from
@@ -131,7 +295,7 @@ namespace dml
 					// Set the value of the old field to the value of the new
 					// one.
 					old_field->set_value(field);
-					delete field;
+					destroy_field(field);
 				}
 				else
 				{
@@ -142,7 +306,8 @@ namespace dml
 						m_fields.begin(), m_fields.end(), old_field) - m_fields.begin();
 					m_fields[index] = field;
 					m_field_map[field->get_name()] = field;
-					delete old_field;
+					destroy_field(old_field);
+					update_sizes();
 				}
 			}
 			else
@@ -40,20 +40,17 @@ namespace dml
 	}
 
 	template <>
-	std::string BytField::get_value_string() const
+	void BytField::set_value_from_string(const char *begin, const char *end)
 	{
-		std::ostringstream oss;
-		oss << (int16_t)m_value;
-		return oss.str();
-	}
-
-	template <>
-	void BytField::set_value_from_string(std::string value)
-	{
-		std::istringstream iss(value);
-		int16_t temp = 0;
-		iss >> temp;
+		// Accept both signed and unsigned values
+		int16_t temp;
+		if (!util::parse_number(begin, end, temp))
+		{
+			std::ostringstream oss;
+			oss << "Invalid BYT value \"" << std::string(begin, end) << "\" (" << m_name << ").";
+			throw value_error(oss.str());
+		}
 		m_value = temp & 0xFF;
 	}
 }
-}
\ No newline at end of file
+}
@@ -11,11 +11,7 @@ namespace dml
 	{
 		ValueBytes<FLT> data;
 		data.value = m_value;
-
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[4]);
+		convert_little_endian(data);
 		
 		ostream.write(data.buff, sizeof(FLT));
 	}
@@ -32,10 +28,7 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[4]);
+		convert_little_endian(data);
 		m_value = data.value;
 	}
 
@@ -11,8 +11,7 @@ namespace dml
 	{
 		ValueBytes<GID> data;
 		data.value = m_value;
-		if (data.buff[0] == ((m_value & 0xFF00000000000000) >> 56))
-			std::reverse(&data.buff[0], &data.buff[8]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(GID));
 	}
 
@@ -28,10 +27,7 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[8]);
+		convert_little_endian(data);
 
 		m_value = data.value;
 	}
@@ -11,8 +11,7 @@ namespace dml
 	{
 		ValueBytes<SHRT> data;
 		data.value = m_value;
-		if (data.buff[0] == ((m_value & 0xFF00) >> 8))
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(SHRT));
 	}
 
@@ -28,10 +27,7 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<SHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 
 		m_value = data.value;
 	}
@@ -11,8 +11,7 @@ namespace dml
 	{
 		ValueBytes<USHRT> data;
 		data.value = m_value.length();
-		if (data.buff[0] == ((m_value.length() & 0xFF00) >> 8))
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(USHRT));
 		ostream.write(m_value.data(), m_value.length());
 	}
@@ -30,23 +29,21 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&length_data.buff[0], &length_data.buff[2]);
+		convert_little_endian(length_data);
 
-		// Read the data into a buffer
-		char *data = new char[length_data.value];
-		istream.read(data, length_data.value);
+		// Read straight into our value, which reuses its storage once it
+		// has grown large enough. A short read leaves the value empty
+		// rather than holding a partially read string.
+		m_value.resize(length_data.value);
+		if (length_data.value)
+			istream.read(&m_value[0], length_data.value);
 		if (istream.fail())
 		{
+			m_value.clear();
 			std::ostringstream oss;
 			oss << "Not enough data was available to read STR value (" << m_name << ").";
 			throw parse_error(oss.str());
 		}
-
-		m_value = STR(data, length_data.value);
-		delete[] data;
 	}
 
 	template <>
@@ -62,15 +59,15 @@ namespace dml
 	}
 
 	template <>
-	std::string StrField::get_value_string() const
+	void StrField::append_value_string(std::string &buffer) const
 	{
-		return m_value;
+		buffer.append(m_value);
 	}
 
 	template <>
-	void StrField::set_value_from_string(std::string value)
+	void StrField::set_value_from_string(const char *begin, const char *end)
 	{
-		m_value = value;
+		m_value.assign(begin, end);
 	}
 }
 }
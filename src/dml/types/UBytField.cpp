@@ -40,19 +40,15 @@ namespace dml
 	}
 
 	template <>
-	std::string UBytField::get_value_string() const
+	void UBytField::set_value_from_string(const char *begin, const char *end)
 	{
-		std::ostringstream oss;
-		oss << (uint16_t)m_value;
-		return oss.str();
-	}
-
-	template <>
-	void UBytField::set_value_from_string(std::string value)
-	{
-		std::istringstream iss(value);
-		uint16_t temp = 0;
-		iss >> temp;
+		uint16_t temp;
+		if (!util::parse_number(begin, end, temp))
+		{
+			std::ostringstream oss;
+			oss << "Invalid UBYT value \"" << std::string(begin, end) << "\" (" << m_name << ").";
+			throw value_error(oss.str());
+		}
 		m_value = temp & 0xFF;
 	}
 }
@@ -11,8 +11,7 @@ namespace dml
 	{
 		ValueBytes<UINT> data;
 		data.value = m_value;
-		if (data.buff[0] == ((m_value & 0xFF000000) >> 24))
-			std::reverse(&data.buff[0], &data.buff[4]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(UINT));
 	}
 
@@ -28,10 +27,7 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[4]);
+		convert_little_endian(data);
 
 		m_value = data.value;
 	}
@@ -11,16 +11,13 @@ namespace dml
 	{
 		ValueBytes<USHRT> data;
 		data.value = m_value;
-		if (data.buff[0] == ((m_value & 0xFF00) >> 8))
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(USHRT));
 	}
 
 	template <>
 	void UShrtField::read_from(std::istream &istream)
 	{
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
 		ValueBytes<USHRT> data;
 		istream.read(data.buff, sizeof(USHRT));
 		if (istream.fail())
@@ -30,8 +27,7 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 		m_value = data.value;
 	}
 
@@ -1,8 +1,7 @@
 #include "ki/dml/Field.h"
 #include "ki/util/ValueBytes.h"
+#include "ki/util/Unicode.h"
 #include <algorithm>
-#include <locale>
-#include <codecvt>
 
 namespace ki
 {
@@ -13,8 +12,7 @@ namespace dml
 	{
 		ValueBytes<USHRT> data;
 		data.value = m_value.length();
-		if (data.buff[0] == ((m_value.length() & 0xFF00) >> 8))
-			std::reverse(&data.buff[0], &data.buff[2]);
+		convert_little_endian(data);
 		ostream.write(data.buff, sizeof(USHRT));
 		ostream.write((char *)m_value.data(), m_value.length() * sizeof(char16_t));
 	}
@@ -32,17 +30,19 @@ namespace dml
 			throw parse_error(oss.str());
 		}
 
-		ValueBytes<USHRT> endianness_check;
-		endianness_check.value = 0x0102;
-		if (endianness_check.buff[0] == 0x01)
-			std::reverse(&length_data.buff[0], &length_data.buff[2]);
+		convert_little_endian(length_data);
 
-		// Read the data into a buffer
-		size_t length = length_data.value * sizeof(char16_t);
-		char *data = new char[length];
-		istream.read(data, length);
+		// Read straight into our value, which reuses its storage once it
+		// has grown large enough. A short read leaves the value empty
+		// rather than holding a partially read string.
+		const size_t length = length_data.value * sizeof(char16_t);
+		m_value.resize(length_data.value);
+		char *data = reinterpret_cast<char *>(&m_value[0]);
+		if (length)
+			istream.read(data, length);
 		if (istream.fail())
 		{
+			m_value.clear();
 			std::ostringstream oss;
 			oss << "Not enough data was available to read WSTR value (" << m_name << ").";
 			throw parse_error(oss.str());
@@ -50,14 +50,11 @@ namespace dml
 
 		// Reverse each character from little endian to big endian
 		// if memory is supposed to be in big endian on this PC.
-		for (int i = 0; i < length; i += 2)
+		if (is_big_endian())
 		{
-			if (endianness_check.buff[0] == 0x01)
+			for (size_t i = 0; i < length; i += 2)
 				std::reverse(&data[i], &data[i + 2]);
 		}
-
-		m_value = WSTR((char16_t *)data, length_data.value);
-		delete[] data;
 	}
 
 	template <>
@@ -73,29 +70,27 @@ namespace dml
 	}
 
 	template <>
-	std::string WStrField::get_value_string() const
+	void WStrField::append_value_string(std::string &buffer) const
 	{
-#if _MSC_VER >= 1900
-		std::wstring_convert<std::codecvt_utf8_utf16<int16_t>, int16_t> convert;
-		auto p = reinterpret_cast<const int16_t *>(m_value.data());
-		STR temp = convert.to_bytes(p, p + m_value.size());
-#else
-		std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-		STR temp = convert.to_bytes(m_value);
-#endif
-		return temp;
+		if (!util::append_utf8(buffer, m_value.data(), m_value.data() + m_value.length()))
+		{
+			std::ostringstream oss;
+			oss << "WSTR value contains an unpaired surrogate (" << m_name << ").";
+			throw value_error(oss.str());
+		}
 	}
 
 	template <>
-	void WStrField::set_value_from_string(std::string value)
+	void WStrField::set_value_from_string(const char *begin, const char *end)
 	{
-#if _MSC_VER >= 1900
-		std::wstring_convert<std::codecvt_utf8_utf16<int16_t>, int16_t> convert;
-		m_value = reinterpret_cast<const char16_t *>(convert.from_bytes(value).data());
-#else
-		std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-		m_value = convert.from_bytes(value);
-#endif
+		WSTR value;
+		if (!util::append_utf16(value, begin, end))
+		{
+			std::ostringstream oss;
+			oss << "Invalid UTF-8 in WSTR value (" << m_name << ").";
+			throw value_error(oss.str());
+		}
+		m_value.swap(value);
 	}
 }
 }
@@ -0,0 +1,235 @@
+#include "ki/protocol/dml/FingerprintTable.h"
+#include "ki/protocol/exception.h"
+#include "ki/dml/Record.h"
+#include "ki/util/Fingerprint.h"
+#include <algorithm>
+#include <sstream>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	FingerprintTable::FingerprintTable()
+	{
+		m_fingerprint = util::Fingerprint().get_value();
+	}
+
+	FingerprintTable::FingerprintTable(const MessageManager &manager)
+	{
+		const auto modules = manager.get_modules();
+		for (auto it = modules.begin(); it != modules.end(); ++it)
+		{
+			const auto *message_module = *it;
+			ModuleEntry entry;
+			entry.service_id = message_module->get_service_id();
+			entry.fingerprint = message_module->get_fingerprint();
+			for (auto template_it = message_module->templates_begin();
+				template_it != message_module->templates_end(); ++template_it)
+				entry.templates.push_back({ (*template_it)->get_type(), (*template_it)->get_fingerprint() });
+			std::sort(entry.templates.begin(), entry.templates.end());
+			m_modules.push_back(std::move(entry));
+		}
+		std::sort(m_modules.begin(), m_modules.end(),
+			[](const ModuleEntry &a, const ModuleEntry &b)
+		{
+			return a.service_id < b.service_id;
+		});
+
+		// The same as MessageManager::get_fingerprint, but from the
+		// same modules as the rest of the table.
+		util::Fingerprint fingerprint;
+		for (auto it = m_modules.begin(); it != m_modules.end(); ++it)
+			fingerprint.add(it->fingerprint);
+		m_fingerprint = fingerprint.get_value();
+	}
+
+	uint64_t FingerprintTable::get_fingerprint() const
+	{
+		return m_fingerprint;
+	}
+
+	uint64_t FingerprintTable::get_module_fingerprint(const uint8_t service_id) const
+	{
+		const auto *entry = find_module(service_id);
+		if (entry)
+			return entry->fingerprint;
+		return 0;
+	}
+
+	uint64_t FingerprintTable::get_template_fingerprint(
+		const uint8_t service_id, const uint8_t message_type) const
+	{
+		const auto *entry = find_module(service_id);
+		if (!entry)
+			return 0;
+
+		auto it = std::lower_bound(entry->templates.begin(), entry->templates.end(),
+			std::make_pair(message_type, uint64_t(0)));
+		if (it != entry->templates.end() && it->first == message_type)
+			return it->second;
+		return 0;
+	}
+
+	std::vector<FingerprintMismatch> FingerprintTable::compare(const FingerprintTable &other) const
+	{
+		std::vector<FingerprintMismatch> mismatches;
+		if (m_fingerprint == other.m_fingerprint)
+			return mismatches;
+
+		// Both tables are sorted, so walk through them together
+		auto it = m_modules.begin();
+		auto other_it = other.m_modules.begin();
+		while (it != m_modules.end() || other_it != other.m_modules.end())
+		{
+			if (other_it == other.m_modules.end() ||
+				(it != m_modules.end() && it->service_id < other_it->service_id))
+			{
+				mismatches.push_back({ it->service_id, 0 });
+				++it;
+				continue;
+			}
+			if (it == m_modules.end() || other_it->service_id < it->service_id)
+			{
+				mismatches.push_back({ other_it->service_id, 0 });
+				++other_it;
+				continue;
+			}
+
+			if (it->fingerprint != other_it->fingerprint)
+			{
+				const size_t count = mismatches.size();
+				auto template_it = it->templates.begin();
+				auto other_template_it = other_it->templates.begin();
+				while (template_it != it->templates.end() ||
+					other_template_it != other_it->templates.end())
+				{
+					if (other_template_it == other_it->templates.end() ||
+						(template_it != it->templates.end() && template_it->first < other_template_it->first))
+						mismatches.push_back({ it->service_id, (template_it++)->first });
+					else if (template_it == it->templates.end() || other_template_it->first < template_it->first)
+						mismatches.push_back({ it->service_id, (other_template_it++)->first });
+					else
+					{
+						if (template_it->second != other_template_it->second)
+							mismatches.push_back({ it->service_id, template_it->first });
+						++template_it;
+						++other_template_it;
+					}
+				}
+
+				// Every template matched, so something else changed
+				if (mismatches.size() == count)
+					mismatches.push_back({ it->service_id, 0 });
+			}
+			++it;
+			++other_it;
+		}
+		return mismatches;
+	}
+
+	void FingerprintTable::write_to(std::ostream &ostream) const
+	{
+		ki::dml::Record record;
+		record.add_field<ki::dml::GID>("m_fingerprint")->set_value(m_fingerprint);
+		record.add_field<ki::dml::USHRT>("m_module_count")->set_value(
+			static_cast<uint16_t>(m_modules.size()));
+		record.write_to(ostream);
+
+		ki::dml::Record module_record;
+		auto *service_id = module_record.add_field<ki::dml::UBYT>("m_service_id");
+		auto *module_fingerprint = module_record.add_field<ki::dml::GID>("m_fingerprint");
+		auto *template_count = module_record.add_field<ki::dml::UBYT>("m_template_count");
+
+		ki::dml::Record template_record;
+		auto *type = template_record.add_field<ki::dml::UBYT>("m_type");
+		auto *template_fingerprint = template_record.add_field<ki::dml::GID>("m_fingerprint");
+
+		for (auto it = m_modules.begin(); it != m_modules.end(); ++it)
+		{
+			service_id->set_value(it->service_id);
+			module_fingerprint->set_value(it->fingerprint);
+			template_count->set_value(static_cast<uint8_t>(it->templates.size()));
+			module_record.write_to(ostream);
+
+			for (auto template_it = it->templates.begin();
+				template_it != it->templates.end(); ++template_it)
+			{
+				type->set_value(template_it->first);
+				template_fingerprint->set_value(template_it->second);
+				template_record.write_to(ostream);
+			}
+		}
+	}
+
+	void FingerprintTable::read_from(std::istream &istream)
+	{
+		ki::dml::Record record;
+		const auto *fingerprint = record.add_field<ki::dml::GID>("m_fingerprint");
+		const auto *module_count = record.add_field<ki::dml::USHRT>("m_module_count");
+
+		ki::dml::Record module_record;
+		const auto *service_id = module_record.add_field<ki::dml::UBYT>("m_service_id");
+		const auto *module_fingerprint = module_record.add_field<ki::dml::GID>("m_fingerprint");
+		const auto *template_count = module_record.add_field<ki::dml::UBYT>("m_template_count");
+
+		ki::dml::Record template_record;
+		const auto *type = template_record.add_field<ki::dml::UBYT>("m_type");
+		const auto *template_fingerprint = template_record.add_field<ki::dml::GID>("m_fingerprint");
+
+		// Only replace this table once the whole of the other one is read
+		std::vector<ModuleEntry> modules;
+		try
+		{
+			record.read_from(istream);
+			for (uint16_t i = 0; i < module_count->get_value(); ++i)
+			{
+				module_record.read_from(istream);
+				ModuleEntry entry;
+				entry.service_id = service_id->get_value();
+				entry.fingerprint = module_fingerprint->get_value();
+				for (uint8_t j = 0; j < template_count->get_value(); ++j)
+				{
+					template_record.read_from(istream);
+					entry.templates.push_back({ type->get_value(), template_fingerprint->get_value() });
+				}
+				modules.push_back(std::move(entry));
+			}
+		}
+		catch (ki::dml::parse_error &e)
+		{
+			std::ostringstream oss;
+			oss << "Error reading FingerprintTable: " << e.what();
+			throw parse_error(oss.str(), parse_error::INVALID_MESSAGE_DATA);
+		}
+
+		m_fingerprint = fingerprint->get_value();
+		m_modules = std::move(modules);
+	}
+
+	size_t FingerprintTable::get_size() const
+	{
+		size_t size = sizeof(ki::dml::GID) + sizeof(ki::dml::USHRT);
+		for (auto it = m_modules.begin(); it != m_modules.end(); ++it)
+		{
+			size += sizeof(ki::dml::UBYT) + sizeof(ki::dml::GID) + sizeof(ki::dml::UBYT);
+			size += it->templates.size() * (sizeof(ki::dml::UBYT) + sizeof(ki::dml::GID));
+		}
+		return size;
+	}
+
+	const FingerprintTable::ModuleEntry *FingerprintTable::find_module(const uint8_t service_id) const
+	{
+		auto it = std::lower_bound(m_modules.begin(), m_modules.end(), service_id,
+			[](const ModuleEntry &entry, const uint8_t id)
+		{
+			return entry.service_id < id;
+		});
+		if (it != m_modules.end() && it->service_id == service_id)
+			return &*it;
+		return nullptr;
+	}
+}
+}
+}
@@ -8,18 +8,89 @@ namespace protocol
 {
 namespace dml
 {
-	Message::Message(const MessageTemplate *message_template)
+	Message::Message(const MessageTemplate *message_template,
+		util::Arena *arena)
 	{
-		m_template = message_template;
+		m_template = nullptr;
+		reference_template(message_template);
+		m_record = nullptr;
+		m_arena = arena;
 		if (m_template)
-			m_record = new ki::dml::Record(m_template->get_record());
-		else
-			m_record = nullptr;
+			create_record();
+	}
+
+	Message::Message(const Message &message)
+	{
+		m_template = nullptr;
+		reference_template(message.m_template);
+		m_record = nullptr;
+		m_arena = nullptr;
+		m_header = message.m_header;
+		m_raw_data = message.m_raw_data;
+		if (message.m_record)
+			m_record = new ki::dml::Record(*message.m_record);
+	}
+
+	Message::Message(Message &&message)
+		: m_header(message.m_header), m_raw_data(std::move(message.m_raw_data))
+	{
+		m_template = message.m_template;
+		m_record = message.m_record;
+		m_arena = message.m_arena;
+		message.m_template = nullptr;
+		message.m_record = nullptr;
+		message.m_raw_data.clear();
 	}
 
 	Message::~Message()
 	{
-		delete m_record;
+		destroy_record();
+		reference_template(nullptr);
+	}
+
+	Message &Message::operator=(const Message &message)
+	{
+		if (this == &message)
+			return *this;
+
+		destroy_record();
+		reference_template(message.m_template);
+		m_header = message.m_header;
+		m_raw_data = message.m_raw_data;
+		if (message.m_record)
+		{
+			if (m_arena)
+				m_record = m_arena->create_uncollected<ki::dml::Record>(*message.m_record, m_arena);
+			else
+				m_record = new ki::dml::Record(*message.m_record);
+		}
+		return *this;
+	}
+
+	Message &Message::operator=(Message &&message)
+	{
+		// Records can only change hands within the same arena
+		if (m_arena != message.m_arena)
+			return *this = static_cast<const Message &>(message);
+
+		if (this != &message)
+		{
+			destroy_record();
+			reference_template(nullptr);
+			m_template = message.m_template;
+			m_record = message.m_record;
+			m_header = message.m_header;
+			m_raw_data = std::move(message.m_raw_data);
+			message.m_template = nullptr;
+			message.m_record = nullptr;
+			message.m_raw_data.clear();
+		}
+		return *this;
+	}
+
+	util::Arena *Message::get_arena() const
+	{
+		return m_arena;
 	}
 
 	const MessageTemplate *Message::get_template() const
@@ -29,11 +100,11 @@ namespace dml
 
 	void Message::set_template(const MessageTemplate *message_template)
 	{
-		m_template = message_template;
+		reference_template(message_template);
 		if (!m_template)
 			return;
 
-		m_record = new ki::dml::Record(message_template->get_record());
+		create_record();
 		if (!m_raw_data.empty())
 		{
 			std::istringstream iss(std::string(m_raw_data.data(), m_raw_data.size()));
@@ -44,9 +115,8 @@ namespace dml
 			}
 			catch (ki::dml::parse_error &e)
 			{
-				delete m_record;
-				m_template = nullptr;
-				m_record = nullptr;
+				destroy_record();
+				reference_template(nullptr);
 
 				std::ostringstream oss;
 				oss << "Error reading DML message payload: " << e.what();
@@ -76,11 +146,12 @@ namespace dml
 		return m_raw_data.size();
 	}
 
-	std::string Message::get_handler() const
+	const std::string &Message::get_handler() const
 	{
+		static const std::string no_handler;
 		if (m_template)
 			return m_template->get_handler();
-		return "";
+		return no_handler;
 	}
 
 	uint8_t Message::get_access_level() const
@@ -100,14 +171,14 @@ namespace dml
 		return m_record;
 	}
 
-	ki::dml::FieldBase* Message::get_field(std::string name)
+	ki::dml::FieldBase* Message::get_field(const std::string &name)
 	{
 		if  (m_record)
 			return m_record->get_field(name);
 		return nullptr;
 	}
 
-	const ki::dml::FieldBase* Message::get_field(std::string name) const
+	const ki::dml::FieldBase* Message::get_field(const std::string &name) const
 	{
 		if (m_record)
 			return m_record->get_field(name);
@@ -168,6 +239,41 @@ namespace dml
 			return m_header.get_size() + m_record->get_size();
 		return 4 + m_raw_data.size();
 	}
+
+	void Message::reference_template(const MessageTemplate *message_template)
+	{
+		if (message_template == m_template)
+			return;
+
+		if (message_template)
+			message_template->m_message_count.fetch_add(1, std::memory_order_relaxed);
+		if (m_template)
+			m_template->m_message_count.fetch_sub(1, std::memory_order_release);
+		m_template = message_template;
+	}
+
+	void Message::create_record()
+	{
+		destroy_record();
+
+		const auto &template_record = m_template->get_message_record();
+		if (m_arena)
+			m_record = m_arena->create_uncollected<ki::dml::Record>(template_record, m_arena);
+		else
+			m_record = new ki::dml::Record(template_record);
+	}
+
+	void Message::destroy_record()
+	{
+		if (!m_record)
+			return;
+
+		if (m_arena)
+			m_record->~Record();
+		else
+			delete m_record;
+		m_record = nullptr;
+	}
 }
 }
 }
\ No newline at end of file
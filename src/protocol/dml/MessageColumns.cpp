@@ -0,0 +1,345 @@
+#include "ki/protocol/dml/MessageColumns.h"
+#include "ki/protocol/exception.h"
+#include "ki/util/ValueBytes.h"
+#include <limits>
+#include <sstream>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	namespace
+	{
+		/**
+		 * Throws if appending a number of bytes to a string column would
+		 * leave an end offset that does not fit in 32 bits.
+		 */
+		void check_column_size(const MessageColumn &column, const size_t size)
+		{
+			if (size > std::numeric_limits<uint32_t>::max() - column.data.size())
+			{
+				std::ostringstream oss;
+				oss << "Column \"" << column.name << "\" would exceed the 4 GiB limit of its offsets.";
+				throw value_error(oss.str(), value_error::EXCEEDS_LIMIT);
+			}
+		}
+
+		template <typename ValueT>
+		bool field_matches(const ki::dml::FieldBase &field)
+		{
+			return field.is_type<ValueT>();
+		}
+
+		template <typename ValueT>
+		void append_fixed(MessageColumn &column, const ki::dml::FieldBase &field)
+		{
+			ValueBytes<ValueT> bytes;
+			bytes.value = static_cast<const ki::dml::Field<ValueT> &>(field).get_value();
+			convert_little_endian(bytes);
+			column.data.insert(column.data.end(), bytes.buff, bytes.buff + sizeof(ValueT));
+		}
+
+		void append_str(MessageColumn &column, const ki::dml::FieldBase &field)
+		{
+			const auto &value = static_cast<const ki::dml::StrField &>(field).get_value();
+			check_column_size(column, value.length());
+			column.data.insert(column.data.end(), value.begin(), value.end());
+			column.offsets.push_back(column.data.size());
+		}
+
+		void append_wstr(MessageColumn &column, const ki::dml::FieldBase &field)
+		{
+			const auto &value = static_cast<const ki::dml::WStrField &>(field).get_value();
+			check_column_size(column, value.length() * sizeof(char16_t));
+			const size_t position = column.data.size();
+			column.data.resize(position + value.length() * sizeof(char16_t));
+
+			char *buffer = column.data.data() + position;
+			for (auto it = value.begin(); it != value.end(); ++it)
+			{
+				write_le<uint16_t>(buffer, *it);
+				buffer += sizeof(char16_t);
+			}
+			column.offsets.push_back(column.data.size());
+		}
+
+		template <typename IntT>
+		void write_int(std::ostream &ostream, const IntT value)
+		{
+			char buffer[sizeof(IntT)];
+			write_le<IntT>(buffer, value);
+			ostream.write(buffer, sizeof(IntT));
+		}
+
+		template <typename IntT>
+		IntT read_int(std::istream &istream)
+		{
+			char buffer[sizeof(IntT)];
+			istream.read(buffer, sizeof(IntT));
+			if (istream.fail())
+				throw parse_error("Not enough data was available to read columns.",
+					parse_error::INSUFFICIENT_MESSAGE_DATA);
+			return read_le<IntT>(buffer);
+		}
+
+		void write_string(std::ostream &ostream, const std::string &value)
+		{
+			write_int<uint16_t>(ostream, value.length());
+			ostream.write(value.data(), value.length());
+		}
+
+		std::string read_string(std::istream &istream)
+		{
+			std::string value(read_int<uint16_t>(istream), '\0');
+			if (!value.empty())
+				istream.read(&value[0], value.length());
+			if (istream.fail())
+				throw parse_error("Not enough data was available to read columns.",
+					parse_error::INSUFFICIENT_MESSAGE_DATA);
+			return value;
+		}
+
+		size_t get_value_size(const std::string &type_name)
+		{
+			if (type_name == "BYT" || type_name == "UBYT")
+				return 1;
+			if (type_name == "SHRT" || type_name == "USHRT")
+				return 2;
+			if (type_name == "INT" || type_name == "UINT" || type_name == "FLT")
+				return 4;
+			if (type_name == "DBL" || type_name == "GID")
+				return 8;
+			return 0;
+		}
+	}
+
+	MessageColumns::MessageColumns()
+	{
+		m_template = nullptr;
+		m_row_count = 0;
+	}
+
+	MessageColumns::MessageColumns(const MessageTemplate &message_template)
+	{
+		m_template = &message_template;
+		m_row_count = 0;
+
+		const auto &record = message_template.get_message_record();
+		size_t index = 0;
+		for (auto it = record.fields_begin(); it != record.fields_end(); ++it, ++index)
+		{
+			const auto &field = **it;
+			if (!field.is_transferable())
+				continue;
+
+			MessageColumn column;
+			column.name = field.get_name();
+			column.type_name = field.get_type_name();
+			column.value_size = get_value_size(column.type_name);
+
+			Appender appender;
+			if (field.is_type<ki::dml::BYT>())
+				appender = { &field_matches<ki::dml::BYT>, &append_fixed<ki::dml::BYT> };
+			else if (field.is_type<ki::dml::UBYT>())
+				appender = { &field_matches<ki::dml::UBYT>, &append_fixed<ki::dml::UBYT> };
+			else if (field.is_type<ki::dml::SHRT>())
+				appender = { &field_matches<ki::dml::SHRT>, &append_fixed<ki::dml::SHRT> };
+			else if (field.is_type<ki::dml::USHRT>())
+				appender = { &field_matches<ki::dml::USHRT>, &append_fixed<ki::dml::USHRT> };
+			else if (field.is_type<ki::dml::INT>())
+				appender = { &field_matches<ki::dml::INT>, &append_fixed<ki::dml::INT> };
+			else if (field.is_type<ki::dml::UINT>())
+				appender = { &field_matches<ki::dml::UINT>, &append_fixed<ki::dml::UINT> };
+			else if (field.is_type<ki::dml::FLT>())
+				appender = { &field_matches<ki::dml::FLT>, &append_fixed<ki::dml::FLT> };
+			else if (field.is_type<ki::dml::DBL>())
+				appender = { &field_matches<ki::dml::DBL>, &append_fixed<ki::dml::DBL> };
+			else if (field.is_type<ki::dml::GID>())
+				appender = { &field_matches<ki::dml::GID>, &append_fixed<ki::dml::GID> };
+			else if (field.is_type<ki::dml::STR>())
+				appender = { &field_matches<ki::dml::STR>, &append_str };
+			else
+				appender = { &field_matches<ki::dml::WSTR>, &append_wstr };
+
+			if (!column.is_fixed_size())
+				column.offsets.push_back(0);
+			m_columns.push_back(column);
+			m_field_indices.push_back(index);
+			m_appenders.push_back(appender);
+		}
+	}
+
+	const MessageTemplate *MessageColumns::get_template() const
+	{
+		return m_template;
+	}
+
+	size_t MessageColumns::get_row_count() const
+	{
+		return m_row_count;
+	}
+
+	size_t MessageColumns::get_column_count() const
+	{
+		return m_columns.size();
+	}
+
+	const MessageColumn &MessageColumns::get_column(const size_t index) const
+	{
+		return m_columns.at(index);
+	}
+
+	const MessageColumn *MessageColumns::get_column(const std::string &name) const
+	{
+		for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+		{
+			if (it->name == name)
+				return &*it;
+		}
+		return nullptr;
+	}
+
+	void MessageColumns::append(const Message &message)
+	{
+		const auto *record = message.get_record();
+		if (!m_template || message.get_template() != m_template || !record)
+			throw value_error("Message was not created from the template used by these columns.",
+				value_error::DML_INVALID_MESSAGE_TYPE);
+
+		// Check the whole layout first, so that a bad message can't
+		// leave the columns with different lengths.
+		const auto fields = record->fields_begin();
+		for (size_t i = 0; i < m_columns.size(); ++i)
+		{
+			const size_t index = m_field_indices[i];
+			if (index >= record->get_field_count() ||
+				!m_appenders[i].matches(*fields[index]) ||
+				fields[index]->get_name() != m_columns[i].name)
+			{
+				std::ostringstream oss;
+				oss << "Message record does not match the template layout at field \""
+					<< m_columns[i].name << "\".";
+				throw value_error(oss.str(), value_error::DML_INVALID_MESSAGE_TYPE);
+			}
+		}
+
+		size_t i = 0;
+		try
+		{
+			for (; i < m_columns.size(); ++i)
+				m_appenders[i].append(m_columns[i], *fields[m_field_indices[i]]);
+		}
+		catch (...)
+		{
+			// Take the row back out of the columns that already have it
+			while (i-- > 0)
+			{
+				auto &column = m_columns[i];
+				if (column.is_fixed_size())
+					column.data.resize(m_row_count * column.value_size);
+				else
+				{
+					column.offsets.pop_back();
+					column.data.resize(column.offsets.back());
+				}
+			}
+			throw;
+		}
+		m_row_count++;
+	}
+
+	void MessageColumns::clear()
+	{
+		for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+		{
+			it->data.clear();
+			it->offsets.clear();
+			if (!it->is_fixed_size())
+				it->offsets.push_back(0);
+		}
+		m_row_count = 0;
+	}
+
+	void MessageColumns::write_to(std::ostream &ostream) const
+	{
+		write_int<uint32_t>(ostream, KI_COLUMNS_MAGIC);
+		write_int<uint16_t>(ostream, KI_COLUMNS_VERSION);
+		write_int<uint16_t>(ostream, m_columns.size());
+		write_int<uint32_t>(ostream, m_row_count);
+
+		for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+		{
+			write_string(ostream, it->name);
+			write_string(ostream, it->type_name);
+			if (!it->is_fixed_size())
+			{
+				for (auto offset_it = it->offsets.begin(); offset_it != it->offsets.end(); ++offset_it)
+					write_int<uint32_t>(ostream, *offset_it);
+			}
+			ostream.write(it->data.data(), it->data.size());
+		}
+	}
+
+	void MessageColumns::read_from(std::istream &istream)
+	{
+		if (read_int<uint32_t>(istream) != KI_COLUMNS_MAGIC)
+			throw parse_error("Data does not contain message columns.", parse_error::INVALID_HEADER_DATA);
+		if (read_int<uint16_t>(istream) != KI_COLUMNS_VERSION)
+			throw parse_error("Message columns version is not supported.", parse_error::INVALID_HEADER_DATA);
+
+		const size_t column_count = read_int<uint16_t>(istream);
+		const size_t row_count = read_int<uint32_t>(istream);
+
+		std::vector<MessageColumn> columns(column_count);
+		for (auto it = columns.begin(); it != columns.end(); ++it)
+		{
+			it->name = read_string(istream);
+			it->type_name = read_string(istream);
+			it->value_size = get_value_size(it->type_name);
+
+			size_t data_size = row_count * it->value_size;
+			if (!it->is_fixed_size())
+			{
+				it->offsets.resize(row_count + 1);
+				uint32_t last_offset = 0;
+				for (auto offset_it = it->offsets.begin(); offset_it != it->offsets.end(); ++offset_it)
+				{
+					*offset_it = read_int<uint32_t>(istream);
+					if (*offset_it < last_offset || (offset_it == it->offsets.begin() && *offset_it != 0))
+						throw parse_error("String column has invalid offsets.",
+							parse_error::INVALID_MESSAGE_DATA);
+					last_offset = *offset_it;
+				}
+				data_size = last_offset;
+			}
+
+			it->data.resize(data_size);
+			istream.read(it->data.data(), data_size);
+			if (istream.fail())
+				throw parse_error("Not enough data was available to read columns.",
+					parse_error::INSUFFICIENT_MESSAGE_DATA);
+		}
+
+		// Columns that were read back can't be appended to
+		m_template = nullptr;
+		m_row_count = row_count;
+		m_columns.swap(columns);
+		m_field_indices.clear();
+		m_appenders.clear();
+	}
+
+	size_t MessageColumns::get_size() const
+	{
+		size_t size = 12;
+		for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+		{
+			size += 4 + it->name.length() + it->type_name.length();
+			size += it->offsets.size() * sizeof(uint32_t) + it->data.size();
+		}
+		return size;
+	}
+}
+}
+}
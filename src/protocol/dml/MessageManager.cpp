@@ -2,9 +2,20 @@
 #include "ki/protocol/dml/MessageHeader.h"
 #include "ki/protocol/exception.h"
 #include "ki/dml/Record.h"
+#include "ki/dml/exception.h"
+#include "ki/util/Fingerprint.h"
+#include "ki/util/MappedFile.h"
+#include "ki/util/MemoryStreambuf.h"
 #include "ki/util/ValueBytes.h"
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <vector>
 #include <rapidxml.hpp>
 
 namespace ki
@@ -13,151 +24,558 @@ namespace protocol
 {
 namespace dml
 {
+	namespace
+	{
+		/**
+		 * Sets the module metadata from a _ProtocolInfo record.
+		 */
+		void set_protocol_info(MessageModuleBuilder &builder, const ki::dml::Record &record)
+		{
+			auto *service_id_field = record.get_field<ki::dml::UBYT>("ServiceID");
+			auto *type_field = record.get_field<ki::dml::STR>("ProtocolType");
+			auto *description_field = record.get_field<ki::dml::STR>("ProtocolDescription");
+			if (service_id_field)
+				builder.set_service_id(service_id_field->get_value());
+			if (type_field)
+				builder.set_protocol_type(type_field->get_value());
+			if (description_field)
+				builder.set_protocol_description(description_field->get_value());
+		}
+
+		/**
+		 * Returns the size of a <RECORD> element in the text that it was
+		 * parsed from, including its start and end tags.
+		 */
+		size_t get_record_xml_size(const rapidxml::xml_node<> *record_node)
+		{
+			const char *begin = record_node->name() - 1;
+			if (std::string(record_node->name(), record_node->name_size()) != "RECORD")
+			{
+				std::ostringstream oss;
+				oss << "Expected <RECORD> node but got <"
+					<< std::string(record_node->name(), record_node->name_size()) << ">.";
+				throw ki::dml::value_error(oss.str());
+			}
+
+			// An empty element may close itself
+			const char *position = record_node->name() + record_node->name_size();
+			auto *last_field_node = record_node->first_node() ? record_node->last_node() : nullptr;
+			if (!last_field_node)
+			{
+				position = std::strchr(position, '>');
+				if (position && *(position - 1) == '/')
+					return position + 1 - begin;
+			}
+			else if (last_field_node->value_size() > 0)
+				position = last_field_node->value() + last_field_node->value_size();
+			else
+				position = last_field_node->name() + last_field_node->name_size();
+
+			// The end tag is the first one after the last field
+			while (position && (position = std::strstr(position, "</RECORD")))
+			{
+				position += 8;
+				const char next = *position;
+				if (next == '>' || next == ' ' || next == '\t' || next == '\r' || next == '\n')
+				{
+					position = std::strchr(position, '>');
+					if (position)
+						return position + 1 - begin;
+				}
+			}
+			throw parse_error("Could not find the end of a <RECORD> element.", parse_error::INVALID_XML_DATA);
+		}
+
+		/**
+		 * Returns the field with the given name and type from a
+		 * <RECORD> element, or nullptr if there isn't one.
+		 */
+		template <typename ValueT>
+		ki::dml::Field<ValueT> *create_field_from_xml(
+			const rapidxml::xml_node<> *record_node, const char *name)
+		{
+			auto *field_node = record_node->first_node(name);
+			if (!field_node)
+				return nullptr;
+
+			auto *field = ki::dml::FieldBase::create_from_xml(field_node);
+			if (field->is_type<ValueT>())
+				return static_cast<ki::dml::Field<ValueT> *>(field);
+			delete field;
+			return nullptr;
+		}
+
+		/**
+		 * Translates the entity and character references in a value that
+		 * was parsed with parse_non_destructive, so that it matches what
+		 * a normal parse would have given.
+		 */
+		std::string translate_entities(const std::string &value)
+		{
+			if (value.find('&') == std::string::npos)
+				return value;
+
+			// Let RapidXML do the translation by parsing the value as the
+			// text of an element.
+			std::vector<char> data;
+			data.reserve(value.size() + 8);
+			const char *begin_tag = "<v>";
+			const char *end_tag = "</v>";
+			data.insert(data.end(), begin_tag, begin_tag + 3);
+			data.insert(data.end(), value.begin(), value.end());
+			data.insert(data.end(), end_tag, end_tag + 4);
+			data.push_back('\0');
+
+			rapidxml::xml_document<> doc;
+			doc.parse<rapidxml::parse_no_string_terminators | rapidxml::parse_no_data_nodes>(data.data());
+			auto *node = doc.first_node();
+			return std::string(node->value(), node->value_size());
+		}
+
+		/**
+		 * Returns the same fingerprint as ki::dml::Record::get_fingerprint
+		 * would for the record built from a <RECORD> element.
+		 */
+		uint64_t get_fingerprint(const rapidxml::xml_node<> *record_node)
+		{
+			util::Fingerprint fingerprint;
+			for (auto *field_node = record_node->first_node();
+				field_node; field_node = field_node->next_sibling())
+			{
+				fingerprint.add(field_node->name(), field_node->name_size());
+
+				auto *type_attribute = field_node->first_attribute("TYPE");
+				if (type_attribute)
+					fingerprint.add(type_attribute->value(), type_attribute->value_size());
+				else
+					fingerprint.add("", 0);
+
+				auto *noxfer_attribute = field_node->first_attribute("NOXFER");
+				const bool transferable = !noxfer_attribute || std::string(
+					noxfer_attribute->value(), noxfer_attribute->value_size()) != "TRUE";
+				fingerprint.add(static_cast<uint64_t>(transferable));
+			}
+			return fingerprint.get_value();
+		}
+
+		/**
+		 * Creates a template that builds its record from the given XML on
+		 * first use. Only the metadata fields are read from the record now.
+		 */
+		MessageTemplate *create_lazy_template(std::string name,
+			const rapidxml::xml_node<> *record_node, std::string record_xml)
+		{
+			std::unique_ptr<ki::dml::StrField> name_field(
+				create_field_from_xml<ki::dml::STR>(record_node, "_MsgName"));
+			std::unique_ptr<ki::dml::UBytField> order_field(
+				create_field_from_xml<ki::dml::UBYT>(record_node, "_MsgOrder"));
+			std::unique_ptr<ki::dml::StrField> handler_field(
+				create_field_from_xml<ki::dml::STR>(record_node, "_MsgHandler"));
+			std::unique_ptr<ki::dml::UBytField> access_level_field(
+				create_field_from_xml<ki::dml::UBYT>(record_node, "_MsgAccessLvl"));
+
+			// The file was parsed without translating entities
+			if (name_field)
+				name = translate_entities(name_field->get_value());
+
+			// As with records, don't allow message type to be 0
+			uint8_t message_type = 0;
+			if (order_field)
+			{
+				message_type = order_field->get_value();
+				if (message_type == 0)
+				{
+					std::ostringstream oss;
+					oss << "Failed to create message template for " << name;
+					throw value_error(oss.str());
+				}
+			}
+
+			return new MessageTemplate(std::move(name), message_type, 0,
+				std::move(record_xml),
+				handler_field ? translate_entities(handler_field->get_value()) : "",
+				handler_field != nullptr,
+				access_level_field ? access_level_field->get_value() : 0,
+				get_fingerprint(record_node));
+		}
+	}
+
+	MessageManager::MessageManager()
+	{
+		m_strip_template_metadata = false;
+		m_load_templates_lazily = false;
+		m_lookup = new ModuleLookup();
+		m_revision = 0;
+	}
+
 	MessageManager::~MessageManager()
 	{
-		for (auto it = m_modules.begin();
-			it != m_modules.end(); ++it)
+		const auto *lookup = m_lookup.load();
+		for (auto it = lookup->modules.begin();
+			it != lookup->modules.end(); ++it)
+			delete *it;
+		delete lookup;
+
+		for (auto it = m_retired_lookups.begin();
+			it != m_retired_lookups.end(); ++it)
+			delete *it;
+		for (auto it = m_retired_modules.begin();
+			it != m_retired_modules.end(); ++it)
 			delete *it;
-		m_modules.clear();
-		m_service_id_map.clear();
-		m_protocol_type_map.clear();
+	}
+
+	bool MessageManager::is_stripping_template_metadata() const
+	{
+		return m_strip_template_metadata;
+	}
+
+	void MessageManager::set_strip_template_metadata(const bool strip)
+	{
+		m_strip_template_metadata = strip;
+	}
+
+	bool MessageManager::is_loading_templates_lazily() const
+	{
+		return m_load_templates_lazily;
+	}
+
+	void MessageManager::set_load_templates_lazily(const bool lazy)
+	{
+		m_load_templates_lazily = lazy;
 	}
 
 	const MessageModule *MessageManager::load_module(std::string filepath)
 	{
-		// Open the file
-		std::ifstream ifs(filepath, std::ios::ate);
-		if (!ifs.is_open())
+		return add_module(read_module(filepath));
+	}
+
+	MessageModule *MessageManager::read_module(const std::string &filepath) const
+	{
+		const auto start_time = std::chrono::steady_clock::now();
+
+		// Map the file so that it can be parsed in place. The pages that
+		// entity translation writes to are copied, and everything else
+		// is read straight from the page cache.
+		// Lazily loaded templates keep a copy of their record's XML, so in
+		// that case it is mapped read-only and parsed without changes. The
+		// file is never used after this, so it can be edited or replaced.
+		const bool lazy = m_load_templates_lazily;
+		std::unique_ptr<util::MappedFile> file(new util::MappedFile());
+		if (!file->open(filepath, !lazy))
 		{
 			std::ostringstream oss;
 			oss << "Could not open file: " << filepath;
 			throw value_error(oss.str(), value_error::MISSING_FILE);
 		}
 
-		// Load contents into memory
-		size_t size = ifs.tellg();
-		ifs.seekg(0, std::ios::beg);
-		char *data = new char[size + 1] { 0 };
-		ifs.read(data, size);
+		// RapidXML needs the data to be null-terminated, which it only
+		// is if the file doesn't end exactly on a page boundary.
+		const char *file_data = file->get_data();
+		char *data = lazy ? const_cast<char *>(file_data) : file->get_mutable_data();
+		std::vector<char> data_copy;
+		if (!file->has_null_terminator())
+		{
+			data_copy.reserve(file->get_size() + 1);
+			data_copy.assign(file_data, file_data + file->get_size());
+			data_copy.push_back('\0');
+			data = data_copy.data();
+		}
 
-		// Parse the contents
+		// Parse the contents without writing null terminators or creating
+		// data nodes; names and values are read using their sizes.
 		rapidxml::xml_document<> doc;
 		try
 		{
-			doc.parse<0>(data);
+			if (lazy)
+				doc.parse<rapidxml::parse_non_destructive | rapidxml::parse_no_data_nodes>(data);
+			else
+				doc.parse<rapidxml::parse_no_string_terminators | rapidxml::parse_no_data_nodes>(data);
 		}
 		catch (rapidxml::parse_error &e)
 		{
-			delete[] data;
-
 			std::ostringstream oss;
 			oss << "Failed to parse: " << filepath;
 			throw parse_error(oss.str(), parse_error::INVALID_XML_DATA);
 		}
 
-		// It's safe to allocate the module we're working on now
-		auto *message_module = new MessageModule();
+		auto *root = doc.first_node();
+		if (!root)
+		{
+			std::ostringstream oss;
+			oss << "Failed to parse: " << filepath;
+			throw parse_error(oss.str(), parse_error::INVALID_XML_DATA);
+		}
 
-		// Get the root node and iterate through children
+		// Iterate through the root node's children
 		// Each child is a MessageTemplate
-		auto *root = doc.first_node();
+		MessageModuleBuilder builder;
 		for (auto *node = root->first_node();
 			node; node = node->next_sibling())
 		{
-			// Parse the record node inside this node
 			auto *record_node = node->first_node();
 			if (!record_node)
 				continue;
-			auto *record = new ki::dml::Record();
-			record->from_xml(record_node);
 
 			// The message name is initially based on the element name
-			const std::string message_name = node->name();
+			std::string message_name(node->name(), node->name_size());
+			if (lazy)
+			{
+				// Copy the record out of the file, which wasn't modified
+				const char *record_xml = record_node->name() - 1;
+				std::string record_xml_copy(record_xml, get_record_xml_size(record_node));
+				if (message_name == "_ProtocolInfo")
+				{
+					MessageTemplate protocol_info(message_name, 0, 0,
+						std::move(record_xml_copy), "", false, 0, 0);
+					set_protocol_info(builder, protocol_info.get_record());
+				}
+				else
+					builder.add_message_template(create_lazy_template(
+						std::move(message_name), record_node, std::move(record_xml_copy)));
+				continue;
+			}
+
+			// Parse the record node inside this node
+			auto *record = new ki::dml::Record();
+			try
+			{
+				record->from_xml(record_node);
+			}
+			catch (...)
+			{
+				delete record;
+				throw;
+			}
+
 			if (message_name == "_ProtocolInfo")
 			{
-				auto *service_id_field = record->get_field<ki::dml::UBYT>("ServiceID");
-				auto *type_field = record->get_field<ki::dml::STR>("ProtocolType");
-				auto *description_field = record->get_field<ki::dml::STR>("ProtocolDescription");
-
-				// Set the module metadata from this template
-				if (service_id_field)
-					message_module->set_service_id(service_id_field->get_value());
-				if (type_field)
-					message_module->set_protocol_type(type_field->get_value());
-				if (description_field)
-					message_module->set_protocol_description(description_field->get_value());
+				set_protocol_info(builder, *record);
+				delete record;
 			}
 			else
 			{
-				// Only do sorting after we've reached the final message
-				// This only affects modules that aren't ordered with _MsgOrder.
-				const bool auto_sort = node->next_sibling() == nullptr;
-
 				// The template will use the record itself to figure out name and type;
 				// we only give the XML data incase the record doesn't have it defined.
-				auto *message_template = message_module->add_message_template(message_name, record, auto_sort);
-				if (!message_template)
-				{
-					delete[] data;
-					delete message_module;
-					delete record;
-
-					std::ostringstream oss;
-					oss << "Failed to create message template for ";
-					oss << message_name;
-					throw value_error(oss.str());
-				}
+				builder.add_message_template(std::move(message_name), record);
 			}
 		}
 
+		auto *message_module = builder.build();
+		message_module->set_load_time(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start_time));
+		return message_module;
+	}
+
+	const MessageModule *MessageManager::add_module(MessageModule *message_module)
+	{
+		if (!message_module)
+			return nullptr;
+
+		if (m_strip_template_metadata)
+			message_module->set_metadata_stripped(true);
+
+		std::lock_guard<std::mutex> lock(m_lookup_mutex);
+		const auto *lookup = m_lookup.load(std::memory_order_relaxed);
+
 		// Make sure we aren't overwriting another module
-		if (m_service_id_map.count(message_module->get_service_id()) == 1)
+		if (lookup->service_id_map.count(message_module->get_service_id()) == 1)
 		{
-			delete[] data;
-			delete message_module;
-
 			std::ostringstream oss;
 			oss << "Message Module has already been loaded with Service ID ";
 			oss << (uint16_t)message_module->get_service_id();
+			delete message_module;
 			throw value_error(oss.str(), value_error::OVERWRITES_LOOKUP);
 		}
 
-		if (m_protocol_type_map.count(message_module->get_protocol_type()) == 1)
+		if (lookup->protocol_type_map.count(message_module->get_protocol_type()) == 1)
 		{
-			delete[] data;
-			delete message_module;
-
 			std::ostringstream oss;
 			oss << "Message Module has already been loaded with Protocol Type ";
 			oss << message_module->get_protocol_type();
+			delete message_module;
 			throw value_error(oss.str(), value_error::OVERWRITES_LOOKUP);
 		}
 
-		// Add it to our maps
-		m_modules.push_back(message_module);
-		m_service_id_map.insert({ message_module->get_service_id(), message_module });
-		m_protocol_type_map.insert({ message_module->get_protocol_type(), message_module });
-
-		delete[] data;
+		// Add it to a copy of our maps
+		auto *new_lookup = new ModuleLookup(*lookup);
+		new_lookup->modules.push_back(message_module);
+		new_lookup->service_id_map.insert({ message_module->get_service_id(), message_module });
+		new_lookup->protocol_type_map.insert({ message_module->get_protocol_type(), message_module });
+		publish_lookup(new_lookup);
 		return message_module;
 	}
 
+	MessageModuleDiff MessageManager::reload_module(const std::string &filepath)
+	{
+		return replace_module(read_module(filepath));
+	}
+
+	std::future<MessageModuleDiff> MessageManager::reload_module_async(std::string filepath)
+	{
+		return std::async(std::launch::async,
+			&MessageManager::reload_module, this, std::move(filepath));
+	}
+
+	MessageModuleDiff MessageManager::replace_module(MessageModule *message_module)
+	{
+		if (!message_module)
+			return MessageModuleDiff();
+
+		if (m_strip_template_metadata)
+			message_module->set_metadata_stripped(true);
+
+		std::lock_guard<std::mutex> lock(m_lookup_mutex);
+		const auto *lookup = m_lookup.load(std::memory_order_relaxed);
+
+		// Find the module being replaced, if there is one
+		MessageModule *previous = nullptr;
+		auto service_id_it = lookup->service_id_map.find(message_module->get_service_id());
+		if (service_id_it != lookup->service_id_map.end())
+			previous = service_id_it->second;
+		auto protocol_type_it = lookup->protocol_type_map.find(message_module->get_protocol_type());
+		if (protocol_type_it != lookup->protocol_type_map.end())
+		{
+			if (previous && previous != protocol_type_it->second)
+			{
+				std::ostringstream oss;
+				oss << "Message Module with Service ID " << (uint16_t)message_module->get_service_id()
+					<< " and Protocol Type " << message_module->get_protocol_type()
+					<< " would replace two different modules";
+				delete message_module;
+				throw value_error(oss.str(), value_error::OVERWRITES_LOOKUP);
+			}
+			previous = protocol_type_it->second;
+		}
+
+		// Comparing templates may build lazily loaded records, so do it
+		// before anything changes in case one of them fails.
+		MessageModuleDiff diff;
+		try
+		{
+			diff = message_module->diff_from(previous);
+		}
+		catch (...)
+		{
+			delete message_module;
+			throw;
+		}
+
+		auto *new_lookup = new ModuleLookup(*lookup);
+		if (previous)
+		{
+			std::replace(new_lookup->modules.begin(), new_lookup->modules.end(),
+				previous, message_module);
+			new_lookup->service_id_map.erase(previous->get_service_id());
+			new_lookup->protocol_type_map.erase(previous->get_protocol_type());
+			m_retired_modules.push_back(previous);
+		}
+		else
+			new_lookup->modules.push_back(message_module);
+		new_lookup->service_id_map.insert({ message_module->get_service_id(), message_module });
+		new_lookup->protocol_type_map.insert({ message_module->get_protocol_type(), message_module });
+		publish_lookup(new_lookup);
+		return diff;
+	}
+
+	size_t MessageManager::collect_retired()
+	{
+		std::vector<const ModuleLookup *> retired_lookups;
+		MessageModuleList retired_modules;
+		{
+			std::lock_guard<std::mutex> lock(m_lookup_mutex);
+			retired_lookups.swap(m_retired_lookups);
+			retired_modules.swap(m_retired_modules);
+		}
+
+		// Wait for readers that may have found these in an old lookup.
+		// Anything they created from a module is counted by now.
+		m_readers.synchronize();
+
+		for (auto it = retired_lookups.begin();
+			it != retired_lookups.end(); ++it)
+			delete *it;
+
+		// Keep the modules that still have messages using their templates
+		MessageModuleList in_use;
+		for (auto it = retired_modules.begin();
+			it != retired_modules.end(); ++it)
+		{
+			auto *message_module = *it;
+			const bool used = std::any_of(message_module->templates_begin(), message_module->templates_end(),
+				[](const MessageTemplate *message_template)
+			{
+				return message_template->get_message_count() != 0;
+			});
+
+			if (used)
+				in_use.push_back(message_module);
+			else
+				delete message_module;
+		}
+
+		// Modules may have been replaced while this was waiting
+		std::lock_guard<std::mutex> lock(m_lookup_mutex);
+		m_retired_modules.insert(m_retired_modules.end(), in_use.begin(), in_use.end());
+		return m_retired_modules.size();
+	}
+
 	const MessageModule *MessageManager::get_module(uint8_t service_id) const
 	{
-		if (m_service_id_map.count(service_id) == 1)
-			return m_service_id_map.at(service_id);
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		const auto *lookup = m_lookup.load();
+		auto it = lookup->service_id_map.find(service_id);
+		if (it != lookup->service_id_map.end())
+			return it->second;
 		return nullptr;
 	}
 
 	const MessageModule *MessageManager::get_module(const std::string &protocol_type) const
 	{
-		if (m_protocol_type_map.count(protocol_type) == 1)
-			return m_protocol_type_map.at(protocol_type);
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		const auto *lookup = m_lookup.load();
+		auto it = lookup->protocol_type_map.find(protocol_type);
+		if (it != lookup->protocol_type_map.end())
+			return it->second;
 		return nullptr;
 	}
 
+	uint64_t MessageManager::get_fingerprint() const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		const auto *lookup = m_lookup.load();
+		util::Fingerprint fingerprint;
+		for (auto it = lookup->service_id_map.begin();
+			it != lookup->service_id_map.end(); ++it)
+			fingerprint.add(it->second->get_fingerprint());
+		return fingerprint.get_value();
+	}
+
+	MessageModuleList MessageManager::get_modules() const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		return m_lookup.load()->modules;
+	}
+
+	uint64_t MessageManager::get_revision() const
+	{
+		return m_revision.load();
+	}
+
+	void MessageManager::publish_lookup(const ModuleLookup *lookup)
+	{
+		// Readers may still be using the old lookup. This is sequentially
+		// consistent, as collect_retired relies on m_readers.
+		m_retired_lookups.push_back(m_lookup.exchange(lookup));
+
+		// Changed after the lookup, so a revision is never newer than
+		// the lookup that a reader finds after reading it
+		m_revision.fetch_add(1);
+	}
+
 	Message *MessageManager::create_message(uint8_t service_id, uint8_t message_type) const
 	{
+		// The module can't be collected before the message is counted
+		util::ReclamationDomain::ReadGuard guard(m_readers);
 		auto *message_module = get_module(service_id);
 		if (!message_module)
 		{
@@ -171,6 +589,7 @@ namespace dml
 
 	Message *MessageManager::create_message(uint8_t service_id, const std::string& message_name) const
 	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
 		auto *message_module = get_module(service_id);
 		if (!message_module)
 		{
@@ -184,6 +603,7 @@ namespace dml
 
 	Message *MessageManager::create_message(const std::string& protocol_type, uint8_t message_type) const
 	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
 		auto *message_module = get_module(protocol_type);
 		if (!message_module)
 		{
@@ -197,6 +617,7 @@ namespace dml
 
 	Message *MessageManager::create_message(const std::string& protocol_type, const std::string& message_name) const
 	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
 		auto *message_module = get_module(protocol_type);
 		if (!message_module)
 		{
@@ -208,53 +629,234 @@ namespace dml
 		return message_module->create_message(message_name);
 	}
 
-	const Message *MessageManager::message_from_binary(std::istream& istream) const
+	const Message *MessageManager::message_from_binary(std::istream& istream,
+		util::Arena *arena) const
 	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+
 		// Read the message header
 		MessageHeader header;
 		header.read_from(istream);
 
-		// Get the message module that uses the specified service id
-		auto *message_module = get_module(header.get_service_id());
-		if (!message_module)
-		{
-			std::ostringstream oss;
-			oss << "No service exists with id: " << (uint16_t)header.get_service_id();
-			throw value_error(oss.str(), value_error::DML_INVALID_SERVICE);
-		}
-
 		// Get the message template for this message type
-		auto *message_template = message_module->get_message_template(header.get_type());
-		if (!message_template)
-		{
-			std::ostringstream oss;
-			oss << "No message exists with type: " << (uint16_t)header.get_service_id();
-			oss << "(service=" << message_module->get_protocol_type() << ")";
-			throw value_error(oss.str(), value_error::DML_INVALID_MESSAGE_TYPE);
-		}
+		auto *message_template = get_message_template(
+			header.get_service_id(), header.get_type());
 
 		// Make sure that the size specified is enough to read this message
-		if (header.get_message_size() < message_template->get_record().get_size())
+		if (header.get_message_size() < message_template->get_record().get_minimum_size())
 		{
 			std::ostringstream oss;
-			oss << "No message exists with type: " << (uint16_t)header.get_service_id();
-			oss << "(service=" << message_module->get_protocol_type() << ")";
+			oss << "No message exists with type: " << (uint16_t)header.get_type();
+			oss << "(service=" << (uint16_t)message_template->get_service_id() << ")";
 			throw value_error(oss.str(), value_error::DML_INVALID_MESSAGE_TYPE);
 		}
 
 		// Create a new Message from the template
-		auto *message = new Message(message_template);
+		Message *message;
+		if (arena)
+			message = arena->create<Message>(message_template, arena);
+		else
+			message = new Message(message_template);
+
 		try
 		{
 			message->get_record()->read_from(istream);
 		}
 		catch (ki::dml::parse_error &e)
 		{
-			delete message;
+			// Messages inside an arena are destroyed when it's reset
+			if (!arena)
+				delete message;
 			throw parse_error("Failed to read DML message payload.", parse_error::INVALID_MESSAGE_DATA);
 		}
 		return message;
 	}
+
+	std::vector<const Message *> MessageManager::decode_batch(const char *data,
+		const size_t size, util::WorkStealingPool *pool) const
+	{
+		// Find where every message begins before decoding any of them
+		std::vector<size_t> offsets;
+		size_t offset = 0;
+		while (offset < size)
+		{
+			if (size - offset < 4)
+				throw parse_error("Not enough data was available to read DML message header.",
+					parse_error::INVALID_HEADER_DATA);
+
+			// The size in the header is little endian, and includes the header
+			const auto *size_data = reinterpret_cast<const uint8_t *>(data + offset + 2);
+			const size_t length = size_data[0] | (size_data[1] << 8);
+			if (length < 4)
+				throw parse_error("DML message header has an invalid size.",
+					parse_error::INVALID_HEADER_DATA);
+			if (length > size - offset)
+				throw parse_error("Not enough data was available to read DML message payload.",
+					parse_error::INSUFFICIENT_MESSAGE_DATA);
+
+			offsets.push_back(offset);
+			offset += length;
+		}
+
+		std::vector<const Message *> messages(offsets.size(), nullptr);
+		const size_t chunk_count = (offsets.size() + KI_DECODE_BATCH_CHUNK_SIZE - 1) /
+			KI_DECODE_BATCH_CHUNK_SIZE;
+		if (!pool || chunk_count < 2)
+		{
+			try
+			{
+				decode_range(data, offsets, 0, offsets.size(), messages);
+			}
+			catch (...)
+			{
+				for (auto it = messages.begin(); it != messages.end(); ++it)
+					delete *it;
+				throw;
+			}
+			return messages;
+		}
+
+		// Workers and the calling thread claim chunks until there are none
+		// left. The state is shared so that tasks which start after every
+		// chunk has been claimed can still safely find nothing to do.
+		struct BatchState
+		{
+			std::atomic<size_t> next_chunk;
+			std::atomic<size_t> finished_chunks;
+			std::vector<std::exception_ptr> errors;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		auto state = std::make_shared<BatchState>();
+		state->next_chunk = 0;
+		state->finished_chunks = 0;
+		state->errors.resize(chunk_count);
+
+		auto decode_chunks = [this, state, data, chunk_count, &offsets, &messages]()
+		{
+			for (;;)
+			{
+				const size_t chunk = state->next_chunk++;
+				if (chunk >= chunk_count)
+					return;
+
+				const size_t begin = chunk * KI_DECODE_BATCH_CHUNK_SIZE;
+				const size_t end = std::min(begin + KI_DECODE_BATCH_CHUNK_SIZE, offsets.size());
+				try
+				{
+					decode_range(data, offsets, begin, end, messages);
+				}
+				catch (...)
+				{
+					state->errors[chunk] = std::current_exception();
+				}
+
+				if (++state->finished_chunks == chunk_count)
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		const size_t task_count = std::min(pool->get_thread_count(), chunk_count - 1);
+		for (size_t i = 0; i < task_count; ++i)
+			pool->submit(decode_chunks);
+		decode_chunks();
+
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->finished.wait(lock, [&state, chunk_count]()
+			{
+				return state->finished_chunks == chunk_count;
+			});
+		}
+
+		for (auto it = state->errors.begin(); it != state->errors.end(); ++it)
+		{
+			if (!*it)
+				continue;
+
+			for (auto message_it = messages.begin(); message_it != messages.end(); ++message_it)
+				delete *message_it;
+			std::rethrow_exception(*it);
+		}
+		return messages;
+	}
+
+	const MessageTemplate *MessageManager::get_message_template(
+		const uint8_t service_id, const uint8_t message_type) const
+	{
+		// Get the message module that uses the specified service id
+		auto *message_module = get_module(service_id);
+		if (!message_module)
+		{
+			std::ostringstream oss;
+			oss << "No service exists with id: " << (uint16_t)service_id;
+			throw value_error(oss.str(), value_error::DML_INVALID_SERVICE);
+		}
+
+		// Get the message template for this message type
+		auto *message_template = message_module->get_message_template(message_type);
+		if (!message_template)
+		{
+			std::ostringstream oss;
+			oss << "No message exists with type: " << (uint16_t)message_type;
+			oss << "(service=" << message_module->get_protocol_type() << ")";
+			throw value_error(oss.str(), value_error::DML_INVALID_MESSAGE_TYPE);
+		}
+
+		return message_template;
+	}
+
+	void MessageManager::decode_range(const char *data, const std::vector<size_t> &offsets,
+		const size_t begin, const size_t end, std::vector<const Message *> &messages) const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+
+		// One stream is reused for every message in the range
+		util::MemoryStreambuf buffer;
+		std::istream istream(&buffer);
+
+		// Captures tend to contain runs of the same message, so
+		// remember the last template that was looked up
+		const MessageTemplate *message_template = nullptr;
+		uint8_t last_service_id = 0;
+		uint8_t last_type = 0;
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			const auto *header = reinterpret_cast<const uint8_t *>(data + offsets[i]);
+			const uint8_t service_id = header[0];
+			const uint8_t type = header[1];
+			const size_t payload_size = (header[2] | (header[3] << 8)) - 4;
+
+			if (!message_template || service_id != last_service_id || type != last_type)
+			{
+				message_template = get_message_template(service_id, type);
+				last_service_id = service_id;
+				last_type = type;
+			}
+
+			if (payload_size < message_template->get_record().get_minimum_size())
+				throw parse_error("Not enough data was available to read DML message payload.",
+					parse_error::INSUFFICIENT_MESSAGE_DATA);
+
+			buffer.reset(data + offsets[i] + 4, payload_size);
+			istream.clear();
+
+			auto *message = new Message(message_template);
+			messages[i] = message;
+			try
+			{
+				message->get_record()->read_from(istream);
+			}
+			catch (ki::dml::parse_error &e)
+			{
+				throw parse_error("Failed to read DML message payload.", parse_error::INVALID_MESSAGE_DATA);
+			}
+		}
+	}
 }
 }
 }
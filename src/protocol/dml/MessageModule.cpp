@@ -1,5 +1,6 @@
 #include "ki/protocol/dml/MessageModule.h"
 #include "ki/protocol/exception.h"
+#include "ki/util/Fingerprint.h"
 #include <sstream>
 
 namespace ki
@@ -11,9 +12,10 @@ namespace dml
 	MessageModule::MessageModule(uint8_t service_id, std::string protocol_type)
 	{
 		m_service_id = service_id;
-		m_protocol_type = protocol_type;
+		m_protocol_type = std::move(protocol_type);
 		m_protocol_description = "";
 		m_last_message_type = 0;
+		m_load_time = std::chrono::microseconds::zero();
 	}
 
 	MessageModule::~MessageModule()
@@ -35,24 +37,34 @@ namespace dml
 		m_service_id = service_id;
 	}
 
-	std::string MessageModule::get_protocol_type() const
+	const std::string &MessageModule::get_protocol_type() const
 	{
 		return m_protocol_type;
 	}
 
 	void MessageModule::set_protocol_type(std::string protocol_type)
 	{
-		m_protocol_type = protocol_type;
+		m_protocol_type = std::move(protocol_type);
 	}
 
-	std::string MessageModule::get_protocol_desription() const
+	const std::string &MessageModule::get_protocol_desription() const
 	{
 		return m_protocol_description;
 	}
 
 	void MessageModule::set_protocol_description(std::string protocol_description)
 	{
-		m_protocol_description = protocol_description;
+		m_protocol_description = std::move(protocol_description);
+	}
+
+	std::chrono::microseconds MessageModule::get_load_time() const
+	{
+		return m_load_time;
+	}
+
+	void MessageModule::set_load_time(const std::chrono::microseconds load_time)
+	{
+		m_load_time = load_time;
 	}
 
 	const MessageTemplate *MessageModule::add_message_template(std::string name,
@@ -88,9 +100,27 @@ namespace dml
 		}
 
 		// Create the message template and add it to our lookups
-		auto *message_template = new MessageTemplate(name, message_type, m_service_id, record);
+		return add_message_template(
+			new MessageTemplate(std::move(name), message_type, m_service_id, record), auto_sort);
+	}
+
+	const MessageTemplate *MessageModule::add_message_template(
+		MessageTemplate *message_template, bool auto_sort)
+	{
+		if (!message_template)
+			return nullptr;
+
+		// Do we already have a message template with this name or type?
+		const auto &name = message_template->get_name();
+		if (m_message_name_map.count(name) == 1)
+			return m_message_name_map.at(name);
+		const auto message_type = message_template->get_type();
+		if (message_type != 0 && m_message_type_map.count(message_type) == 1)
+			return nullptr;
+
+		message_template->set_service_id(m_service_id);
 		m_templates.push_back(message_template);
-		m_message_name_map.insert({ name, message_template });
+		m_message_name_map.insert({ message_template->get_name(), message_template });
 
 		// Is this module ordered?
 		if (message_type != 0)
@@ -108,13 +138,23 @@ namespace dml
 		return nullptr;
 	}
 
-	const MessageTemplate *MessageModule::get_message_template(std::string name) const
+	const MessageTemplate *MessageModule::get_message_template(const std::string &name) const
 	{
 		if (m_message_name_map.count(name) == 1)
 			return m_message_name_map.at(name);
 		return nullptr;
 	}
 
+	std::vector<MessageTemplate *>::const_iterator MessageModule::templates_begin() const
+	{
+		return m_templates.begin();
+	}
+
+	std::vector<MessageTemplate *>::const_iterator MessageModule::templates_end() const
+	{
+		return m_templates.end();
+	}
+
 	void MessageModule::sort_lookup()
 	{
 		uint8_t message_type = 1;
@@ -139,6 +179,98 @@ namespace dml
 		}
 	}
 
+	void MessageModule::set_metadata_stripped(const bool stripped)
+	{
+		for (auto it = m_templates.begin();
+			it != m_templates.end(); ++it)
+			(*it)->set_metadata_stripped(stripped);
+	}
+
+	void MessageModule::write_xml(std::ostream &ostream) const
+	{
+		std::string buffer;
+		buffer.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Messages>\n");
+
+		ki::dml::Record protocol_info;
+		protocol_info.add_field<ki::dml::UBYT>("ServiceID")->set_value(m_service_id);
+		protocol_info.add_field<ki::dml::STR>("ProtocolType")->set_value(m_protocol_type);
+		protocol_info.add_field<ki::dml::STR>("ProtocolDescription")->set_value(m_protocol_description);
+		buffer.append("\t<_ProtocolInfo>");
+		protocol_info.write_xml(buffer);
+		buffer.append("</_ProtocolInfo>\n");
+
+		// Write each template as soon as it's formatted, so that the
+		// buffer never holds more than one of them.
+		for (auto it = m_templates.begin(); it != m_templates.end(); ++it)
+		{
+			const auto &name = (*it)->get_name();
+			buffer.append("\t<");
+			buffer.append(name);
+			buffer.push_back('>');
+			(*it)->get_record().write_xml(buffer);
+			buffer.append("</");
+			buffer.append(name);
+			buffer.append(">\n");
+
+			ostream.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+
+		buffer.append("</Messages>\n");
+		ostream.write(buffer.data(), buffer.size());
+	}
+
+	MessageModuleDiff MessageModule::diff_from(const MessageModule *previous) const
+	{
+		// Both name maps are sorted, so walk through them together
+		MessageModuleDiff diff;
+		static const std::map<std::string, MessageTemplate *> no_templates;
+		const auto &previous_map = previous ? previous->m_message_name_map : no_templates;
+		auto it = m_message_name_map.begin();
+		auto previous_it = previous_map.begin();
+		while (it != m_message_name_map.end() || previous_it != previous_map.end())
+		{
+			if (previous_it == previous_map.end() ||
+				(it != m_message_name_map.end() && it->first < previous_it->first))
+			{
+				diff.added.push_back(it->first);
+				++it;
+			}
+			else if (it == m_message_name_map.end() || previous_it->first < it->first)
+			{
+				diff.removed.push_back(previous_it->first);
+				++previous_it;
+			}
+			else
+			{
+				const auto *message_template = it->second;
+				const auto *previous_template = previous_it->second;
+				if (message_template->get_type() != previous_template->get_type() ||
+					!message_template->has_same_record(*previous_template))
+					diff.changed.push_back(it->first);
+				++it;
+				++previous_it;
+			}
+		}
+		return diff;
+	}
+
+	uint64_t MessageModule::get_fingerprint() const
+	{
+		util::Fingerprint fingerprint;
+		fingerprint.add(m_service_id);
+		fingerprint.add(m_protocol_type);
+		for (auto it = m_message_type_map.begin();
+			it != m_message_type_map.end(); ++it)
+		{
+			const auto *message_template = it->second;
+			fingerprint.add(it->first);
+			fingerprint.add(message_template->get_name());
+			fingerprint.add(message_template->get_fingerprint());
+		}
+		return fingerprint.get_value();
+	}
+
 	Message *MessageModule::create_message(uint8_t message_type) const
 	{
 		auto *message_template = get_message_template(message_type);
@@ -153,7 +285,7 @@ namespace dml
 		return message_template->create_message();
 	}
 
-	Message *MessageModule::create_message(std::string message_name) const
+	Message *MessageModule::create_message(const std::string &message_name) const
 	{
 		auto *message_template = get_message_template(message_name);
 		if (!message_template)
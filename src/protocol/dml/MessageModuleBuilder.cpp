@@ -0,0 +1,135 @@
+#include "ki/protocol/dml/MessageModuleBuilder.h"
+#include "ki/protocol/exception.h"
+#include <sstream>
+
+namespace ki
+{
+namespace protocol
+{
+namespace dml
+{
+	MessageModuleBuilder::MessageModuleBuilder(const uint8_t service_id, std::string protocol_type)
+	{
+		m_service_id = service_id;
+		m_protocol_type = std::move(protocol_type);
+		m_protocol_description = "";
+	}
+
+	MessageModuleBuilder::~MessageModuleBuilder()
+	{
+		clear();
+	}
+
+	void MessageModuleBuilder::set_service_id(const uint8_t service_id)
+	{
+		m_service_id = service_id;
+	}
+
+	void MessageModuleBuilder::set_protocol_type(std::string protocol_type)
+	{
+		m_protocol_type = std::move(protocol_type);
+	}
+
+	void MessageModuleBuilder::set_protocol_description(std::string protocol_description)
+	{
+		m_protocol_description = std::move(protocol_description);
+	}
+
+	void MessageModuleBuilder::add_message_template(std::string name, ki::dml::Record *record)
+	{
+		if (record)
+			m_templates.push_back({ std::move(name), record, nullptr });
+	}
+
+	void MessageModuleBuilder::add_message_template(MessageTemplate *message_template)
+	{
+		if (message_template)
+			m_templates.push_back({ message_template->get_name(), nullptr, message_template });
+	}
+
+	size_t MessageModuleBuilder::get_template_count() const
+	{
+		return m_templates.size();
+	}
+
+	MessageModule *MessageModuleBuilder::build()
+	{
+		auto *message_module = new MessageModule(m_service_id, std::move(m_protocol_type));
+		message_module->set_protocol_description(std::move(m_protocol_description));
+		m_protocol_type.clear();
+		m_protocol_description.clear();
+
+		// Add every template without sorting, and then sort once
+		// at the end if any of them needed it.
+		bool needs_sort = false;
+		for (size_t i = 0; i < m_templates.size(); ++i)
+		{
+			auto &entry = m_templates[i];
+			const auto template_count = message_module->templates_end() - message_module->templates_begin();
+			const MessageTemplate *message_template;
+			bool ordered;
+			if (entry.record)
+			{
+				ordered = entry.record->has_field<ki::dml::UBYT>("_MsgOrder");
+				message_template = message_module->add_message_template(entry.name, entry.record, false);
+			}
+			else
+			{
+				ordered = entry.message_template->get_type() != 0;
+				message_template = message_module->add_message_template(entry.message_template, false);
+			}
+
+			if (!message_template)
+			{
+				std::ostringstream oss;
+				oss << "Failed to create message template for " << entry.name;
+
+				// Entries that haven't been added yet are still ours
+				for (size_t j = i; j < m_templates.size(); ++j)
+				{
+					delete m_templates[j].record;
+					delete m_templates[j].message_template;
+				}
+				m_templates.clear();
+				delete message_module;
+				throw value_error(oss.str());
+			}
+
+			// A template with the same name was already added
+			if (message_module->templates_end() - message_module->templates_begin() == template_count)
+			{
+				delete entry.record;
+				delete entry.message_template;
+			}
+			else if (!ordered)
+				needs_sort = true;
+		}
+		m_templates.clear();
+
+		if (needs_sort)
+		{
+			try
+			{
+				message_module->sort_lookup();
+			}
+			catch (value_error &)
+			{
+				delete message_module;
+				throw;
+			}
+		}
+		return message_module;
+	}
+
+	void MessageModuleBuilder::clear()
+	{
+		for (auto it = m_templates.begin(); it != m_templates.end(); ++it)
+		{
+			delete it->record;
+			delete it->message_template;
+		}
+		m_templates.clear();
+	}
+}
+}
+}
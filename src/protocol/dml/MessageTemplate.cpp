@@ -1,4 +1,10 @@
 #include "ki/protocol/dml/MessageTemplate.h"
+#include "ki/protocol/exception.h"
+#include "ki/util/Fingerprint.h"
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <rapidxml.hpp>
 
 namespace ki
 {
@@ -6,28 +12,88 @@ namespace protocol
 {
 namespace dml
 {
+	namespace
+	{
+		bool records_equal(const ki::dml::Record &a, const ki::dml::Record &b)
+		{
+			if (a.get_field_count() != b.get_field_count())
+				return false;
+
+			for (auto a_it = a.fields_begin(), b_it = b.fields_begin();
+				a_it != a.fields_end(); ++a_it, ++b_it)
+			{
+				const auto *a_field = *a_it;
+				const auto *b_field = *b_it;
+				if (a_field->get_name() != b_field->get_name() ||
+					std::strcmp(a_field->get_type_name(), b_field->get_type_name()) != 0 ||
+					a_field->is_transferable() != b_field->is_transferable() ||
+					a_field->get_value_string() != b_field->get_value_string())
+					return false;
+			}
+			return true;
+		}
+	}
+
 	MessageTemplate::MessageTemplate(std::string name, uint8_t type,
 		uint8_t service_id, ki::dml::Record* record)
 	{
-		m_name = name;
+		m_name = std::move(name);
 		m_type = type;
 		m_service_id = service_id;
 		m_record = record;
+		m_metadata_stripped = false;
+		m_message_record = nullptr;
+		m_record_loaded = true;
+		m_message_count = 0;
+		update_metadata();
+
+		// Resolve the name and type from the record once, as a module does
+		if (m_record)
+		{
+			const auto *name_field = m_record->get_field<ki::dml::STR>("_MsgName");
+			if (name_field)
+				m_name = name_field->get_value();
+
+			const auto *order_field = m_record->get_field<ki::dml::UBYT>("_MsgOrder");
+			if (order_field && order_field->get_value() != 0)
+				m_type = order_field->get_value();
+		}
+	}
+
+	MessageTemplate::MessageTemplate(std::string name, uint8_t type, uint8_t service_id,
+		std::string record_xml,
+		std::string handler, const bool has_handler, const uint8_t access_level,
+		const uint64_t fingerprint)
+	{
+		m_name = std::move(name);
+		m_type = type;
+		m_service_id = service_id;
+		m_record = nullptr;
+		m_handler = std::move(handler);
+		m_has_handler = has_handler;
+		m_access_level = access_level;
+		m_fingerprint = fingerprint;
+		m_metadata_stripped = false;
+		m_message_record = nullptr;
+		m_record_xml = std::move(record_xml);
+		m_record_loaded = false;
+		m_message_count = 0;
 	}
 
 	MessageTemplate::~MessageTemplate()
 	{
+		delete m_message_record;
 		delete m_record;
 	}
 
-	std::string MessageTemplate::get_name() const
+	const std::string &MessageTemplate::get_name() const
 	{
 		return m_name;
 	}
 
 	void MessageTemplate::set_name(std::string name)
 	{
-		m_name = name;
+		m_name = std::move(name);
 	}
 
 	uint8_t MessageTemplate::get_type() const
@@ -50,46 +116,198 @@ namespace dml
 		m_service_id = service_id;
 	}
 
-	std::string MessageTemplate::get_handler() const
+	const std::string &MessageTemplate::get_handler() const
 	{
-		const auto field = m_record->get_field<ki::dml::STR>("_MsgHandler");
-		if (field)
-			return field->get_value();
-		return m_name;
+		// Without a _MsgHandler field, the handler is the message name
+		if (!m_has_handler)
+			return m_name;
+		return m_handler;
 	}
 
 	void MessageTemplate::set_handler(std::string handler)
 	{
-		m_record->add_field<ki::dml::STR>("_MsgHandler")->set_value(handler);
+		load_record();
+		m_record->add_field<ki::dml::STR>("_MsgHandler")->set_value(std::move(handler));
+		update_metadata();
+		update_message_record();
 	}
 
 	uint8_t MessageTemplate::get_access_level() const
 	{
-		const auto field = m_record->get_field<ki::dml::UBYT>("_MsgAccessLvl");
-		if (field)
-			return field->get_value();
-		return 0;
+		return m_access_level;
 	}
 
 	void MessageTemplate::set_access_level(uint8_t access_level)
 	{
+		load_record();
 		m_record->add_field<ki::dml::UBYT>("_MsgAccessLvl")->set_value(access_level);
+		update_metadata();
+		update_message_record();
 	}
 
 	const ki::dml::Record& MessageTemplate::get_record() const
 	{
+		load_record();
 		return *m_record;
 	}
 
 	void MessageTemplate::set_record(ki::dml::Record* record)
 	{
+		// The XML is no longer needed, even if it was never loaded
 		m_record = record;
+		m_record_xml.clear();
+		m_record_xml.shrink_to_fit();
+		m_record_loaded = true;
+		update_metadata();
+		update_message_record();
+	}
+
+	bool MessageTemplate::is_record_loaded() const
+	{
+		return m_record_loaded.load(std::memory_order_acquire);
+	}
+
+	uint64_t MessageTemplate::get_fingerprint() const
+	{
+		return m_fingerprint;
+	}
+
+	const ki::dml::Record& MessageTemplate::get_message_record() const
+	{
+		load_record();
+		if (m_message_record)
+			return *m_message_record;
+		return *m_record;
+	}
+
+	bool MessageTemplate::is_metadata_stripped() const
+	{
+		return m_metadata_stripped;
+	}
+
+	void MessageTemplate::set_metadata_stripped(const bool stripped)
+	{
+		if (stripped == m_metadata_stripped)
+			return;
+		m_metadata_stripped = stripped;
+
+		// A record that hasn't been loaded yet is stripped once it is
+		if (!is_record_loaded())
+			return;
+
+		if (stripped)
+			update_message_record();
+		else
+		{
+			delete m_message_record;
+			m_message_record = nullptr;
+		}
+	}
+
+	bool MessageTemplate::has_same_record(const MessageTemplate &other) const
+	{
+		if (!m_record_xml.empty() && m_record_xml == other.m_record_xml)
+			return true;
+		return records_equal(get_record(), other.get_record());
+	}
+
+	size_t MessageTemplate::get_message_count() const
+	{
+		return m_message_count.load(std::memory_order_acquire);
 	}
 
 	Message *MessageTemplate::create_message() const
 	{
 		return new Message(this);
 	}
+
+	void MessageTemplate::load_record() const
+	{
+		if (m_record_loaded.load(std::memory_order_acquire))
+			return;
+
+		// If building the record throws, the next caller tries again
+		std::call_once(m_record_once, [this]()
+		{
+			// RapidXML needs the data to be null-terminated, and
+			// translates entities in place, so parse a copy of it.
+			std::vector<char> data(m_record_xml.begin(), m_record_xml.end());
+			data.push_back('\0');
+
+			auto *record = new ki::dml::Record();
+			try
+			{
+				rapidxml::xml_document<> doc;
+				doc.parse<rapidxml::parse_no_string_terminators | rapidxml::parse_no_data_nodes>(data.data());
+				auto *record_node = doc.first_node();
+				if (!record_node)
+					throw rapidxml::parse_error("expected element", data.data());
+				record->from_xml(record_node);
+			}
+			catch (rapidxml::parse_error &)
+			{
+				delete record;
+				std::ostringstream oss;
+				oss << "Failed to parse the record of message template: " << m_name;
+				throw parse_error(oss.str(), parse_error::INVALID_XML_DATA);
+			}
+			catch (...)
+			{
+				delete record;
+				throw;
+			}
+
+			m_record = record;
+			update_message_record();
+			m_record_loaded.store(true, std::memory_order_release);
+		});
+	}
+
+	void MessageTemplate::update_metadata()
+	{
+		m_handler.clear();
+		m_has_handler = false;
+		m_access_level = 0;
+		m_fingerprint = util::Fingerprint().get_value();
+		if (!m_record)
+			return;
+		m_fingerprint = m_record->get_fingerprint();
+
+		const auto *handler_field = m_record->get_field<ki::dml::STR>("_MsgHandler");
+		if (handler_field)
+		{
+			m_handler = handler_field->get_value();
+			m_has_handler = true;
+		}
+
+		const auto *access_level_field = m_record->get_field<ki::dml::UBYT>("_MsgAccessLvl");
+		if (access_level_field)
+			m_access_level = access_level_field->get_value();
+	}
+
+	void MessageTemplate::update_message_record() const
+	{
+		if (!m_metadata_stripped)
+			return;
+
+		// Rebuild the copy from the current template record
+		delete m_message_record;
+		m_message_record = new ki::dml::Record(*m_record);
+
+		// Only remove fields that never go over the wire, so that
+		// the message layout is unaffected.
+		std::vector<std::string> metadata_names;
+		for (auto it = m_message_record->fields_begin();
+			it != m_message_record->fields_end(); ++it)
+		{
+			const auto *field = *it;
+			if (!field->is_transferable() && field->get_name().compare(0, 4, "_Msg") == 0)
+				metadata_names.push_back(field->get_name());
+		}
+
+		for (auto it = metadata_names.begin(); it != metadata_names.end(); ++it)
+			m_message_record->remove_field(*it);
+	}
+}
 }
 }
-}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "ki/protocol/net/Capture.h"
+#include "ki/protocol/exception.h"
+#include "ki/util/ValueBytes.h"
+#include <chrono>
+#include <sstream>
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	CaptureWriter::CaptureWriter(const std::string &filepath)
+	{
+		m_frame_count = 0;
+		m_stream.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_stream.is_open())
+		{
+			std::ostringstream oss;
+			oss << "Could not open capture file for writing: " << filepath;
+			throw value_error(oss.str(), value_error::MISSING_FILE);
+		}
+
+		char header[KI_CAPTURE_FILE_HEADER_SIZE] = { 0 };
+		write_le<uint32_t>(&header[0], KI_CAPTURE_MAGIC);
+		write_le<uint16_t>(&header[4], KI_CAPTURE_VERSION);
+		m_stream.write(header, sizeof(header));
+	}
+
+	void CaptureWriter::write_frame(const uint16_t session_id,
+		const CaptureDirection direction, const char *data, const size_t size)
+	{
+		const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+
+		char header[KI_CAPTURE_FRAME_HEADER_SIZE] = { 0 };
+		write_le<uint64_t>(&header[0], timestamp);
+		write_le<uint16_t>(&header[8], session_id);
+		header[10] = static_cast<char>(direction);
+		write_le<uint32_t>(&header[12], size);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stream.write(header, sizeof(header));
+		m_stream.write(data, size);
+		m_frame_count++;
+	}
+
+	void CaptureWriter::flush()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stream.flush();
+	}
+
+	size_t CaptureWriter::get_frame_count() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_frame_count;
+	}
+
+	CaptureReader::CaptureReader(const std::string &filepath)
+	{
+		m_position = KI_CAPTURE_FILE_HEADER_SIZE;
+		m_truncated = false;
+		if (!m_file.open(filepath))
+		{
+			std::ostringstream oss;
+			oss << "Could not open capture file: " << filepath;
+			throw value_error(oss.str(), value_error::MISSING_FILE);
+		}
+
+		const char *data = m_file.get_data();
+		if (m_file.get_size() < KI_CAPTURE_FILE_HEADER_SIZE ||
+			read_le<uint32_t>(&data[0]) != KI_CAPTURE_MAGIC)
+			throw parse_error("File is not a capture file.", parse_error::INVALID_HEADER_DATA);
+		if (read_le<uint16_t>(&data[4]) != KI_CAPTURE_VERSION)
+			throw parse_error("Capture file version is not supported.", parse_error::INVALID_HEADER_DATA);
+	}
+
+	bool CaptureReader::next(CaptureFrame &frame)
+	{
+		if (!read_frame(m_position, frame))
+		{
+			m_truncated = m_position != m_file.get_size();
+			return false;
+		}
+		return true;
+	}
+
+	void CaptureReader::rewind()
+	{
+		m_position = KI_CAPTURE_FILE_HEADER_SIZE;
+		m_truncated = false;
+	}
+
+	bool CaptureReader::is_truncated() const
+	{
+		return m_truncated;
+	}
+
+	size_t CaptureReader::append_dml_messages(std::vector<char> &buffer,
+		const CaptureDirection direction) const
+	{
+		// Skip the start signal and length, and then the packet header
+		const size_t payload_offset = 4 + 4;
+
+		size_t message_count = 0;
+		size_t position = KI_CAPTURE_FILE_HEADER_SIZE;
+		CaptureFrame frame;
+		while (read_frame(position, frame))
+		{
+			if (frame.direction != direction || frame.size <= payload_offset)
+				continue;
+
+			// Control packets have a non-zero first byte
+			if (frame.data[4] != 0)
+				continue;
+
+			buffer.insert(buffer.end(), frame.data + payload_offset, frame.data + frame.size);
+			message_count++;
+		}
+		return message_count;
+	}
+
+	bool CaptureReader::read_frame(size_t &position, CaptureFrame &frame) const
+	{
+		const char *data = m_file.get_data();
+		const size_t size = m_file.get_size();
+		if (size - position < KI_CAPTURE_FRAME_HEADER_SIZE)
+			return false;
+
+		const char *header = &data[position];
+		const size_t frame_size = read_le<uint32_t>(&header[12]);
+		if (size - position - KI_CAPTURE_FRAME_HEADER_SIZE < frame_size)
+			return false;
+
+		frame.timestamp = read_le<uint64_t>(&header[0]);
+		frame.session_id = read_le<uint16_t>(&header[8]);
+		frame.direction = static_cast<CaptureDirection>(header[10]);
+		frame.data = header + KI_CAPTURE_FRAME_HEADER_SIZE;
+		frame.size = frame_size;
+		position += KI_CAPTURE_FRAME_HEADER_SIZE + frame_size;
+		return true;
+	}
+}
+}
+}
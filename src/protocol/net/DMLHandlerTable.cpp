@@ -0,0 +1,145 @@
+#include "ki/protocol/net/DMLHandlerTable.h"
+#include "ki/protocol/exception.h"
+#include <set>
+#include <sstream>
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	DMLHandlerTable::DMLHandlerTable()
+	{
+		// Nothing is bound until bind is called
+		auto *binding = new Binding();
+		binding->manager = nullptr;
+		binding->revision = 0;
+		m_binding = binding;
+	}
+
+	DMLHandlerTable::~DMLHandlerTable()
+	{
+		delete m_binding.load();
+		for (auto it = m_retired_bindings.begin();
+			it != m_retired_bindings.end(); ++it)
+			delete *it;
+	}
+
+	void DMLHandlerTable::register_handler(std::string name, Handler handler)
+	{
+		std::lock_guard<std::mutex> lock(m_handlers_mutex);
+		m_handlers[name] = std::move(handler);
+	}
+
+	void DMLHandlerTable::bind(const dml::MessageManager& manager, const bool require_all)
+	{
+		std::lock_guard<std::mutex> lock(m_handlers_mutex);
+
+		// The binding has its own copy of the handlers, so that they
+		// can be registered again while it's in use
+		std::unique_ptr<Binding> binding(new Binding());
+		binding->handlers = m_handlers;
+		auto &handlers = binding->handlers;
+		auto &dispatch = binding->dispatch;
+		std::set<std::string> used_handlers;
+
+		// Read before the modules, so that a reload in between leaves
+		// the binding looking out of date rather than current
+		binding->manager = &manager;
+		binding->revision = manager.get_revision();
+
+		const auto modules = manager.get_modules();
+		for (auto module_it = modules.begin();
+			module_it != modules.end(); ++module_it)
+		{
+			const auto *message_module = *module_it;
+			for (auto it = message_module->templates_begin();
+				it != message_module->templates_end(); ++it)
+			{
+				const auto *message_template = *it;
+				const auto handler_name = message_template->get_handler();
+
+				const auto handler_it = handlers.find(handler_name);
+				if (handler_it == handlers.end())
+				{
+					if (!require_all)
+						continue;
+
+					std::ostringstream oss;
+					oss << "No handler has been registered for " << handler_name;
+					oss << " (service=" << message_module->get_protocol_type() << ")";
+					throw value_error(oss.str(), value_error::DML_UNREGISTERED_HANDLER);
+				}
+
+				auto &page = dispatch[message_template->get_service_id()];
+				if (!page)
+				{
+					page.reset(new DispatchPage());
+					page->fill(nullptr);
+				}
+				(*page)[message_template->get_type()] = &handler_it->second;
+				used_handlers.insert(handler_name);
+			}
+		}
+
+		// Catch handlers that don't match anything, since they're
+		// most likely typos or belong to a module that wasn't loaded.
+		for (auto it = handlers.begin(); it != handlers.end(); ++it)
+		{
+			if (used_handlers.count(it->first) == 0)
+			{
+				std::ostringstream oss;
+				oss << "Handler is not used by any loaded message: " << it->first;
+				throw value_error(oss.str(), value_error::DML_UNKNOWN_HANDLER);
+			}
+		}
+
+		// Dispatches may still be using the old binding. This is
+		// sequentially consistent, as collect_retired relies on m_readers.
+		m_retired_bindings.push_back(m_binding.exchange(binding.release()));
+	}
+
+	void DMLHandlerTable::collect_retired()
+	{
+		std::vector<const Binding *> retired_bindings;
+		{
+			std::lock_guard<std::mutex> lock(m_handlers_mutex);
+			retired_bindings.swap(m_retired_bindings);
+		}
+
+		m_readers.synchronize();
+		for (auto it = retired_bindings.begin();
+			it != retired_bindings.end(); ++it)
+			delete *it;
+	}
+
+	bool DMLHandlerTable::is_current(const dml::MessageManager &manager) const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		const auto *binding = m_binding.load();
+		return binding->manager == &manager &&
+			binding->revision == manager.get_revision();
+	}
+
+	const DMLHandlerTable::Handler *DMLHandlerTable::get_handler(
+		const uint8_t service_id, const uint8_t message_type) const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		return m_binding.load()->get_handler(service_id, message_type);
+	}
+
+	bool DMLHandlerTable::dispatch(DMLSession &session, const dml::Message &message) const
+	{
+		util::ReclamationDomain::ReadGuard guard(m_readers);
+		const auto *handler = m_binding.load()->get_handler(
+			message.get_service_id(), message.get_type());
+		if (!handler)
+			return false;
+
+		(*handler)(session, message);
+		return true;
+	}
+}
+}
+}
@@ -7,24 +7,142 @@ namespace protocol
 {
 namespace net
 {
+	static_assert(static_cast<size_t>(InvalidDMLMessageErrorCode::INSUFFICIENT_ACCESS) <
+		KI_SESSION_DECODE_ERROR_CODES, "Every error code must have a statistics counter.");
+
 	DMLSession::DMLSession(const uint16_t id, const dml::MessageManager& manager)
-		: Session(id), m_manager(manager) {}
+		: Session(id), m_manager(manager)
+	{
+		m_handler_table = nullptr;
+		m_message_statistics = nullptr;
+		m_dispatch_pool = nullptr;
+		m_dispatch_scheduled = false;
+	}
+
+	DMLSession::~DMLSession()
+	{
+		// Derived classes should already have done this, but don't let a
+		// worker touch this session's own members after they are destroyed
+		stop_dispatch();
+	}
 
 	const dml::MessageManager& DMLSession::get_manager() const
 	{
 		return m_manager;
 	}
 
-	void DMLSession::send_message(const dml::Message& message)
+	void DMLSession::send_message(const dml::Message& message, const bool urgent)
+	{
+		// Messages dropped by the send queue's limits weren't sent
+		if (!send_packet(false, 0, message, urgent))
+			return;
+
+		auto *statistics = m_message_statistics.load(std::memory_order_relaxed);
+		if (statistics)
+			statistics->add_encoded(message.get_service_id(), message.get_type(), message.get_size());
+	}
+
+	const DMLHandlerTable *DMLSession::get_handler_table() const
+	{
+		return m_handler_table;
+	}
+
+	void DMLSession::set_handler_table(const DMLHandlerTable *handler_table)
+	{
+		m_handler_table = handler_table;
+	}
+
+	DMLStatistics *DMLSession::get_message_statistics() const
+	{
+		return m_message_statistics.load(std::memory_order_relaxed);
+	}
+
+	void DMLSession::set_message_statistics(DMLStatistics *statistics)
+	{
+		m_message_statistics.store(statistics, std::memory_order_relaxed);
+	}
+
+	util::WorkStealingPool *DMLSession::get_dispatch_pool() const
 	{
-		send_packet(false, 0, message);
+		return m_dispatch_pool;
+	}
+
+	void DMLSession::set_dispatch_pool(util::WorkStealingPool *pool)
+	{
+		// Finish handling anything that was queued on the previous pool
+		wait_for_dispatch();
+		m_dispatch_pool = pool;
+	}
+
+	void DMLSession::stop_dispatch()
+	{
+		set_dispatch_pool(nullptr);
+	}
+
+	void DMLSession::wait_for_dispatch()
+	{
+		std::unique_lock<std::mutex> lock(m_dispatch_mutex);
+		m_dispatch_condition.wait(lock, [this]()
+		{
+			return !m_dispatch_scheduled;
+		});
+	}
+
+	void DMLSession::post_message(const dml::Message& message)
+	{
+		std::ostringstream oss;
+		PacketHeader header(false, 0);
+		header.write_to(oss);
+		message.write_to(oss);
+
+		PostedPacket packet;
+		packet.data = oss.str();
+		packet.service_id = message.get_service_id();
+		packet.message_type = message.get_type();
+		packet.message_size = message.get_size();
+
+		bool was_empty;
+		{
+			std::lock_guard<std::mutex> lock(m_posted_mutex);
+			was_empty = m_posted_packets.empty();
+			m_posted_packets.push_back(std::move(packet));
+		}
+
+		if (was_empty)
+			on_messages_posted();
+	}
+
+	void DMLSession::flush_posted_messages()
+	{
+		std::vector<PostedPacket> packets;
+		{
+			std::lock_guard<std::mutex> lock(m_posted_mutex);
+			packets.swap(m_posted_packets);
+		}
+
+		// Only count the packets that the send queue's limits accepted
+		auto *statistics = m_message_statistics.load(std::memory_order_relaxed);
+		for (auto it = packets.begin(); it != packets.end(); ++it)
+		{
+			if (send_data(it->data.data(), it->data.size()) && statistics)
+				statistics->add_encoded(it->service_id, it->message_type, it->message_size);
+		}
 	}
 
-	void DMLSession::on_application_message(const PacketHeader& header)
+	void DMLSession::on_application_message(const PacketHeader&)
 	{
 		// Attempt to create a Message instance from the data in the stream
 		auto error_code = InvalidDMLMessageErrorCode::NONE;
 		const dml::Message *message = nullptr;
+		auto *statistics = m_message_statistics.load(std::memory_order_relaxed);
+		std::chrono::steady_clock::time_point start_time;
+		std::streampos start_position;
+		if (statistics)
+		{
+			start_time = std::chrono::steady_clock::now();
+			start_position = m_data_stream.tellg();
+		}
+
 		try
 		{
 			message = m_manager.message_from_binary(m_data_stream);
@@ -61,16 +179,103 @@ namespace net
 
 		if (!message)
 		{
+			m_counters.add_decode_error(error_code);
 			on_invalid_message(error_code);
 			return;
 		}
 
+		if (statistics)
+		{
+			const auto decode_time = std::chrono::steady_clock::now() - start_time;
+			const auto end_position = m_data_stream.tellg();
+			const size_t size = start_position != std::streampos(-1) && end_position != std::streampos(-1)
+				? static_cast<size_t>(end_position - start_position)
+				: message->get_size();
+			statistics->add_decoded(message->get_service_id(), message->get_type(), size,
+				std::chrono::duration_cast<std::chrono::nanoseconds>(decode_time));
+		}
+
 		// Are we sufficiently authenticated to handle this message?
-		if (get_access_level() >= message->get_access_level())
-			on_message(message);
-		else
+		if (get_access_level() < message->get_access_level())
+		{
+			m_counters.add_decode_error(InvalidDMLMessageErrorCode::INSUFFICIENT_ACCESS);
 			on_invalid_message(InvalidDMLMessageErrorCode::INSUFFICIENT_ACCESS);
-		delete message;
+			delete message;
+			return;
+		}
+
+		dispatch_message(message);
+	}
+
+	void DMLSession::dispatch_message(const dml::Message *message)
+	{
+		if (!m_dispatch_pool)
+		{
+			handle_message(message);
+			delete message;
+			return;
+		}
+
+		// Only one task per session may be scheduled at a time, which
+		// keeps messages from this session ordered.
+		{
+			std::lock_guard<std::mutex> lock(m_dispatch_mutex);
+			m_dispatch_queue.push_back(message);
+			if (m_dispatch_scheduled)
+				return;
+			m_dispatch_scheduled = true;
+		}
+		m_dispatch_pool->submit([this]()
+		{
+			drain_dispatch_queue();
+		});
+	}
+
+	void DMLSession::drain_dispatch_queue()
+	{
+		while (true)
+		{
+			const dml::Message *message;
+			{
+				std::lock_guard<std::mutex> lock(m_dispatch_mutex);
+				if (m_dispatch_queue.empty())
+				{
+					m_dispatch_scheduled = false;
+					m_dispatch_condition.notify_all();
+					return;
+				}
+
+				message = m_dispatch_queue.front();
+				m_dispatch_queue.pop_front();
+			}
+
+			handle_message(message);
+			delete message;
+		}
+	}
+
+	void DMLSession::handle_message(const dml::Message *message)
+	{
+		auto *statistics = m_message_statistics.load(std::memory_order_relaxed);
+		if (!statistics)
+		{
+			invoke_handler(message);
+			return;
+		}
+
+		const auto start_time = std::chrono::steady_clock::now();
+		invoke_handler(message);
+		statistics->add_handled(message->get_service_id(), message->get_type(),
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start_time));
+	}
+
+	void DMLSession::invoke_handler(const dml::Message *message)
+	{
+		if (m_handler_table && m_handler_table->dispatch(*this, *message))
+			return;
+
+		on_message(message);
 	}
 }
 }
@@ -0,0 +1,245 @@
+#include "ki/protocol/net/DMLStatistics.h"
+#include "ki/protocol/dml/MessageManager.h"
+#include <cstdio>
+#include <iomanip>
+#include <string>
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	namespace
+	{
+		void increment(std::atomic<uint64_t> &counter, const uint64_t amount = 1)
+		{
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+
+		uint64_t load(const std::atomic<uint64_t> &counter)
+		{
+			return counter.load(std::memory_order_relaxed);
+		}
+
+		uint64_t to_nanoseconds(const std::chrono::nanoseconds time)
+		{
+			return time.count() > 0 ? time.count() : 0;
+		}
+
+		/**
+		 * Looks up the protocol type and message name of a pair,
+		 * leaving them empty if they are not known.
+		 */
+		void get_names(const dml::MessageManager *manager,
+			const DMLMessageStatistics &statistics,
+			std::string &protocol_type, std::string &message_name)
+		{
+			protocol_type.clear();
+			message_name.clear();
+			if (!manager)
+				return;
+
+			const auto *message_module = manager->get_module(statistics.service_id);
+			if (!message_module)
+				return;
+			protocol_type = message_module->get_protocol_type();
+
+			const auto *message_template = message_module->get_message_template(statistics.message_type);
+			if (message_template)
+				message_name = message_template->get_name();
+		}
+
+		void write_json_string(std::ostream &ostream, const std::string &value)
+		{
+			ostream << '"';
+			for (const char c : value)
+			{
+				if (c == '"' || c == '\\')
+					ostream << '\\' << c;
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escaped[7];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					ostream << escaped;
+				}
+				else
+					ostream << c;
+			}
+			ostream << '"';
+		}
+	}
+
+	DMLStatistics::DMLStatistics()
+	{
+		for (auto &row : m_rows)
+			row = nullptr;
+	}
+
+	DMLStatistics::~DMLStatistics()
+	{
+		for (auto &row : m_rows)
+			delete row.load();
+	}
+
+	void DMLStatistics::add_decoded(const uint8_t service_id, const uint8_t message_type,
+		const size_t size, const std::chrono::nanoseconds time)
+	{
+		auto &counters = get_counters(service_id, message_type);
+		increment(counters.messages_decoded);
+		increment(counters.bytes_decoded, size);
+		increment(counters.decode_time, to_nanoseconds(time));
+	}
+
+	void DMLStatistics::add_handled(const uint8_t service_id, const uint8_t message_type,
+		const std::chrono::nanoseconds time)
+	{
+		auto &counters = get_counters(service_id, message_type);
+		increment(counters.messages_handled);
+		increment(counters.handler_time, to_nanoseconds(time));
+	}
+
+	void DMLStatistics::add_encoded(const uint8_t service_id, const uint8_t message_type,
+		const size_t size)
+	{
+		auto &counters = get_counters(service_id, message_type);
+		increment(counters.messages_encoded);
+		increment(counters.bytes_encoded, size);
+	}
+
+	std::vector<DMLMessageStatistics> DMLStatistics::get_snapshot() const
+	{
+		std::vector<DMLMessageStatistics> snapshot;
+		for (size_t service_id = 0; service_id < m_rows.size(); ++service_id)
+		{
+			const auto *row = m_rows[service_id].load(std::memory_order_acquire);
+			if (!row)
+				continue;
+
+			for (size_t message_type = 0; message_type < row->size(); ++message_type)
+			{
+				const auto &counters = (*row)[message_type];
+				DMLMessageStatistics statistics;
+				statistics.service_id = static_cast<uint8_t>(service_id);
+				statistics.message_type = static_cast<uint8_t>(message_type);
+				statistics.messages_decoded = load(counters.messages_decoded);
+				statistics.bytes_decoded = load(counters.bytes_decoded);
+				statistics.decode_time = std::chrono::nanoseconds(load(counters.decode_time));
+				statistics.messages_handled = load(counters.messages_handled);
+				statistics.handler_time = std::chrono::nanoseconds(load(counters.handler_time));
+				statistics.messages_encoded = load(counters.messages_encoded);
+				statistics.bytes_encoded = load(counters.bytes_encoded);
+
+				if (statistics.messages_decoded || statistics.messages_handled ||
+					statistics.messages_encoded)
+					snapshot.push_back(statistics);
+			}
+		}
+		return snapshot;
+	}
+
+	void DMLStatistics::write_text(std::ostream &ostream,
+		const dml::MessageManager *manager) const
+	{
+		ostream << std::left
+			<< std::setw(8) << "SERVICE" << std::setw(6) << "TYPE"
+			<< std::setw(32) << "NAME" << std::right
+			<< std::setw(12) << "DECODED" << std::setw(14) << "BYTES IN"
+			<< std::setw(14) << "DECODE NS" << std::setw(12) << "HANDLED"
+			<< std::setw(14) << "HANDLER NS" << std::setw(12) << "ENCODED"
+			<< std::setw(14) << "BYTES OUT" << '\n';
+
+		std::string protocol_type;
+		std::string message_name;
+		const auto snapshot = get_snapshot();
+		for (const auto &statistics : snapshot)
+		{
+			get_names(manager, statistics, protocol_type, message_name);
+			std::string name = protocol_type;
+			if (!message_name.empty())
+				name += name.empty() ? message_name : "::" + message_name;
+
+			ostream << std::left
+				<< std::setw(8) << static_cast<uint16_t>(statistics.service_id)
+				<< std::setw(6) << static_cast<uint16_t>(statistics.message_type)
+				<< std::setw(32) << (name.empty() ? "-" : name) << std::right
+				<< std::setw(12) << statistics.messages_decoded
+				<< std::setw(14) << statistics.bytes_decoded
+				<< std::setw(14) << statistics.decode_time.count()
+				<< std::setw(12) << statistics.messages_handled
+				<< std::setw(14) << statistics.handler_time.count()
+				<< std::setw(12) << statistics.messages_encoded
+				<< std::setw(14) << statistics.bytes_encoded << '\n';
+		}
+	}
+
+	void DMLStatistics::write_json(std::ostream &ostream,
+		const dml::MessageManager *manager) const
+	{
+		std::string protocol_type;
+		std::string message_name;
+		const auto snapshot = get_snapshot();
+
+		ostream << '[';
+		for (size_t i = 0; i < snapshot.size(); ++i)
+		{
+			const auto &statistics = snapshot[i];
+			if (i > 0)
+				ostream << ',';
+			ostream << "{\"service_id\":" << static_cast<uint16_t>(statistics.service_id)
+				<< ",\"message_type\":" << static_cast<uint16_t>(statistics.message_type);
+
+			get_names(manager, statistics, protocol_type, message_name);
+			if (!protocol_type.empty())
+			{
+				ostream << ",\"protocol_type\":";
+				write_json_string(ostream, protocol_type);
+			}
+			if (!message_name.empty())
+			{
+				ostream << ",\"message_name\":";
+				write_json_string(ostream, message_name);
+			}
+
+			ostream << ",\"messages_decoded\":" << statistics.messages_decoded
+				<< ",\"bytes_decoded\":" << statistics.bytes_decoded
+				<< ",\"decode_time_ns\":" << statistics.decode_time.count()
+				<< ",\"messages_handled\":" << statistics.messages_handled
+				<< ",\"handler_time_ns\":" << statistics.handler_time.count()
+				<< ",\"messages_encoded\":" << statistics.messages_encoded
+				<< ",\"bytes_encoded\":" << statistics.bytes_encoded << '}';
+		}
+		ostream << ']';
+	}
+
+	DMLStatistics::Counters &DMLStatistics::get_counters(
+		const uint8_t service_id, const uint8_t message_type)
+	{
+		auto &slot = m_rows[service_id];
+		auto *row = slot.load(std::memory_order_acquire);
+		if (!row)
+		{
+			// Several threads may race to create the row; the
+			// first one wins, and the others delete theirs.
+			auto *new_row = new CounterRow();
+			for (auto &counters : *new_row)
+			{
+				counters.messages_decoded = 0;
+				counters.bytes_decoded = 0;
+				counters.decode_time = 0;
+				counters.messages_handled = 0;
+				counters.handler_time = 0;
+				counters.messages_encoded = 0;
+				counters.bytes_encoded = 0;
+			}
+
+			if (slot.compare_exchange_strong(row, new_row, std::memory_order_acq_rel))
+				row = new_row;
+			else
+				delete new_row;
+		}
+		return (*row)[message_type];
+	}
+}
+}
+}
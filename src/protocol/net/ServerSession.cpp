@@ -161,9 +161,10 @@ namespace net
 		}
 
 		// Calculate latency and allow for KEEP_ALIVE packets to be sent again
-		m_latency = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::steady_clock::now() - m_last_sent_heartbeat_time
-			).count();
+		const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - m_last_sent_heartbeat_time);
+		m_counters.add_rtt_sample(rtt);
+		m_latency = std::chrono::duration_cast<std::chrono::milliseconds>(rtt).count();
 		m_waiting_for_keep_alive_response = false;
 	}
 }
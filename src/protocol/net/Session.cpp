@@ -1,4 +1,5 @@
 #include "ki/protocol/net/Session.h"
+#include "ki/protocol/net/Capture.h"
 #include "ki/protocol/exception.h"
 #include <cstring>
 
@@ -22,6 +23,19 @@ namespace net
 		m_start_signal = 0;
 		m_incoming_packet_size = 0;
 		m_shift = 0;
+
+		m_send_queue_enabled = false;
+		m_send_queue_policy = SendQueuePolicy::NOTIFY;
+		m_send_queue_high_water_bytes = KI_DEFAULT_SEND_QUEUE_HIGH_WATER_BYTES;
+		m_send_queue_high_water_packets = KI_DEFAULT_SEND_QUEUE_HIGH_WATER_PACKETS;
+		m_send_queue_low_water_bytes = KI_DEFAULT_SEND_QUEUE_LOW_WATER_BYTES;
+		m_send_queue_over_limits = false;
+		m_send_buffer_offset = 0;
+
+		m_coalescing_delay = std::chrono::microseconds::zero();
+		m_coalescing_threshold = 0;
+
+		m_capture_writer = nullptr;
 	}
 
 	uint16_t Session::get_maximum_packet_size() const
@@ -59,8 +73,13 @@ namespace net
 		return m_latency;
 	}
 
-	void Session::send_packet(const bool is_control, const uint8_t opcode,
-		const util::Serializable& data)
+	SessionStatistics Session::get_statistics() const
+	{
+		return m_counters.get_snapshot();
+	}
+
+	bool Session::send_packet(const bool is_control, const uint8_t opcode,
+		const util::Serializable& data, const bool urgent)
 	{
 		std::ostringstream ss;
 		PacketHeader header(is_control, opcode);
@@ -68,26 +87,217 @@ namespace net
 		data.write_to(ss);
 
 		const auto buffer = ss.str();
-		send_data(buffer.c_str(), buffer.length());
+		return send_data(buffer.c_str(), buffer.length(), urgent || is_control);
+	}
+
+	bool Session::is_coalescing() const
+	{
+		return m_coalescing_delay > std::chrono::microseconds::zero();
+	}
+
+	std::chrono::microseconds Session::get_coalescing_delay() const
+	{
+		return m_coalescing_delay;
 	}
 
-	void Session::send_data(const char* data, const size_t size)
+	size_t Session::get_coalescing_threshold() const
 	{
-		// Allocate the entire buffer
-		char *packet_data = new char[size + 4];
+		return m_coalescing_threshold;
+	}
+
+	void Session::set_coalescing(const std::chrono::microseconds max_delay,
+		const size_t threshold)
+	{
+		m_coalescing_delay = max_delay;
+		m_coalescing_threshold = threshold;
+
+		// Don't hold on to anything if coalescing was just disabled
+		if (!is_coalescing() && !m_send_queue_enabled)
+			flush();
+	}
+
+	void Session::flush()
+	{
+		while (!m_queued_packet_sizes.empty())
+			flush_send_queue();
+	}
+
+	bool Session::flush_expired()
+	{
+		if (m_send_queue_enabled || m_queued_packet_sizes.empty())
+			return false;
+		if (std::chrono::steady_clock::now() - m_coalescing_start_time < m_coalescing_delay)
+			return false;
 
-		// Add the frame header
-		((uint16_t *)packet_data)[0] = KI_START_SIGNAL;
-		((uint16_t *)packet_data)[1] = size;
+		flush();
+		return true;
+	}
 
-		// Copy the payload into the buffer and send it
+	bool Session::is_send_queue_enabled() const
+	{
+		return m_send_queue_enabled;
+	}
+
+	void Session::set_send_queue_enabled(const bool enabled)
+	{
+		if (!enabled)
+		{
+			while (!m_queued_packet_sizes.empty())
+				flush_send_queue();
+		}
+		m_send_queue_enabled = enabled;
+	}
+
+	void Session::set_send_queue_limits(const size_t high_water_bytes,
+		const size_t high_water_packets, const size_t low_water_bytes)
+	{
+		m_send_queue_high_water_bytes = high_water_bytes;
+		m_send_queue_high_water_packets = high_water_packets;
+		m_send_queue_low_water_bytes = low_water_bytes;
+	}
+
+	SendQueuePolicy Session::get_send_queue_policy() const
+	{
+		return m_send_queue_policy;
+	}
+
+	void Session::set_send_queue_policy(const SendQueuePolicy policy)
+	{
+		m_send_queue_policy = policy;
+	}
+
+	size_t Session::get_queued_bytes() const
+	{
+		return m_send_buffer.size() - m_send_buffer_offset;
+	}
+
+	size_t Session::get_queued_packets() const
+	{
+		return m_queued_packet_sizes.size();
+	}
+
+	bool Session::is_send_queue_over_limits() const
+	{
+		return m_send_queue_over_limits;
+	}
+
+	size_t Session::flush_send_queue(const size_t maximum_bytes)
+	{
+		if (m_queued_packet_sizes.empty())
+			return 0;
+
+		// Take as many whole packets as will fit
+		size_t size = 0;
+		do
+		{
+			size += m_queued_packet_sizes.front();
+			m_queued_packet_sizes.pop_front();
+		} while (!m_queued_packet_sizes.empty() &&
+			size + m_queued_packet_sizes.front() <= maximum_bytes);
+
+		send_packet_data(&m_send_buffer[m_send_buffer_offset], size);
+		m_send_buffer_offset += size;
+
+		// Reclaim the space at the front of the buffer once it's empty,
+		// or once more than half of it has already been written.
+		if (m_send_buffer_offset == m_send_buffer.size())
+		{
+			m_send_buffer.clear();
+			m_send_buffer_offset = 0;
+		}
+		else if (m_send_buffer_offset > m_send_buffer.size() / 2)
+		{
+			m_send_buffer.erase(m_send_buffer.begin(),
+				m_send_buffer.begin() + m_send_buffer_offset);
+			m_send_buffer_offset = 0;
+		}
+
+		if (m_send_queue_over_limits &&
+			get_queued_bytes() <= m_send_queue_low_water_bytes)
+		{
+			m_send_queue_over_limits = false;
+			on_send_queue_low();
+		}
+
+		return size;
+	}
+
+	CaptureWriter *Session::get_capture_writer() const
+	{
+		return m_capture_writer;
+	}
+
+	void Session::set_capture_writer(CaptureWriter *writer)
+	{
+		m_capture_writer = writer;
+		m_capture_buffer.clear();
+	}
+
+	bool Session::send_data(const char* data, const size_t size, const bool urgent)
+	{
+		if (m_send_queue_enabled && !check_send_queue_limits(size + 4))
+			return false;
+
+		// The first byte of the packet header is the control flag
+		m_counters.add_frame_sent(size + 4, size > 0 && data[0] != 0);
+
+		// Append the frame header and payload to the send buffer
+		const size_t position = m_send_buffer.size();
+		m_send_buffer.resize(position + size + 4);
+		char *packet_data = &m_send_buffer[position];
+		packet_data[0] = KI_START_SIGNAL & 0xFF;
+		packet_data[1] = (KI_START_SIGNAL >> 8) & 0xFF;
+		packet_data[2] = size & 0xFF;
+		packet_data[3] = (size >> 8) & 0xFF;
 		std::memcpy(&packet_data[4], data, size);
-		send_packet_data(packet_data, size + 4);
-		delete[] packet_data;
+		if (m_capture_writer)
+			m_capture_writer->write_frame(m_id, CaptureDirection::OUTBOUND, packet_data, size + 4);
+
+		// The transport decides when to write queued packets
+		m_queued_packet_sizes.push_back(size + 4);
+		if (m_send_queue_enabled)
+			return true;
+
+		// Hold on to this packet if we're still within the
+		// coalescing delay and threshold.
+		if (is_coalescing() && !urgent)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			if (m_queued_packet_sizes.size() == 1)
+				m_coalescing_start_time = now;
+
+			if (get_queued_bytes() < m_coalescing_threshold &&
+				now - m_coalescing_start_time < m_coalescing_delay)
+				return true;
+		}
+
+		flush();
+		return true;
+	}
+
+	bool Session::check_send_queue_limits(const size_t size)
+	{
+		if (!m_send_queue_over_limits)
+		{
+			if (get_queued_bytes() + size <= m_send_queue_high_water_bytes &&
+				get_queued_packets() < m_send_queue_high_water_packets)
+				return true;
+
+			m_send_queue_over_limits = true;
+			if (m_send_queue_policy == SendQueuePolicy::CLOSE)
+			{
+				close(SessionCloseErrorCode::SEND_QUEUE_OVERFLOW);
+				return false;
+			}
+			on_send_queue_high();
+		}
+
+		return m_send_queue_policy == SendQueuePolicy::NOTIFY;
 	}
 
 	void Session::process_data(const char *data, const size_t size)
 	{
+		m_counters.add_bytes_received(size);
 		size_t position = 0;
 		while (position < size)
 		{
@@ -104,6 +314,7 @@ namespace net
 					// correctly.
 					if (m_start_signal != KI_START_SIGNAL)
 					{
+						m_counters.add_invalid_packet();
 						close(SessionCloseErrorCode::INVALID_FRAMING_START_SIGNAL);
 						return;
 					}
@@ -126,6 +337,7 @@ namespace net
 					// stop processing data.
 					if (m_incoming_packet_size > m_maximum_packet_size)
 					{
+						m_counters.add_invalid_packet();
 						close(SessionCloseErrorCode::INVALID_FRAMING_SIZE_EXCEEDS_MAXIMUM);
 						return;
 					}
@@ -134,6 +346,16 @@ namespace net
 					m_data_stream.seekp(0, std::ios::beg);
 					m_data_stream.seekg(0, std::ios::beg);
 					m_receive_state = ReceiveState::WAITING_FOR_PACKET;
+
+					// Start capturing the frame
+					if (m_capture_writer)
+					{
+						m_capture_buffer.resize(4);
+						m_capture_buffer[0] = KI_START_SIGNAL & 0xFF;
+						m_capture_buffer[1] = (KI_START_SIGNAL >> 8) & 0xFF;
+						m_capture_buffer[2] = m_incoming_packet_size & 0xFF;
+						m_capture_buffer[3] = (m_incoming_packet_size >> 8) & 0xFF;
+					}
 				}
 				position++;
 				break;
@@ -146,12 +368,23 @@ namespace net
 
 				//  Write the data to the data stream
 				m_data_stream.write(&data[position], read_size);
+				if (!m_capture_buffer.empty())
+					m_capture_buffer.insert(m_capture_buffer.end(),
+						&data[position], &data[position] + read_size);
 				position += read_size;
 				m_incoming_packet_size -= read_size;
 
 				// Have we received the entire packet?
 				if (m_incoming_packet_size == 0)
 				{
+					if (!m_capture_buffer.empty())
+					{
+						if (m_capture_writer)
+							m_capture_writer->write_frame(m_id, CaptureDirection::INBOUND,
+								m_capture_buffer.data(), m_capture_buffer.size());
+						m_capture_buffer.clear();
+					}
+					m_counters.add_frame_received();
 					on_packet_available();
 
 					// Reset the shift and start signal
@@ -174,9 +407,11 @@ namespace net
 		}
 		catch (parse_error &e)
 		{
+			m_counters.add_invalid_packet();
 			on_invalid_packet();
 			return;
 		}
+		m_counters.add_message_received(header.is_control());
 
 		// Hand off to the right handler based on
 		// whether this is a control packet or not
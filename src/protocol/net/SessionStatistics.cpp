@@ -0,0 +1,164 @@
+#include "ki/protocol/net/SessionStatistics.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace ki
+{
+namespace protocol
+{
+namespace net
+{
+	namespace
+	{
+		void increment(std::atomic<uint64_t> &counter, const uint64_t amount = 1)
+		{
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+
+		uint64_t load(const std::atomic<uint64_t> &counter)
+		{
+			return counter.load(std::memory_order_relaxed);
+		}
+
+		size_t get_rtt_bucket(uint64_t microseconds)
+		{
+			size_t bucket = 0;
+			while (microseconds > 1 && bucket < KI_SESSION_RTT_HISTOGRAM_BUCKETS - 1)
+			{
+				microseconds >>= 1;
+				bucket++;
+			}
+			return bucket;
+		}
+	}
+
+	uint64_t SessionStatistics::get_decode_errors(const InvalidDMLMessageErrorCode error) const
+	{
+		const auto index = static_cast<size_t>(error);
+		if (index < decode_errors.size())
+			return decode_errors[index];
+		return 0;
+	}
+
+	std::chrono::microseconds SessionStatistics::get_rtt_percentile(const double fraction) const
+	{
+		if (rtt_samples == 0)
+			return std::chrono::microseconds::zero();
+
+		const auto target = static_cast<uint64_t>(std::ceil(fraction * rtt_samples));
+		uint64_t count = 0;
+		for (size_t i = 0; i < rtt_histogram.size(); ++i)
+		{
+			count += rtt_histogram[i];
+			if (count >= target && count > 0)
+				return std::chrono::microseconds(int64_t(1) << (i + 1));
+		}
+		return std::chrono::microseconds(int64_t(1) << rtt_histogram.size());
+	}
+
+	SessionCounters::SessionCounters()
+	{
+		m_frames_received = 0;
+		m_bytes_received = 0;
+		m_control_messages_received = 0;
+		m_application_messages_received = 0;
+		m_frames_sent = 0;
+		m_bytes_sent = 0;
+		m_control_messages_sent = 0;
+		m_application_messages_sent = 0;
+		m_invalid_packets = 0;
+		for (auto &counter : m_decode_errors)
+			counter = 0;
+
+		m_rtt_samples = 0;
+		m_last_rtt = 0;
+		m_smoothed_rtt = 0;
+		m_rtt_jitter = 0;
+		for (auto &counter : m_rtt_histogram)
+			counter = 0;
+	}
+
+	void SessionCounters::add_bytes_received(const size_t size)
+	{
+		increment(m_bytes_received, size);
+	}
+
+	void SessionCounters::add_frame_received()
+	{
+		increment(m_frames_received);
+	}
+
+	void SessionCounters::add_message_received(const bool is_control)
+	{
+		increment(is_control ? m_control_messages_received : m_application_messages_received);
+	}
+
+	void SessionCounters::add_frame_sent(const size_t size, const bool is_control)
+	{
+		increment(m_frames_sent);
+		increment(m_bytes_sent, size);
+		increment(is_control ? m_control_messages_sent : m_application_messages_sent);
+	}
+
+	void SessionCounters::add_invalid_packet()
+	{
+		increment(m_invalid_packets);
+	}
+
+	void SessionCounters::add_decode_error(const InvalidDMLMessageErrorCode error)
+	{
+		const auto index = static_cast<size_t>(error);
+		if (index < m_decode_errors.size())
+			increment(m_decode_errors[index]);
+	}
+
+	void SessionCounters::add_rtt_sample(const std::chrono::microseconds rtt)
+	{
+		const int64_t sample = rtt.count() > 0 ? rtt.count() : 0;
+		increment(m_rtt_histogram[get_rtt_bucket(sample)]);
+
+		// Only one thread records samples, so the averages can be
+		// updated with plain loads and stores.
+		const int64_t smoothed = m_smoothed_rtt.load(std::memory_order_relaxed);
+		const int64_t jitter = m_rtt_jitter.load(std::memory_order_relaxed);
+		if (m_rtt_samples.load(std::memory_order_relaxed) == 0)
+		{
+			m_smoothed_rtt.store(sample, std::memory_order_relaxed);
+			m_rtt_jitter.store(sample / 2, std::memory_order_relaxed);
+		}
+		else
+		{
+			m_rtt_jitter.store(jitter + (std::llabs(smoothed - sample) - jitter) / 4,
+				std::memory_order_relaxed);
+			m_smoothed_rtt.store(smoothed + (sample - smoothed) / 8, std::memory_order_relaxed);
+		}
+		m_last_rtt.store(sample, std::memory_order_relaxed);
+		increment(m_rtt_samples);
+	}
+
+	SessionStatistics SessionCounters::get_snapshot() const
+	{
+		SessionStatistics statistics;
+		statistics.frames_received = load(m_frames_received);
+		statistics.bytes_received = load(m_bytes_received);
+		statistics.control_messages_received = load(m_control_messages_received);
+		statistics.application_messages_received = load(m_application_messages_received);
+		statistics.frames_sent = load(m_frames_sent);
+		statistics.bytes_sent = load(m_bytes_sent);
+		statistics.control_messages_sent = load(m_control_messages_sent);
+		statistics.application_messages_sent = load(m_application_messages_sent);
+		statistics.invalid_packets = load(m_invalid_packets);
+		for (size_t i = 0; i < m_decode_errors.size(); ++i)
+			statistics.decode_errors[i] = load(m_decode_errors[i]);
+
+		statistics.rtt_samples = load(m_rtt_samples);
+		statistics.last_rtt = std::chrono::microseconds(m_last_rtt.load(std::memory_order_relaxed));
+		statistics.smoothed_rtt = std::chrono::microseconds(m_smoothed_rtt.load(std::memory_order_relaxed));
+		statistics.rtt_jitter = std::chrono::microseconds(m_rtt_jitter.load(std::memory_order_relaxed));
+		for (size_t i = 0; i < m_rtt_histogram.size(); ++i)
+			statistics.rtt_histogram[i] = load(m_rtt_histogram[i]);
+		return statistics;
+	}
+}
+}
+}
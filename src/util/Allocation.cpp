@@ -0,0 +1,96 @@
+#include "ki/util/Allocation.h"
+#include <atomic>
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		struct AtomicCounters
+		{
+			std::atomic<size_t> allocations;
+			std::atomic<size_t> deallocations;
+			std::atomic<size_t> bytes_allocated;
+			std::atomic<size_t> bytes_deallocated;
+		};
+
+		const size_t category_count = static_cast<size_t>(AllocationCategory::COUNT);
+
+		// Zero-initialized, since these have static storage duration
+		AtomicCounters g_counters[category_count];
+		std::atomic<Allocator *> g_allocator(nullptr);
+	}
+
+	bool is_allocation_tracking_enabled()
+	{
+#ifdef KI_ALLOCATION_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void set_allocator(Allocator *allocator)
+	{
+		g_allocator = allocator;
+	}
+
+	Allocator *get_allocator()
+	{
+		return g_allocator;
+	}
+
+	AllocationStats get_allocation_stats()
+	{
+		AllocationStats stats;
+		for (size_t i = 0; i < category_count; ++i)
+		{
+			stats.categories[i].allocations = g_counters[i].allocations.load(std::memory_order_relaxed);
+			stats.categories[i].deallocations = g_counters[i].deallocations.load(std::memory_order_relaxed);
+			stats.categories[i].bytes_allocated = g_counters[i].bytes_allocated.load(std::memory_order_relaxed);
+			stats.categories[i].bytes_deallocated = g_counters[i].bytes_deallocated.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	void reset_allocation_stats()
+	{
+		for (size_t i = 0; i < category_count; ++i)
+		{
+			g_counters[i].allocations = 0;
+			g_counters[i].deallocations = 0;
+			g_counters[i].bytes_allocated = 0;
+			g_counters[i].bytes_deallocated = 0;
+		}
+	}
+
+	void *allocate(const size_t size, const AllocationCategory category)
+	{
+		auto &counters = g_counters[static_cast<size_t>(category)];
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+
+		auto *allocator = g_allocator.load(std::memory_order_acquire);
+		if (allocator)
+			return allocator->allocate(size, category);
+		return ::operator new(size);
+	}
+
+	void deallocate(void *ptr, const size_t size, const AllocationCategory category)
+	{
+		if (!ptr)
+			return;
+
+		auto &counters = g_counters[static_cast<size_t>(category)];
+		counters.deallocations.fetch_add(1, std::memory_order_relaxed);
+		counters.bytes_deallocated.fetch_add(size, std::memory_order_relaxed);
+
+		auto *allocator = g_allocator.load(std::memory_order_acquire);
+		if (allocator)
+			allocator->deallocate(ptr, size, category);
+		else
+			::operator delete(ptr);
+	}
+}
+}
@@ -0,0 +1,95 @@
+#include "ki/util/Arena.h"
+#include <cstdint>
+
+namespace ki
+{
+namespace util
+{
+	Arena::Arena(const size_t block_size)
+	{
+		m_block_size = block_size;
+		m_current_block = 0;
+		m_position = 0;
+		m_bytes_used = 0;
+		m_destructors = nullptr;
+	}
+
+	Arena::~Arena()
+	{
+		reset();
+		for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it)
+			::operator delete(it->data);
+		m_blocks.clear();
+	}
+
+	void *Arena::allocate(const size_t size, const size_t alignment)
+	{
+		// Find a block with enough space left, starting from the
+		// block that we're currently allocating from.
+		while (m_current_block < m_blocks.size())
+		{
+			auto &block = m_blocks[m_current_block];
+			const auto address = reinterpret_cast<uintptr_t>(block.data) + m_position;
+			const size_t padding = (alignment - (address % alignment)) % alignment;
+			if (m_position + padding + size <= block.size)
+			{
+				void *ptr = block.data + m_position + padding;
+				m_position += padding + size;
+				m_bytes_used += size;
+				return ptr;
+			}
+
+			m_current_block++;
+			m_position = 0;
+		}
+
+		// Allocate a new block, making sure it's large enough for
+		// oversized allocations.
+		Block block;
+		block.size = size + alignment > m_block_size ? size + alignment : m_block_size;
+		block.data = static_cast<char *>(::operator new(block.size));
+		m_blocks.push_back(block);
+		m_current_block = m_blocks.size() - 1;
+		m_position = 0;
+		return allocate(size, alignment);
+	}
+
+	void Arena::reset()
+	{
+		// Destroy objects in the reverse order to their creation
+		while (m_destructors)
+		{
+			auto *node = m_destructors;
+			m_destructors = node->next;
+			node->destructor(node->object);
+		}
+
+		m_current_block = 0;
+		m_position = 0;
+		m_bytes_used = 0;
+	}
+
+	size_t Arena::get_bytes_used() const
+	{
+		return m_bytes_used;
+	}
+
+	size_t Arena::get_bytes_reserved() const
+	{
+		size_t size = 0;
+		for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it)
+			size += it->size;
+		return size;
+	}
+
+	void Arena::register_destructor(void *object, void (*destructor)(void *))
+	{
+		auto *node = static_cast<DestructorNode *>(
+			allocate(sizeof(DestructorNode), alignof(DestructorNode)));
+		node->destructor = destructor;
+		node->object = object;
+		node->next = m_destructors;
+		m_destructors = node;
+	}
+}
+}
@@ -0,0 +1,51 @@
+#include "ki/util/Fingerprint.h"
+
+#define KI_FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+#define KI_FNV_PRIME 0x100000001B3ull
+
+namespace ki
+{
+namespace util
+{
+	Fingerprint::Fingerprint()
+	{
+		m_value = KI_FNV_OFFSET_BASIS;
+	}
+
+	void Fingerprint::add(const char *data, const size_t size)
+	{
+		add(static_cast<uint64_t>(size));
+		add_bytes(data, size);
+	}
+
+	void Fingerprint::add(const std::string &value)
+	{
+		add(value.data(), value.size());
+	}
+
+	void Fingerprint::add(uint64_t value)
+	{
+		char bytes[sizeof(uint64_t)];
+		for (size_t i = 0; i < sizeof(bytes); ++i)
+		{
+			bytes[i] = static_cast<char>(value & 0xFF);
+			value >>= 8;
+		}
+		add_bytes(bytes, sizeof(bytes));
+	}
+
+	uint64_t Fingerprint::get_value() const
+	{
+		return m_value;
+	}
+
+	void Fingerprint::add_bytes(const char *data, const size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_value ^= static_cast<uint8_t>(data[i]);
+			m_value *= KI_FNV_PRIME;
+		}
+	}
+}
+}
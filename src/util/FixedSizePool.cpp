@@ -0,0 +1,105 @@
+#include "ki/util/FixedSizePool.h"
+#include <new>
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		const size_t size_class_count =
+			FixedSizePool::maximum_pooled_size / FixedSizePool::size_class_granularity;
+
+		struct FreeBlock
+		{
+			FreeBlock *next;
+		};
+
+		/**
+		 * A thread's free lists, one per size class.
+		 * 
+		 * This is trivially destructible so that it remains usable while
+		 * other thread_local and static objects are being destroyed.
+		 */
+		struct ThreadCache
+		{
+			FreeBlock *free_lists[size_class_count];
+			size_t counts[size_class_count];
+			bool destroyed;
+		};
+
+		thread_local ThreadCache t_cache;
+
+		/**
+		 * Returns the cached blocks to the heap when the thread exits.
+		 * After that, blocks freed on this thread aren't cached.
+		 */
+		struct ThreadCacheCleanup
+		{
+			~ThreadCacheCleanup()
+			{
+				for (size_t i = 0; i < size_class_count; ++i)
+				{
+					while (t_cache.free_lists[i])
+					{
+						auto *block = t_cache.free_lists[i];
+						t_cache.free_lists[i] = block->next;
+						::operator delete(block);
+					}
+					t_cache.counts[i] = 0;
+				}
+				t_cache.destroyed = true;
+			}
+		};
+
+		thread_local ThreadCacheCleanup t_cleanup;
+
+		size_t get_size_class(const size_t size)
+		{
+			return (size + FixedSizePool::size_class_granularity - 1) /
+				FixedSizePool::size_class_granularity - 1;
+		}
+	}
+
+	void *FixedSizePool::allocate(const size_t size)
+	{
+		if (size == 0 || size > maximum_pooled_size)
+			return ::operator new(size);
+
+		const auto size_class = get_size_class(size);
+		auto *block = t_cache.free_lists[size_class];
+		if (block)
+		{
+			t_cache.free_lists[size_class] = block->next;
+			t_cache.counts[size_class]--;
+			return block;
+		}
+
+		// Allocate the full size class so that the block can be
+		// reused for anything else in the same class.
+		return ::operator new((size_class + 1) * size_class_granularity);
+	}
+
+	void FixedSizePool::deallocate(void *ptr, const size_t size)
+	{
+		if (!ptr)
+			return;
+
+		const auto size_class = get_size_class(size);
+		if (size == 0 || size > maximum_pooled_size || t_cache.destroyed ||
+			t_cache.counts[size_class] >= maximum_cached_blocks)
+		{
+			::operator delete(ptr);
+			return;
+		}
+
+		// Make sure the cache is cleaned up when this thread exits
+		(void)&t_cleanup;
+
+		auto *block = static_cast<FreeBlock *>(ptr);
+		block->next = t_cache.free_lists[size_class];
+		t_cache.free_lists[size_class] = block;
+		t_cache.counts[size_class]++;
+	}
+}
+}
@@ -0,0 +1,180 @@
+#include "ki/util/MappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ki
+{
+namespace util
+{
+	MappedFile::MappedFile()
+	{
+		m_data = nullptr;
+		m_size = 0;
+		m_open = false;
+		m_copy_on_write = false;
+#ifdef _WIN32
+		m_file_handle = INVALID_HANDLE_VALUE;
+		m_mapping_handle = nullptr;
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const std::string &filepath, const bool copy_on_write)
+	{
+		close();
+
+		m_file_handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_file_handle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(m_file_handle, &file_size))
+		{
+			close();
+			return false;
+		}
+
+		// Files with no data can't be mapped
+		m_size = static_cast<size_t>(file_size.QuadPart);
+		if (m_size > 0)
+		{
+			m_mapping_handle = CreateFileMappingA(m_file_handle, nullptr,
+				copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping_handle)
+			{
+				close();
+				return false;
+			}
+
+			m_data = static_cast<const char *>(
+				MapViewOfFile(m_mapping_handle, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+			if (!m_data)
+			{
+				close();
+				return false;
+			}
+		}
+
+		m_open = true;
+		m_copy_on_write = copy_on_write;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_mapping_handle)
+			CloseHandle(m_mapping_handle);
+		if (m_file_handle != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file_handle);
+
+		m_data = nullptr;
+		m_size = 0;
+		m_open = false;
+		m_copy_on_write = false;
+		m_file_handle = INVALID_HANDLE_VALUE;
+		m_mapping_handle = nullptr;
+	}
+#else
+	bool MappedFile::open(const std::string &filepath, const bool copy_on_write)
+	{
+		close();
+
+		const int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd == -1)
+			return false;
+
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) == -1)
+		{
+			::close(fd);
+			return false;
+		}
+
+		// Files with no data can't be mapped
+		m_size = static_cast<size_t>(file_stat.st_size);
+		if (m_size > 0)
+		{
+			const int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+			void *data = mmap(nullptr, m_size, protection, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				::close(fd);
+				m_size = 0;
+				return false;
+			}
+
+			// Files are usually read from front to back
+			madvise(data, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char *>(data);
+		}
+
+		// The mapping stays valid after the descriptor is closed
+		::close(fd);
+		m_open = true;
+		m_copy_on_write = copy_on_write;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			munmap(const_cast<char *>(m_data), m_size);
+
+		m_data = nullptr;
+		m_size = 0;
+		m_open = false;
+		m_copy_on_write = false;
+	}
+#endif
+
+	bool MappedFile::is_open() const
+	{
+		return m_open;
+	}
+
+	const char *MappedFile::get_data() const
+	{
+		return m_data;
+	}
+
+	size_t MappedFile::get_size() const
+	{
+		return m_size;
+	}
+
+	char *MappedFile::get_mutable_data() const
+	{
+		return m_copy_on_write ? const_cast<char *>(m_data) : nullptr;
+	}
+
+	bool MappedFile::has_null_terminator() const
+	{
+		if (!m_data)
+			return false;
+
+#ifdef _WIN32
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		const size_t page_size = system_info.dwPageSize;
+#else
+		const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		return m_size % page_size != 0 && m_data[m_size] == '\0';
+	}
+}
+}
@@ -0,0 +1,71 @@
+#include "ki/util/ReclamationDomain.h"
+#include <thread>
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		std::atomic<size_t> g_next_stripe(0);
+
+		/**
+		 * Returns the counter stripe used by the current thread. Threads
+		 * are given stripes in turn, so that they rarely share one.
+		 */
+		size_t get_stripe()
+		{
+			thread_local const size_t stripe =
+				g_next_stripe.fetch_add(1, std::memory_order_relaxed) % KI_RECLAMATION_STRIPES;
+			return stripe;
+		}
+	}
+
+	ReclamationDomain::ReadGuard::ReadGuard(const ReclamationDomain &domain)
+	{
+		const size_t epoch = domain.m_epoch.load();
+		m_counter = &domain.m_counters[epoch & 1][get_stripe()].readers;
+		m_counter->fetch_add(1);
+	}
+
+	ReclamationDomain::ReadGuard::~ReadGuard()
+	{
+		m_counter->fetch_sub(1);
+	}
+
+	ReclamationDomain::ReclamationDomain()
+	{
+		for (auto &stripes : m_counters)
+		{
+			for (auto &counter : stripes)
+				counter.readers = 0;
+		}
+		m_epoch = 0;
+	}
+
+	void ReclamationDomain::synchronize()
+	{
+		std::lock_guard<std::mutex> lock(m_synchronize_mutex);
+
+		// A reader may load the epoch just before it changes, and only
+		// count itself after its stripe has been checked. Any data that
+		// reader finds was published before this call, so it's safe to
+		// miss, but it may still be reading in the next call, so every
+		// call waits for both parities.
+		for (int i = 0; i < 2; ++i)
+		{
+			const size_t epoch = m_epoch.fetch_add(1);
+			wait_for_readers(m_counters[epoch & 1]);
+		}
+	}
+
+	void ReclamationDomain::wait_for_readers(const CounterStripes &stripes) const
+	{
+		for (auto &counter : stripes)
+		{
+			while (counter.readers.load() != 0)
+				std::this_thread::yield();
+		}
+	}
+}
+}
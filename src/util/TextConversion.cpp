@@ -0,0 +1,824 @@
+#include "ki/util/TextConversion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		// Longer input than this is not a number anyone wrote by hand
+		const size_t max_number_length = 128;
+
+		// Every power of ten that a double holds exactly
+		const double exact_powers_of_ten[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+			1e21, 1e22
+		};
+
+		template <typename FloatT>
+		struct FloatTraits;
+
+		template <>
+		struct FloatTraits<float>
+		{
+			typedef uint32_t BitsT;
+
+			// Significant digits written before an exponent is used,
+			// as %g does with its default precision
+			static const int min_precision = 6;
+
+			// Decimal numbers are converted exactly by float arithmetic
+			// when both their digits and power of ten fit in a float
+			static const uint64_t fast_path_max_digits = uint64_t(1) << 24;
+			static const int fast_path_max_exponent = 10;
+
+			// Numbers below 10^min_magnitude round to zero, and numbers
+			// from 10^(max_magnitude - 1) are infinite
+			static const int min_magnitude = -46;
+			static const int max_magnitude = 40;
+		};
+
+		template <>
+		struct FloatTraits<double>
+		{
+			typedef uint64_t BitsT;
+
+			// Any value with 15 (DBL_DIG) or fewer significant digits
+			// was written exactly by %.15g
+			static const int min_precision = 15;
+
+			static const uint64_t fast_path_max_digits = uint64_t(1) << 53;
+			static const int fast_path_max_exponent = 22;
+
+			static const int min_magnitude = -324;
+			static const int max_magnitude = 310;
+		};
+
+		template <typename FloatT>
+		typename FloatTraits<FloatT>::BitsT get_bits(const FloatT value)
+		{
+			typename FloatTraits<FloatT>::BitsT bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		/**
+		 * A floating point number with a 64-bit significand, which is
+		 * f * 2^e. Used to find the shortest digits of a value with the
+		 * Grisu2 algorithm, from "Printing Floating-Point Numbers Quickly
+		 * and Accurately with Integers" by Florian Loitsch.
+		 */
+		struct DiyFp
+		{
+			uint64_t f;
+			int e;
+		};
+
+		DiyFp make_diy_fp(const uint64_t f, const int e)
+		{
+			DiyFp result;
+			result.f = f;
+			result.e = e;
+			return result;
+		}
+
+		/**
+		 * Returns x * y, rounded to 64 bits of significand.
+		 */
+		DiyFp multiply(const DiyFp x, const DiyFp y)
+		{
+			const uint64_t x_low = x.f & 0xFFFFFFFF;
+			const uint64_t x_high = x.f >> 32;
+			const uint64_t y_low = y.f & 0xFFFFFFFF;
+			const uint64_t y_high = y.f >> 32;
+
+			const uint64_t low_low = x_low * y_low;
+			const uint64_t low_high = x_low * y_high;
+			const uint64_t high_low = x_high * y_low;
+			const uint64_t high_high = x_high * y_high;
+
+			uint64_t middle = (low_low >> 32) + (low_high & 0xFFFFFFFF) + (high_low & 0xFFFFFFFF);
+			middle += uint64_t(1) << 31;
+			return make_diy_fp(high_high + (low_high >> 32) + (high_low >> 32) + (middle >> 32),
+				x.e + y.e + 64);
+		}
+
+		DiyFp normalize(DiyFp x)
+		{
+			while ((x.f >> 63) == 0)
+			{
+				x.f <<= 1;
+				x.e--;
+			}
+			return x;
+		}
+
+		/**
+		 * A power of ten, 10^k, as a normalized DiyFp.
+		 */
+		struct CachedPower
+		{
+			uint64_t f;
+			int e;
+			int k;
+		};
+
+		// Every 8th power of ten from 10^-300 to 10^324
+		const CachedPower cached_powers[] = {
+			{ 0xAB70FE17C79AC6CA, -1060, -300 },
+			{ 0xFF77B1FCBEBCDC4F, -1034, -292 },
+			{ 0xBE5691EF416BD60C, -1007, -284 },
+			{ 0x8DD01FAD907FFC3C,  -980, -276 },
+			{ 0xD3515C2831559A83,  -954, -268 },
+			{ 0x9D71AC8FADA6C9B5,  -927, -260 },
+			{ 0xEA9C227723EE8BCB,  -901, -252 },
+			{ 0xAECC49914078536D,  -874, -244 },
+			{ 0x823C12795DB6CE57,  -847, -236 },
+			{ 0xC21094364DFB5637,  -821, -228 },
+			{ 0x9096EA6F3848984F,  -794, -220 },
+			{ 0xD77485CB25823AC7,  -768, -212 },
+			{ 0xA086CFCD97BF97F4,  -741, -204 },
+			{ 0xEF340A98172AACE5,  -715, -196 },
+			{ 0xB23867FB2A35B28E,  -688, -188 },
+			{ 0x84C8D4DFD2C63F3B,  -661, -180 },
+			{ 0xC5DD44271AD3CDBA,  -635, -172 },
+			{ 0x936B9FCEBB25C996,  -608, -164 },
+			{ 0xDBAC6C247D62A584,  -582, -156 },
+			{ 0xA3AB66580D5FDAF6,  -555, -148 },
+			{ 0xF3E2F893DEC3F126,  -529, -140 },
+			{ 0xB5B5ADA8AAFF80B8,  -502, -132 },
+			{ 0x87625F056C7C4A8B,  -475, -124 },
+			{ 0xC9BCFF6034C13053,  -449, -116 },
+			{ 0x964E858C91BA2655,  -422, -108 },
+			{ 0xDFF9772470297EBD,  -396, -100 },
+			{ 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+			{ 0xF8A95FCF88747D94,  -343,  -84 },
+			{ 0xB94470938FA89BCF,  -316,  -76 },
+			{ 0x8A08F0F8BF0F156B,  -289,  -68 },
+			{ 0xCDB02555653131B6,  -263,  -60 },
+			{ 0x993FE2C6D07B7FAC,  -236,  -52 },
+			{ 0xE45C10C42A2B3B06,  -210,  -44 },
+			{ 0xAA242499697392D3,  -183,  -36 },
+			{ 0xFD87B5F28300CA0E,  -157,  -28 },
+			{ 0xBCE5086492111AEB,  -130,  -20 },
+			{ 0x8CBCCC096F5088CC,  -103,  -12 },
+			{ 0xD1B71758E219652C,   -77,   -4 },
+			{ 0x9C40000000000000,   -50,    4 },
+			{ 0xE8D4A51000000000,   -24,   12 },
+			{ 0xAD78EBC5AC620000,     3,   20 },
+			{ 0x813F3978F8940984,    30,   28 },
+			{ 0xC097CE7BC90715B3,    56,   36 },
+			{ 0x8F7E32CE7BEA5C70,    83,   44 },
+			{ 0xD5D238A4ABE98068,   109,   52 },
+			{ 0x9F4F2726179A2245,   136,   60 },
+			{ 0xED63A231D4C4FB27,   162,   68 },
+			{ 0xB0DE65388CC8ADA8,   189,   76 },
+			{ 0x83C7088E1AAB65DB,   216,   84 },
+			{ 0xC45D1DF942711D9A,   242,   92 },
+			{ 0x924D692CA61BE758,   269,  100 },
+			{ 0xDA01EE641A708DEA,   295,  108 },
+			{ 0xA26DA3999AEF774A,   322,  116 },
+			{ 0xF209787BB47D6B85,   348,  124 },
+			{ 0xB454E4A179DD1877,   375,  132 },
+			{ 0x865B86925B9BC5C2,   402,  140 },
+			{ 0xC83553C5C8965D3D,   428,  148 },
+			{ 0x952AB45CFA97A0B3,   455,  156 },
+			{ 0xDE469FBD99A05FE3,   481,  164 },
+			{ 0xA59BC234DB398C25,   508,  172 },
+			{ 0xF6C69A72A3989F5C,   534,  180 },
+			{ 0xB7DCBF5354E9BECE,   561,  188 },
+			{ 0x88FCF317F22241E2,   588,  196 },
+			{ 0xCC20CE9BD35C78A5,   614,  204 },
+			{ 0x98165AF37B2153DF,   641,  212 },
+			{ 0xE2A0B5DC971F303A,   667,  220 },
+			{ 0xA8D9D1535CE3B396,   694,  228 },
+			{ 0xFB9B7CD9A4A7443C,   720,  236 },
+			{ 0xBB764C4CA7A44410,   747,  244 },
+			{ 0x8BAB8EEFB6409C1A,   774,  252 },
+			{ 0xD01FEF10A657842C,   800,  260 },
+			{ 0x9B10A4E5E9913129,   827,  268 },
+			{ 0xE7109BFBA19C0C9D,   853,  276 },
+			{ 0xAC2820D9623BF429,   880,  284 },
+			{ 0x80444B5E7AA7CF85,   907,  292 },
+			{ 0xBF21E44003ACDD2D,   933,  300 },
+			{ 0x8E679C2F5E44FF8F,   960,  308 },
+			{ 0xD433179D9C8CB841,   986,  316 },
+			{ 0x9E19DB92B4E31BA9,  1013,  324 },
+		};
+
+		// The range of binary exponents that digits are generated in,
+		// so that the integer part of a scaled value fits in 32 bits
+		const int min_scaled_exponent = -60;
+
+		/**
+		 * Returns a cached power of ten that scales a DiyFp with the
+		 * binary exponent e to have an exponent in [-60, -32].
+		 */
+		const CachedPower &get_cached_power(const int e)
+		{
+			// k = ceil((min_scaled_exponent - e - 1) * log10(2))
+			const int f = min_scaled_exponent - e - 1;
+			const int k = (f * 78913) / (1 << 18) + (f > 0 ? 1 : 0);
+			return cached_powers[(300 + k + 7) / 8];
+		}
+
+		/**
+		 * Returns the number of decimal digits in n, and sets pow10 to
+		 * 10^(digits - 1).
+		 */
+		int find_largest_pow10(const uint32_t n, uint32_t &pow10)
+		{
+			int digits = 1;
+			pow10 = 1;
+			while (digits < 10 && n / 10 >= pow10)
+			{
+				pow10 *= 10;
+				digits++;
+			}
+			return digits;
+		}
+
+		/**
+		 * Moves the last digit generated towards w while the result is
+		 * still inside the rounding interval, as long as that brings it
+		 * closer to w.
+		 */
+		void round_digits(char *digits, const int length, const uint64_t distance,
+			const uint64_t delta, uint64_t rest, const uint64_t ten_k)
+		{
+			while (rest < distance && delta - rest >= ten_k &&
+				(rest + ten_k < distance || distance - rest > rest + ten_k - distance))
+			{
+				digits[length - 1]--;
+				rest += ten_k;
+			}
+		}
+
+		/**
+		 * Generates the shortest digits of a number inside the interval
+		 * (low, high) that are closest to w, where all three have already
+		 * been scaled by a cached power of ten.
+		 */
+		void generate_digits(char *digits, int &length, int &decimal_exponent,
+			const DiyFp low, const DiyFp w, const DiyFp high)
+		{
+			uint64_t delta = high.f - low.f;
+			uint64_t distance = high.f - w.f;
+
+			// Split high into its integer and fractional parts
+			const int shift = -high.e;
+			const uint64_t one = uint64_t(1) << shift;
+			uint32_t integer_part = static_cast<uint32_t>(high.f >> shift);
+			uint64_t fractional_part = high.f & (one - 1);
+
+			uint32_t pow10;
+			int remaining = find_largest_pow10(integer_part, pow10);
+			while (remaining > 0)
+			{
+				digits[length++] = static_cast<char>('0' + integer_part / pow10);
+				integer_part %= pow10;
+				remaining--;
+
+				const uint64_t rest = (static_cast<uint64_t>(integer_part) << shift) + fractional_part;
+				if (rest <= delta)
+				{
+					decimal_exponent += remaining;
+					round_digits(digits, length, distance, delta, rest,
+						static_cast<uint64_t>(pow10) << shift);
+					return;
+				}
+				pow10 /= 10;
+			}
+
+			// delta is at least 2^-shift scaled, so this ends before the
+			// digits can overflow
+			int fractional_digits = 0;
+			while (true)
+			{
+				fractional_part *= 10;
+				digits[length++] = static_cast<char>('0' + (fractional_part >> shift));
+				fractional_part &= one - 1;
+				fractional_digits++;
+
+				delta *= 10;
+				distance *= 10;
+				if (fractional_part <= delta)
+					break;
+			}
+
+			decimal_exponent -= fractional_digits;
+			round_digits(digits, length, distance, delta, fractional_part, one);
+		}
+
+		/**
+		 * Finds the shortest digits that parse back to a positive, finite
+		 * value, such that the value is digits * 10^decimal_exponent.
+		 * 
+		 * Grisu2 finds the shortest digits for nearly every value, and a
+		 * few digits more than needed for the rest.
+		 */
+		template <typename FloatT>
+		void find_shortest_digits(const FloatT value, char *digits, int &length, int &decimal_exponent)
+		{
+			typedef typename FloatTraits<FloatT>::BitsT BitsT;
+			const int precision = std::numeric_limits<FloatT>::digits;
+			const int bias = std::numeric_limits<FloatT>::max_exponent - 1 + (precision - 1);
+			const BitsT hidden_bit = BitsT(1) << (precision - 1);
+
+			// Split the value into its significand and exponent
+			const BitsT bits = get_bits(value);
+			const int biased_exponent = static_cast<int>(bits >> (precision - 1));
+			const BitsT fraction = bits & (hidden_bit - 1);
+			const DiyFp v = biased_exponent == 0
+				? make_diy_fp(fraction, 1 - bias)
+				: make_diy_fp(fraction + hidden_bit, biased_exponent - bias);
+
+			// Every number between the midpoints with the neighbouring
+			// values parses back to this value. The lower neighbour is
+			// closer when the value is a power of two.
+			const bool lower_is_closer = fraction == 0 && biased_exponent > 1;
+			const DiyFp high = normalize(make_diy_fp(2 * v.f + 1, v.e - 1));
+			DiyFp low = lower_is_closer
+				? make_diy_fp(4 * v.f - 1, v.e - 2)
+				: make_diy_fp(2 * v.f - 1, v.e - 1);
+			low = make_diy_fp(low.f << (low.e - high.e), high.e);
+			const DiyFp w = normalize(v);
+
+			// Scale everything so that the binary exponent is small
+			const auto &cached = get_cached_power(high.e);
+			const DiyFp power = make_diy_fp(cached.f, cached.e);
+			const DiyFp scaled_w = multiply(w, power);
+			DiyFp scaled_low = multiply(low, power);
+			DiyFp scaled_high = multiply(high, power);
+
+			// Leave room for the error from scaling
+			scaled_low.f++;
+			scaled_high.f--;
+
+			length = 0;
+			decimal_exponent = -cached.k;
+			generate_digits(digits, length, decimal_exponent, scaled_low, scaled_w, scaled_high);
+		}
+
+		/**
+		 * Appends digits * 10^decimal_exponent in the same format as %g,
+		 * with enough precision to write every digit.
+		 */
+		void append_digits(std::string &buffer, const char *digits, int length,
+			int decimal_exponent, const int min_precision)
+		{
+			while (length > 1 && digits[length - 1] == '0')
+			{
+				length--;
+				decimal_exponent++;
+			}
+
+			char text[40];
+			char *output = text;
+			const int exponent = length + decimal_exponent - 1;
+			if (exponent < -4 || exponent >= std::max(length, min_precision))
+			{
+				*output++ = digits[0];
+				if (length > 1)
+				{
+					*output++ = '.';
+					output = std::copy(digits + 1, digits + length, output);
+				}
+
+				*output++ = 'e';
+				*output++ = exponent < 0 ? '-' : '+';
+				const int magnitude = exponent < 0 ? -exponent : exponent;
+				if (magnitude >= 100)
+					*output++ = static_cast<char>('0' + magnitude / 100);
+				*output++ = static_cast<char>('0' + magnitude / 10 % 10);
+				*output++ = static_cast<char>('0' + magnitude % 10);
+			}
+			else if (exponent >= 0)
+			{
+				const int integer_length = exponent + 1;
+				if (length <= integer_length)
+				{
+					output = std::copy(digits, digits + length, output);
+					output = std::fill_n(output, integer_length - length, '0');
+				}
+				else
+				{
+					output = std::copy(digits, digits + integer_length, output);
+					*output++ = '.';
+					output = std::copy(digits + integer_length, digits + length, output);
+				}
+			}
+			else
+			{
+				*output++ = '0';
+				*output++ = '.';
+				output = std::fill_n(output, -exponent - 1, '0');
+				output = std::copy(digits, digits + length, output);
+			}
+			buffer.append(text, output);
+		}
+
+		template <typename FloatT>
+		void append_float(std::string &buffer, FloatT value)
+		{
+			const int min_precision = FloatTraits<FloatT>::min_precision;
+			if (value != value)
+			{
+				buffer.append("nan");
+				return;
+			}
+
+			// Whole numbers are common, and much cheaper to format as
+			// integers. Below 10^min_precision, %g wouldn't use an
+			// exponent for them either, so the output is the same.
+			if (value == std::floor(value) && std::fabs(value) < exact_powers_of_ten[min_precision] &&
+				!(value == 0 && std::signbit(value)))
+			{
+				append_number(buffer, static_cast<int64_t>(value));
+				return;
+			}
+
+			if (std::signbit(value))
+			{
+				buffer.push_back('-');
+				value = -value;
+			}
+			if (value == 0)
+			{
+				buffer.push_back('0');
+				return;
+			}
+			if (std::isinf(value))
+			{
+				buffer.append("inf");
+				return;
+			}
+
+			char digits[32];
+			int length;
+			int decimal_exponent;
+			find_shortest_digits(value, digits, length, decimal_exponent);
+			append_digits(buffer, digits, length, decimal_exponent, min_precision);
+		}
+
+		/**
+		 * An unsigned integer of any size, for comparing a decimal
+		 * number with a binary one exactly.
+		 */
+		class BigInteger
+		{
+		public:
+			explicit BigInteger(const uint64_t value)
+			{
+				m_words.push_back(static_cast<uint32_t>(value));
+				if (value >> 32)
+					m_words.push_back(static_cast<uint32_t>(value >> 32));
+			}
+
+			BigInteger(const char *digits, const size_t length)
+			{
+				m_words.push_back(0);
+				for (size_t i = 0; i < length; ++i)
+					multiply_add(10, digits[i] - '0');
+			}
+
+			void multiply_add(const uint32_t factor, uint32_t addend)
+			{
+				uint64_t carry = addend;
+				for (auto it = m_words.begin(); it != m_words.end(); ++it)
+				{
+					carry += static_cast<uint64_t>(*it) * factor;
+					*it = static_cast<uint32_t>(carry);
+					carry >>= 32;
+				}
+				if (carry)
+					m_words.push_back(static_cast<uint32_t>(carry));
+			}
+
+			void multiply_pow10(int exponent)
+			{
+				for (; exponent >= 9; exponent -= 9)
+					multiply_add(1000000000, 0);
+				if (exponent > 0)
+					multiply_add(static_cast<uint32_t>(exact_powers_of_ten[exponent]), 0);
+			}
+
+			void shift_left(const int bits)
+			{
+				const int word_shift = bits / 32;
+				const int bit_shift = bits % 32;
+				if (bit_shift)
+				{
+					uint32_t carry = 0;
+					for (auto it = m_words.begin(); it != m_words.end(); ++it)
+					{
+						const uint32_t word = *it;
+						*it = (word << bit_shift) | carry;
+						carry = word >> (32 - bit_shift);
+					}
+					if (carry)
+						m_words.push_back(carry);
+				}
+				m_words.insert(m_words.begin(), word_shift, 0);
+			}
+
+			int compare(const BigInteger &other) const
+			{
+				if (m_words.size() != other.m_words.size())
+					return m_words.size() < other.m_words.size() ? -1 : 1;
+				for (size_t i = m_words.size(); i-- > 0;)
+				{
+					if (m_words[i] != other.m_words[i])
+						return m_words[i] < other.m_words[i] ? -1 : 1;
+				}
+				return 0;
+			}
+		private:
+			// Least significant first, without leading zero words
+			std::vector<uint32_t> m_words;
+		};
+
+		/**
+		 * Compares digits * 10^decimal_exponent with the midpoint between
+		 * a non-negative, finite value and the next value up.
+		 */
+		template <typename FloatT>
+		int compare_with_midpoint(const BigInteger &digits, const int decimal_exponent,
+			const FloatT value)
+		{
+			// value = significand * 2^binary_exponent, where the exponent
+			// is that of the smallest subnormal if the value is subnormal
+			const int min_exponent = std::numeric_limits<FloatT>::min_exponent -
+				std::numeric_limits<FloatT>::digits;
+			int binary_exponent = min_exponent;
+			if (value != 0)
+			{
+				std::frexp(value, &binary_exponent);
+				binary_exponent = std::max(binary_exponent - std::numeric_limits<FloatT>::digits,
+					min_exponent);
+			}
+			const uint64_t significand = static_cast<uint64_t>(std::ldexp(value, -binary_exponent));
+
+			// The midpoint is (2 * significand + 1) * 2^(binary_exponent - 1),
+			// so scale both sides until they're integers
+			BigInteger decimal = digits;
+			BigInteger midpoint(2 * significand + 1);
+			if (decimal_exponent >= 0)
+				decimal.multiply_pow10(decimal_exponent);
+			else
+				midpoint.multiply_pow10(-decimal_exponent);
+			if (binary_exponent - 1 >= 0)
+				midpoint.shift_left(binary_exponent - 1);
+			else
+				decimal.shift_left(1 - binary_exponent);
+			return decimal.compare(midpoint);
+		}
+
+		/**
+		 * Rounds digits * 10^decimal_exponent to the nearest value,
+		 * starting from an approximation that is a few values away.
+		 * Ties go to the value with an even significand.
+		 */
+		template <typename FloatT>
+		FloatT round_exactly(const char *digits, const size_t length, const int decimal_exponent,
+			FloatT value)
+		{
+			const FloatT infinity = std::numeric_limits<FloatT>::infinity();
+			const BigInteger exact(digits, length);
+			while (true)
+			{
+				const bool odd = (get_bits(value) & 1) != 0;
+				const int above = compare_with_midpoint(exact, decimal_exponent, value);
+				if (above > 0 || (above == 0 && odd))
+				{
+					value = std::nextafter(value, infinity);
+					if (value == infinity)
+						return value;
+					continue;
+				}
+
+				if (value == 0)
+					return value;
+				const FloatT lower = std::nextafter(value, FloatT(0));
+				const int below = compare_with_midpoint(exact, decimal_exponent, lower);
+				if (below < 0 || (below == 0 && odd))
+				{
+					value = lower;
+					continue;
+				}
+				return value;
+			}
+		}
+
+		/**
+		 * Compares a range with a lowercase word, ignoring case.
+		 */
+		bool equals_word(const char *begin, const char *end, const char *word)
+		{
+			for (; begin != end; ++begin, ++word)
+			{
+				const char c = *begin >= 'A' && *begin <= 'Z' ? *begin - 'A' + 'a' : *begin;
+				if (*word == '\0' || c != *word)
+					return false;
+			}
+			return *word == '\0';
+		}
+
+		template <typename FloatT>
+		bool parse_float(const char *begin, const char *end, FloatT &value)
+		{
+			typedef FloatTraits<FloatT> Traits;
+			trim_whitespace(begin, end);
+			if (begin == end || static_cast<size_t>(end - begin) >= max_number_length)
+				return false;
+
+			bool negative = false;
+			if (*begin == '-' || *begin == '+')
+			{
+				negative = *begin == '-';
+				++begin;
+			}
+
+			if (equals_word(begin, end, "inf") || equals_word(begin, end, "infinity"))
+			{
+				value = negative ? -std::numeric_limits<FloatT>::infinity()
+					: std::numeric_limits<FloatT>::infinity();
+				return true;
+			}
+			if (equals_word(begin, end, "nan"))
+			{
+				value = negative ? -std::numeric_limits<FloatT>::quiet_NaN()
+					: std::numeric_limits<FloatT>::quiet_NaN();
+				return true;
+			}
+
+			// Read the significant digits, so that the number is
+			// digits * 10^decimal_exponent
+			char digits[max_number_length];
+			size_t length = 0;
+			int decimal_exponent = 0;
+			bool any_digits = false;
+			bool fraction = false;
+			for (; begin != end; ++begin)
+			{
+				if (*begin == '.' && !fraction)
+				{
+					fraction = true;
+					continue;
+				}
+				if (*begin < '0' || *begin > '9')
+					break;
+
+				any_digits = true;
+				if (fraction)
+					decimal_exponent--;
+				if (length != 0 || *begin != '0')
+					digits[length++] = *begin;
+			}
+			if (!any_digits)
+				return false;
+
+			if (begin != end)
+			{
+				if (*begin != 'e' && *begin != 'E')
+					return false;
+				++begin;
+
+				bool negative_exponent = false;
+				if (begin != end && (*begin == '-' || *begin == '+'))
+				{
+					negative_exponent = *begin == '-';
+					++begin;
+				}
+				if (begin == end)
+					return false;
+
+				// Anything this large is out of range either way
+				int exponent = 0;
+				for (; begin != end; ++begin)
+				{
+					if (*begin < '0' || *begin > '9')
+						return false;
+					exponent = std::min(exponent * 10 + (*begin - '0'), 100000);
+				}
+				decimal_exponent += negative_exponent ? -exponent : exponent;
+			}
+
+			while (length != 0 && digits[length - 1] == '0')
+			{
+				length--;
+				decimal_exponent++;
+			}
+
+			// The number is in [10^(magnitude - 1), 10^magnitude)
+			const int magnitude = static_cast<int>(length) + decimal_exponent;
+			FloatT result;
+			if (length == 0 || magnitude <= Traits::min_magnitude)
+				result = 0;
+			else if (magnitude >= Traits::max_magnitude)
+				result = std::numeric_limits<FloatT>::infinity();
+			else
+			{
+				uint64_t significand = 0;
+				const size_t significand_length = std::min(length, size_t(19));
+				for (size_t i = 0; i < significand_length; ++i)
+					significand = significand * 10 + (digits[i] - '0');
+
+				// Both the digits and the power of ten are exact, so the
+				// result is correctly rounded
+				if (length == significand_length && significand <= Traits::fast_path_max_digits &&
+					decimal_exponent >= -Traits::fast_path_max_exponent &&
+					decimal_exponent <= Traits::fast_path_max_exponent)
+				{
+					result = static_cast<FloatT>(significand);
+					if (decimal_exponent < 0)
+						result /= static_cast<FloatT>(exact_powers_of_ten[-decimal_exponent]);
+					else
+						result *= static_cast<FloatT>(exact_powers_of_ten[decimal_exponent]);
+				}
+				else
+				{
+					// Otherwise, start from a close approximation, split in
+					// two so that small numbers don't underflow early
+					const int exponent = decimal_exponent + static_cast<int>(length - significand_length);
+					double approximation = static_cast<double>(significand);
+					if (exponent < -300)
+					{
+						approximation *= std::pow(10.0, exponent + 300);
+						approximation *= 1e-300;
+					}
+					else
+						approximation *= std::pow(10.0, exponent);
+
+					result = static_cast<FloatT>(std::min(approximation,
+						static_cast<double>(std::numeric_limits<FloatT>::max())));
+					result = round_exactly(digits, length, decimal_exponent, result);
+				}
+			}
+
+			value = negative ? -result : result;
+			return true;
+		}
+	}
+
+	void append_number(std::string &buffer, const float value)
+	{
+		append_float(buffer, value);
+	}
+
+	void append_number(std::string &buffer, const double value)
+	{
+		append_float(buffer, value);
+	}
+
+	bool parse_number(const char *begin, const char *end, float &value)
+	{
+		return parse_float(begin, end, value);
+	}
+
+	bool parse_number(const char *begin, const char *end, double &value)
+	{
+		return parse_float(begin, end, value);
+	}
+
+	void escape_xml(std::string &buffer, const size_t position)
+	{
+		// Most values have nothing to escape, so don't copy them
+		const char *special_characters = "&<>\"";
+		size_t found = buffer.find_first_of(special_characters, position);
+		if (found == std::string::npos)
+			return;
+
+		std::string escaped;
+		escaped.reserve(buffer.size() - found + 16);
+		for (auto it = buffer.begin() + found; it != buffer.end(); ++it)
+		{
+			switch (*it)
+			{
+			case '&':
+				escaped.append("&amp;");
+				break;
+			case '<':
+				escaped.append("&lt;");
+				break;
+			case '>':
+				escaped.append("&gt;");
+				break;
+			case '"':
+				escaped.append("&quot;");
+				break;
+			default:
+				escaped.push_back(*it);
+			}
+		}
+
+		buffer.resize(found);
+		buffer.append(escaped);
+	}
+}
+}
@@ -0,0 +1,237 @@
+#include "ki/util/Unicode.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KI_UNICODE_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KI_UNICODE_SSE2
+#endif
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		/**
+		 * Copies UTF-16 characters to UTF-8 until one is found that
+		 * is not ASCII, and returns the number copied.
+		 */
+		size_t copy_ascii(const char16_t *source, const size_t count, char *destination)
+		{
+			size_t i = 0;
+#ifdef KI_UNICODE_AVX2
+			const __m256i wide_mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+				if (!_mm256_testz_si256(units, wide_mask))
+					break;
+
+				// Packing works within each 128-bit lane, so pack the halves instead
+				const __m128i bytes = _mm_packus_epi16(
+					_mm256_castsi256_si128(units), _mm256_extracti128_si256(units, 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), bytes);
+			}
+#endif
+#ifdef KI_UNICODE_SSE2
+			const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, mask), zero)) != 0xFFFF)
+					break;
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(destination + i), _mm_packus_epi16(units, units));
+			}
+#endif
+			for (; i < count && source[i] < 0x80; ++i)
+				destination[i] = static_cast<char>(source[i]);
+			return i;
+		}
+
+		/**
+		 * Copies UTF-8 bytes to UTF-16 until one is found that
+		 * is not ASCII, and returns the number copied.
+		 */
+		size_t copy_ascii(const char *source, const size_t count, char16_t *destination)
+		{
+			size_t i = 0;
+#ifdef KI_UNICODE_AVX2
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+				if (_mm256_movemask_epi8(bytes) != 0)
+					break;
+
+				const __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+				const __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), low);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i + 16), high);
+			}
+#endif
+#ifdef KI_UNICODE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+				if (_mm_movemask_epi8(bytes) != 0)
+					break;
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_unpacklo_epi8(bytes, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i + 8), _mm_unpackhi_epi8(bytes, zero));
+			}
+#endif
+			for (; i < count && static_cast<uint8_t>(source[i]) < 0x80; ++i)
+				destination[i] = static_cast<char16_t>(source[i]);
+			return i;
+		}
+
+		/**
+		 * Encodes the non-ASCII character at position as UTF-8, consuming
+		 * its low surrogate too if it has one. Returns false if it is an
+		 * unpaired surrogate.
+		 */
+		bool encode_utf8(const char16_t *&position, const char16_t *end, char *&destination)
+		{
+			uint32_t code_point = *position++;
+			if (code_point < 0x800)
+			{
+				*destination++ = static_cast<char>(0xC0 | (code_point >> 6));
+				*destination++ = static_cast<char>(0x80 | (code_point & 0x3F));
+				return true;
+			}
+
+			if (code_point >= 0xD800 && code_point <= 0xDFFF)
+			{
+				if (code_point > 0xDBFF || position == end || *position < 0xDC00 || *position > 0xDFFF)
+					return false;
+				code_point = 0x10000 + ((code_point - 0xD800) << 10) + (*position++ - 0xDC00);
+
+				*destination++ = static_cast<char>(0xF0 | (code_point >> 18));
+				*destination++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+			}
+			else
+				*destination++ = static_cast<char>(0xE0 | (code_point >> 12));
+			*destination++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+			*destination++ = static_cast<char>(0x80 | (code_point & 0x3F));
+			return true;
+		}
+
+		/**
+		 * Decodes the non-ASCII UTF-8 sequence at position into one or
+		 * two UTF-16 code units. Returns false if it is not valid.
+		 */
+		bool decode_utf8(const uint8_t *&position, const uint8_t *end, char16_t *&destination)
+		{
+			const uint8_t lead = *position;
+			size_t length;
+			uint32_t code_point;
+			if (lead >= 0xC2 && lead <= 0xDF)
+			{
+				length = 2;
+				code_point = lead & 0x1F;
+			}
+			else if (lead >= 0xE0 && lead <= 0xEF)
+			{
+				length = 3;
+				code_point = lead & 0x0F;
+			}
+			else if (lead >= 0xF0 && lead <= 0xF4)
+			{
+				length = 4;
+				code_point = lead & 0x07;
+			}
+			else
+				return false;
+
+			if (static_cast<size_t>(end - position) < length)
+				return false;
+			for (size_t i = 1; i < length; ++i)
+			{
+				if ((position[i] & 0xC0) != 0x80)
+					return false;
+				code_point = (code_point << 6) | (position[i] & 0x3F);
+			}
+
+			// Two byte overlong forms were already rejected by their lead byte
+			if ((length == 3 && code_point < 0x800) || (length == 4 && code_point < 0x10000) ||
+				(code_point >= 0xD800 && code_point <= 0xDFFF) || code_point > 0x10FFFF)
+				return false;
+			position += length;
+
+			if (code_point < 0x10000)
+				*destination++ = static_cast<char16_t>(code_point);
+			else
+			{
+				code_point -= 0x10000;
+				*destination++ = static_cast<char16_t>(0xD800 + (code_point >> 10));
+				*destination++ = static_cast<char16_t>(0xDC00 + (code_point & 0x3FF));
+			}
+			return true;
+		}
+	}
+
+	bool append_utf8(std::string &buffer, const char16_t *begin, const char16_t *end)
+	{
+		// Each UTF-16 code unit needs at most 3 bytes,
+		// and a surrogate pair needs 4.
+		const size_t original_size = buffer.size();
+		buffer.resize(original_size + (end - begin) * 3);
+
+		char *destination = &buffer[0] + original_size;
+		const char16_t *position = begin;
+		while (position != end)
+		{
+			const size_t count = copy_ascii(position, end - position, destination);
+			position += count;
+			destination += count;
+
+			while (position != end && *position >= 0x80)
+			{
+				if (!encode_utf8(position, end, destination))
+				{
+					buffer.resize(original_size);
+					return false;
+				}
+			}
+		}
+
+		buffer.resize(destination - &buffer[0]);
+		return true;
+	}
+
+	bool append_utf16(std::u16string &buffer, const char *begin, const char *end)
+	{
+		// Each UTF-8 byte produces at most one UTF-16 code unit
+		const size_t original_size = buffer.size();
+		buffer.resize(original_size + (end - begin));
+
+		char16_t *destination = &buffer[0] + original_size;
+		const uint8_t *position = reinterpret_cast<const uint8_t *>(begin);
+		const uint8_t *bytes_end = reinterpret_cast<const uint8_t *>(end);
+		while (position != bytes_end)
+		{
+			const size_t count = copy_ascii(reinterpret_cast<const char *>(position),
+				bytes_end - position, destination);
+			position += count;
+			destination += count;
+
+			while (position != bytes_end && *position >= 0x80)
+			{
+				if (!decode_utf8(position, bytes_end, destination))
+				{
+					buffer.resize(original_size);
+					return false;
+				}
+			}
+		}
+
+		buffer.resize(destination - &buffer[0]);
+		return true;
+	}
+}
+}
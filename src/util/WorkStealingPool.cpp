@@ -0,0 +1,153 @@
+#include "ki/util/WorkStealingPool.h"
+
+namespace ki
+{
+namespace util
+{
+	namespace
+	{
+		// Identifies the pool and worker that the current thread belongs to,
+		// so that tasks submitted from inside a task stay on the local queue.
+		thread_local const WorkStealingPool *t_current_pool = nullptr;
+		thread_local size_t t_current_index = 0;
+	}
+
+	WorkStealingPool::WorkStealingPool(size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::thread::hardware_concurrency();
+		if (thread_count == 0)
+			thread_count = 1;
+
+		m_next_worker = 0;
+		m_queued_tasks = 0;
+		m_pending_tasks = 0;
+		m_stopping = false;
+
+		for (size_t i = 0; i < thread_count; ++i)
+			m_workers.emplace_back(new Worker());
+		for (size_t i = 0; i < thread_count; ++i)
+			m_threads.emplace_back(&WorkStealingPool::run, this, i);
+	}
+
+	WorkStealingPool::~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_wake_mutex);
+			m_stopping = true;
+		}
+		m_wake_condition.notify_all();
+
+		for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+			it->join();
+	}
+
+	size_t WorkStealingPool::get_thread_count() const
+	{
+		return m_workers.size();
+	}
+
+	void WorkStealingPool::submit(Task task)
+	{
+		// Prefer the local queue when called from one of our own workers
+		size_t index;
+		if (t_current_pool == this)
+			index = t_current_index;
+		else
+			index = m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+		// Count the task as pending first, so that wait_idle can't
+		// return between the task being queued and it finishing.
+		m_pending_tasks.fetch_add(1);
+		{
+			auto &worker = *m_workers[index];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+		}
+
+		// Only count the task as queued once it can be found, so that a
+		// sleeping worker is never woken to an empty queue. This is done
+		// while holding the wake mutex so that a worker can't miss the
+		// notification between checking and waiting. A busy worker may
+		// already have taken the task, which leaves the count at zero.
+		{
+			std::lock_guard<std::mutex> lock(m_wake_mutex);
+			m_queued_tasks.fetch_add(1);
+		}
+		m_wake_condition.notify_one();
+	}
+
+	void WorkStealingPool::wait_idle()
+	{
+		std::unique_lock<std::mutex> lock(m_wake_mutex);
+		m_idle_condition.wait(lock, [this]()
+		{
+			return m_pending_tasks.load() == 0;
+		});
+	}
+
+	void WorkStealingPool::run(const size_t index)
+	{
+		t_current_pool = this;
+		t_current_index = index;
+
+		Task task;
+		while (true)
+		{
+			if (pop_task(index, task) || steal_task(index, task))
+			{
+				m_queued_tasks.fetch_sub(1);
+				task();
+				task = nullptr;
+
+				// Wake anyone waiting for the pool to become idle
+				if (m_pending_tasks.fetch_sub(1) == 1)
+				{
+					std::lock_guard<std::mutex> lock(m_wake_mutex);
+					m_idle_condition.notify_all();
+				}
+				continue;
+			}
+
+			// Nothing to do; sleep until there's more work or we're stopping
+			std::unique_lock<std::mutex> lock(m_wake_mutex);
+			m_wake_condition.wait(lock, [this]()
+			{
+				return m_stopping || m_queued_tasks.load() > 0;
+			});
+			if (m_stopping && m_queued_tasks.load() <= 0)
+				break;
+		}
+
+		t_current_pool = nullptr;
+	}
+
+	bool WorkStealingPool::pop_task(const size_t index, Task &task)
+	{
+		auto &worker = *m_workers[index];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty())
+			return false;
+
+		task = std::move(worker.tasks.back());
+		worker.tasks.pop_back();
+		return true;
+	}
+
+	bool WorkStealingPool::steal_task(const size_t index, Task &task)
+	{
+		for (size_t i = 1; i < m_workers.size(); ++i)
+		{
+			auto &victim = *m_workers[(index + i) % m_workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (victim.tasks.empty())
+				continue;
+
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+}
+}
@@ -1,7 +1,9 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 #include <ki/dml/Record.h>
+#include <cstring>
 #include <fstream>
+#include <limits>
 
 using namespace ki::dml;
 
@@ -39,6 +41,26 @@ TEST_CASE("Fields can be added to and retrieved from Records", "[dml]")
 		REQUIRE(record->get_field<SHRT>("TestField") == nullptr);
 	}
 
+	SECTION("Removing fields should remove them from the Record")
+	{
+		record->add_field<BYT>("TestField");
+		record->add_field<SHRT>("OtherField");
+		REQUIRE(record->remove_field("TestField"));
+		REQUIRE_FALSE(record->has_field("TestField"));
+		REQUIRE(record->get_field_count() == 1);
+		REQUIRE_FALSE(record->remove_field("TestField"));
+	}
+
+	SECTION("Fields can be iterated in the order they were added")
+	{
+		record->add_field<BYT>("TestField");
+		record->add_field<SHRT>("OtherField");
+		std::vector<std::string> names;
+		for (Record::const_iterator it = record->fields_begin(); it != record->fields_end(); ++it)
+			names.push_back((*it)->get_name());
+		REQUIRE(names == std::vector<std::string>{ "TestField", "OtherField" });
+	}
+
 	delete record;
 }
 
@@ -89,6 +111,20 @@ TEST_CASE("Field Serialization", "[dml]")
 		REQUIRE(ss.str() == "\xDD\xCC\xBB\xAA");
 	}
 
+	SECTION("Values whose lowest and highest bytes are equal")
+	{
+		// The byte order used to be guessed from the value itself,
+		// which swapped values like these.
+		record->add_field<INT>("TestInt")->set_value(768);
+		record->add_field<UINT>("TestUInt")->set_value(0x01020301);
+		record->add_field<GID>("TestGid")->set_value(0x100);
+		record->write_to(ss);
+		REQUIRE(ss.str() == std::string(
+			"\x00\x03\x00\x00"
+			"\x01\x03\x02\x01"
+			"\x00\x01\x00\x00\x00\x00\x00\x00", 16));
+	}
+
 	SECTION("STR Fields")
 	{
 		record->add_field<STR>("TestStr")->set_value("TEST");
@@ -245,6 +281,42 @@ TEST_CASE("Field Deserialization", "[dml]")
 		REQUIRE(field->get_value() == u"TEST");
 	}
 
+	SECTION("STR and WSTR values should survive a round trip")
+	{
+		auto *str_field = record->add_field<STR>("TestStr");
+		auto *wstr_field = record->add_field<WSTR>("TestWStr");
+		str_field->set_value("This string is too long for small string optimisation");
+		wstr_field->set_value(u"\u00C4pfel \U0001F34E");
+		record->write_to(ss);
+
+		// Reading replaces values of any length
+		Record read_record;
+		auto *read_str = read_record.add_field<STR>("TestStr");
+		auto *read_wstr = read_record.add_field<WSTR>("TestWStr");
+		read_str->set_value("Old");
+		read_wstr->set_value(u"A much longer old value than the new one");
+		read_record.read_from(ss);
+		REQUIRE(read_str->get_value() == str_field->get_value());
+		REQUIRE(read_wstr->get_value() == wstr_field->get_value());
+	}
+
+	SECTION("Short STR and WSTR reads should leave the value empty")
+	{
+		auto *str_field = record->add_field<STR>("TestStr");
+		str_field->set_value("Old");
+		ss.write("\x04\x00TE", 4);
+		ss.seekg(std::stringstream::beg);
+		REQUIRE_THROWS_AS(str_field->read_from(ss), parse_error);
+		REQUIRE(str_field->get_value().empty());
+
+		auto *wstr_field = record->add_field<WSTR>("TestWStr");
+		wstr_field->set_value(u"Old");
+		std::stringstream wide_ss;
+		wide_ss.write("\x04\x00T\x00E\x00", 6);
+		REQUIRE_THROWS_AS(wstr_field->read_from(wide_ss), parse_error);
+		REQUIRE(wstr_field->get_value().empty());
+	}
+
 	SECTION("FLT Fields")
 	{
 		ss.write("\x66\x66\x18\x43", 4);
@@ -352,3 +424,373 @@ TEST_CASE("Record Deserialization", "[dml]")
 
 	delete record;
 }
+
+TEST_CASE("Field Text Conversion", "[dml]")
+{
+	Record record;
+
+	SECTION("Integers are formatted and parsed exactly")
+	{
+		auto *field = record.add_field<INT>("TestInt");
+		field->set_value(-2147483647 - 1);
+		REQUIRE(field->get_value_string() == "-2147483648");
+		field->set_value_from_string(" 2147483647\n");
+		REQUIRE(field->get_value() == 2147483647);
+		REQUIRE_THROWS_AS(field->set_value_from_string("2147483648"), value_error);
+		REQUIRE_THROWS_AS(field->set_value_from_string("12abc"), value_error);
+
+		auto *gid_field = record.add_field<GID>("TestGid");
+		gid_field->set_value_from_string("18446744073709551615");
+		REQUIRE(gid_field->get_value() == 0xFFFFFFFFFFFFFFFF);
+		REQUIRE_THROWS_AS(gid_field->set_value_from_string("-1"), value_error);
+	}
+
+	SECTION("BYT and UBYT values are formatted as numbers")
+	{
+		auto *byt_field = record.add_field<BYT>("TestByt");
+		byt_field->set_value_from_string("255");
+		REQUIRE(byt_field->get_value() == -1);
+		REQUIRE(byt_field->get_value_string() == "-1");
+
+		auto *ubyt_field = record.add_field<UBYT>("TestUByt");
+		ubyt_field->set_value(200);
+		REQUIRE(ubyt_field->get_value_string() == "200");
+	}
+
+	SECTION("Floating point values round-trip exactly")
+	{
+		auto *flt_field = record.add_field<FLT>("TestFlt");
+		flt_field->set_value(152.4f);
+		REQUIRE(flt_field->get_value_string() == "152.4");
+		flt_field->set_value(35586.3125f);
+		REQUIRE(flt_field->get_value_string() == "35586.313");
+		flt_field->set_value(0.1f + 0.2f);
+		const auto flt_value = flt_field->get_value();
+		flt_field->set_value_from_string(flt_field->get_value_string());
+		REQUIRE(flt_field->get_value() == flt_value);
+
+		auto *dbl_field = record.add_field<DBL>("TestDbl");
+		dbl_field->set_value(0.1 + 0.2);
+		REQUIRE(dbl_field->get_value_string() == "0.30000000000000004");
+		dbl_field->set_value_from_string(dbl_field->get_value_string());
+		REQUIRE(dbl_field->get_value() == 0.1 + 0.2);
+		dbl_field->set_value_from_string("1e-300");
+		REQUIRE(dbl_field->get_value_string() == "1e-300");
+		dbl_field->set_value(-250.0);
+		REQUIRE(dbl_field->get_value_string() == "-250");
+		dbl_field->set_value(-0.0);
+		REQUIRE(dbl_field->get_value_string() == "-0");
+		dbl_field->set_value(1e15);
+		REQUIRE(dbl_field->get_value_string() == "1e+15");
+	}
+
+	SECTION("Every floating point value round-trips exactly")
+	{
+		// Bit patterns from a fixed xorshift sequence cover every
+		// exponent, including subnormals and infinities
+		uint64_t state = 0x9E3779B97F4A7C15;
+		for (int i = 0; i < 20000; ++i)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+
+			double dbl_value;
+			std::memcpy(&dbl_value, &state, sizeof(dbl_value));
+			float flt_value;
+			const auto flt_bits = static_cast<uint32_t>(state);
+			std::memcpy(&flt_value, &flt_bits, sizeof(flt_value));
+			if (dbl_value != dbl_value || flt_value != flt_value)
+				continue;
+
+			std::string text;
+			ki::util::append_number(text, dbl_value);
+			double dbl_parsed;
+			REQUIRE(ki::util::parse_number(text.data(), text.data() + text.size(), dbl_parsed));
+			REQUIRE(std::memcmp(&dbl_parsed, &dbl_value, sizeof(dbl_value)) == 0);
+
+			text.clear();
+			ki::util::append_number(text, flt_value);
+			float flt_parsed;
+			REQUIRE(ki::util::parse_number(text.data(), text.data() + text.size(), flt_parsed));
+			REQUIRE(std::memcmp(&flt_parsed, &flt_value, sizeof(flt_value)) == 0);
+		}
+	}
+
+	SECTION("Floating point values are parsed with correct rounding")
+	{
+		auto *dbl_field = record.add_field<DBL>("TestDbl");
+		dbl_field->set_value_from_string("9007199254740993");
+		REQUIRE(dbl_field->get_value() == 9007199254740992.0);
+		dbl_field->set_value_from_string("2.4703282292062328e-324");
+		REQUIRE(dbl_field->get_value() == std::numeric_limits<double>::denorm_min());
+		dbl_field->set_value_from_string("2.4703282292062327e-324");
+		REQUIRE(dbl_field->get_value() == 0);
+		dbl_field->set_value_from_string("1.7976931348623158e308");
+		REQUIRE(dbl_field->get_value() == std::numeric_limits<double>::max());
+		dbl_field->set_value_from_string("1.7976931348623159e308");
+		REQUIRE(dbl_field->get_value() == std::numeric_limits<double>::infinity());
+		dbl_field->set_value_from_string("-Infinity");
+		REQUIRE(dbl_field->get_value() == -std::numeric_limits<double>::infinity());
+		REQUIRE_THROWS_AS(dbl_field->set_value_from_string("1,5"), value_error);
+		REQUIRE_THROWS_AS(dbl_field->set_value_from_string("1e"), value_error);
+
+		auto *flt_field = record.add_field<FLT>("TestFlt");
+		flt_field->set_value_from_string("16777217");
+		REQUIRE(flt_field->get_value() == 16777216.0f);
+		flt_field->set_value_from_string("3.4028236e38");
+		REQUIRE(flt_field->get_value() == std::numeric_limits<float>::infinity());
+		flt_field->set_value_from_string("1e-45");
+		REQUIRE(flt_field->get_value() == std::numeric_limits<float>::denorm_min());
+	}
+
+	SECTION("WSTR values are converted to and from UTF-8")
+	{
+		auto *field = record.add_field<WSTR>("TestWStr");
+
+		// Long enough runs of ASCII to take the vectorized path,
+		// broken up by 2, 3 and 4 byte characters.
+		const std::u16string value = u"The quick brown fox jumps over the lazy dog. "
+			u"Café 你好 \U0001F600 and the rest of the sentence is ASCII again.";
+		const std::string utf8 = u8"The quick brown fox jumps over the lazy dog. "
+			u8"Café 你好 \U0001F600 and the rest of the sentence is ASCII again.";
+		field->set_value(value);
+		REQUIRE(field->get_value_string() == utf8);
+		field->set_value(u"");
+		field->set_value_from_string(utf8);
+		REQUIRE(field->get_value() == value);
+
+		// Invalid input should throw and leave the value alone
+		REQUIRE_THROWS_AS(field->set_value_from_string("Overlong \xC0\xAF slash"), value_error);
+		REQUIRE_THROWS_AS(field->set_value_from_string("Surrogate \xED\xA0\x80"), value_error);
+		REQUIRE_THROWS_AS(field->set_value_from_string("Truncated \xE4\xBD"), value_error);
+		REQUIRE_THROWS_AS(field->set_value_from_string("Too large \xF4\x90\x80\x80"), value_error);
+		REQUIRE(field->get_value() == value);
+
+		field->set_value(std::u16string(u"Unpaired ") + char16_t(0xD83D) + u" surrogate");
+		REQUIRE_THROWS_AS(field->get_value_string(), value_error);
+	}
+}
+
+TEST_CASE("Record Sizes", "[dml]")
+{
+	Record record;
+	record.add_field<INT>("TestInt");
+	record.add_field<GID>("TestGid");
+	record.add_field<BYT>("TestNOXFER", false);
+	REQUIRE(record.is_fixed_size());
+	REQUIRE(record.get_size() == 12);
+	REQUIRE(record.get_minimum_size() == 12);
+
+	auto *str_field = record.add_field<STR>("TestStr");
+	str_field->set_value("TEST");
+	REQUIRE_FALSE(record.is_fixed_size());
+	REQUIRE(record.get_size() == 18);
+	REQUIRE(record.get_minimum_size() == 14);
+
+	record.remove_field("TestGid");
+	REQUIRE(record.get_size() == 10);
+	REQUIRE(record.get_minimum_size() == 6);
+}
+
+TEST_CASE("Record Fingerprints", "[dml]")
+{
+	Record record;
+	record.add_field<INT>("TestInt")->set_value(1);
+	record.add_field<STR>("TestStr", false);
+
+	// The layout is hashed with FNV-1a, which is the same everywhere
+	const auto fingerprint = record.get_fingerprint();
+	REQUIRE(fingerprint == 0xB0C12D67588CB80Cull);
+
+	SECTION("Values are not part of the fingerprint")
+	{
+		record.get_field<INT>("TestInt")->set_value(2);
+		record.get_field<STR>("TestStr")->set_value("TEST");
+		REQUIRE(record.get_fingerprint() == fingerprint);
+	}
+
+	SECTION("Names, types, order and transferability are")
+	{
+		Record renamed;
+		renamed.add_field<INT>("TestInt2");
+		renamed.add_field<STR>("TestStr", false);
+		REQUIRE(renamed.get_fingerprint() != fingerprint);
+
+		Record retyped;
+		retyped.add_field<UINT>("TestInt");
+		retyped.add_field<STR>("TestStr", false);
+		REQUIRE(retyped.get_fingerprint() != fingerprint);
+
+		Record reordered;
+		reordered.add_field<STR>("TestStr", false);
+		reordered.add_field<INT>("TestInt");
+		REQUIRE(reordered.get_fingerprint() != fingerprint);
+
+		Record transferable;
+		transferable.add_field<INT>("TestInt");
+		transferable.add_field<STR>("TestStr");
+		REQUIRE(transferable.get_fingerprint() != fingerprint);
+	}
+}
+
+/**
+ * Holds a Record, and counts how many times instances of it are destroyed.
+ */
+struct CountedRecord
+{
+	Record record;
+	int &destroyed;
+
+	CountedRecord(const Record &other, ki::util::Arena *arena, int &destroyed)
+		: record(other, arena), destroyed(destroyed) {}
+
+	~CountedRecord()
+	{
+		destroyed++;
+	}
+};
+
+TEST_CASE("Arena Records", "[dml]")
+{
+	ki::util::Arena arena(256);
+	Record record;
+	record.add_field<INT>("TestInt")->set_value(0x01020304);
+	record.add_field<STR>("TestStr")->set_value("This string is too long for small string optimisation");
+
+	SECTION("Copying a record into an arena should copy every field")
+	{
+		auto *copy = arena.create<Record>(record, &arena);
+		REQUIRE(copy->get_arena() == &arena);
+		REQUIRE(copy->get_field_count() == 2);
+		REQUIRE(copy->get_field<INT>("TestInt")->get_value() == 0x01020304);
+		REQUIRE(copy->get_field<STR>("TestStr")->get_value() ==
+			record.get_field<STR>("TestStr")->get_value());
+		REQUIRE(arena.get_bytes_used() > 0);
+	}
+
+	SECTION("Resetting an arena should destroy records created inside it")
+	{
+		int destroyed = 0;
+		for (int i = 0; i < 100; ++i)
+			arena.create<CountedRecord>(record, &arena, destroyed)->record.add_field<DBL>("TestDbl");
+
+		// Objects created without collection are left to their owner
+		auto *uncollected = arena.create_uncollected<CountedRecord>(record, &arena, destroyed);
+		uncollected->~CountedRecord();
+		REQUIRE(destroyed == 1);
+
+		arena.reset();
+		REQUIRE(destroyed == 101);
+		REQUIRE(arena.get_bytes_used() == 0);
+	}
+}
+
+TEST_CASE("Record Move Semantics", "[dml]")
+{
+	Record record;
+	record.add_field<INT>("TestInt")->set_value(0x01020304);
+	auto *str_field = record.add_field<STR>("TestStr");
+	str_field->set_value("This string is too long for small string optimisation");
+
+	SECTION("Moving a record should transfer its fields")
+	{
+		Record moved(std::move(record));
+		REQUIRE(record.get_field_count() == 0);
+		REQUIRE(moved.get_field_count() == 2);
+		REQUIRE(moved.get_field<STR>("TestStr") == str_field);
+	}
+
+	SECTION("Assigning a record should replace its fields")
+	{
+		Record copy;
+		copy.add_field<DBL>("TestDbl");
+		copy = record;
+		REQUIRE(copy.get_field_count() == 2);
+		REQUIRE_FALSE(copy.has_field("TestDbl"));
+		REQUIRE(copy.get_field<STR>("TestStr") != str_field);
+
+		Record moved;
+		moved = std::move(copy);
+		REQUIRE(copy.get_field_count() == 0);
+		REQUIRE(moved.get_field<INT>("TestInt")->get_value() == 0x01020304);
+	}
+
+	SECTION("Move-assigning between arenas should copy the fields")
+	{
+		ki::util::Arena arena(256);
+		Record arena_record(&arena);
+		arena_record = std::move(record);
+		REQUIRE(arena_record.get_field_count() == 2);
+		REQUIRE(arena_record.get_field<STR>("TestStr") != str_field);
+		REQUIRE(record.get_field_count() == 2);
+	}
+}
+
+TEST_CASE("Record XML Writing", "[dml]")
+{
+	Record record;
+	record.add_field<INT>("TestInt")->set_value(-5);
+	record.add_field<STR>("TestStr")->set_value("<a & \"b\">");
+	record.add_field<WSTR>("TestWStr")->set_value(u"Caf\u00E9");
+	record.add_field<UBYT>("TestNOXFER", false)->set_value(1);
+
+	std::string buffer;
+	record.write_xml(buffer);
+	REQUIRE(buffer ==
+		"<RECORD>"
+		"<TestInt TYPE=\"INT\">-5</TestInt>"
+		"<TestStr TYPE=\"STR\">&lt;a &amp; &quot;b&quot;&gt;</TestStr>"
+		"<TestWStr TYPE=\"WSTR\">Caf\xC3\xA9</TestWStr>"
+		"<TestNOXFER TYPE=\"UBYT\" NOXFER=\"TRUE\">1</TestNOXFER>"
+		"</RECORD>");
+
+	// The output should load back into an identical record
+	rapidxml::xml_document<> doc;
+	doc.parse<0>(&buffer[0]);
+	Record loaded;
+	loaded.from_xml(doc.first_node());
+	REQUIRE(loaded.get_field_count() == 4);
+	REQUIRE(loaded.get_field<STR>("TestStr")->get_value() == "<a & \"b\">");
+	REQUIRE(loaded.get_field<WSTR>("TestWStr")->get_value() == u"Caf\u00E9");
+	REQUIRE_FALSE(loaded.get_field<UBYT>("TestNOXFER")->is_transferable());
+}
+
+// Allocations are only counted when built with KI_ALLOCATION_STATS
+#ifdef KI_ALLOCATION_STATS
+TEST_CASE("Allocation Tracking", "[dml]")
+{
+	using namespace ki::util;
+	REQUIRE(is_allocation_tracking_enabled());
+
+	reset_allocation_stats();
+	auto *record = new Record();
+	record->add_field<INT>("TestInt");
+	record->add_field<STR>("TestStr");
+	delete record;
+
+	const auto stats = get_allocation_stats();
+	// The Record itself, and the storage for its field list and name map
+	REQUIRE(stats.get(AllocationCategory::RECORD).allocations >= 1);
+	REQUIRE(stats.get(AllocationCategory::RECORD).allocations ==
+		stats.get(AllocationCategory::RECORD).deallocations);
+	REQUIRE(stats.get(AllocationCategory::RECORD).bytes_allocated ==
+		stats.get(AllocationCategory::RECORD).bytes_deallocated);
+	REQUIRE(stats.get(AllocationCategory::FIELD).allocations == 2);
+	REQUIRE(stats.get(AllocationCategory::FIELD).bytes_allocated ==
+		stats.get(AllocationCategory::FIELD).bytes_deallocated);
+}
+#else
+TEST_CASE("Allocation Tracking", "[dml]")
+{
+	using namespace ki::util;
+	REQUIRE_FALSE(is_allocation_tracking_enabled());
+
+	reset_allocation_stats();
+	auto *record = new Record();
+	record->add_field<INT>("TestInt");
+	delete record;
+	REQUIRE(get_allocation_stats().get(AllocationCategory::FIELD).allocations == 0);
+	REQUIRE(get_allocation_stats().get(AllocationCategory::RECORD).allocations == 0);
+}
+#endif
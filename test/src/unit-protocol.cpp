@@ -6,9 +6,70 @@
 #include <ki/protocol/control/SessionAccept.h>
 #include <ki/protocol/control/ClientKeepAlive.h>
 #include <ki/protocol/control/ServerKeepAlive.h>
+#include <ki/protocol/net/Capture.h>
+#include <ki/protocol/net/Session.h>
+#include <ki/protocol/net/DMLSession.h>
+#include <ki/protocol/net/DMLHandlerTable.h>
+#include <ki/protocol/dml/FingerprintTable.h>
+#include <ki/protocol/dml/MessageManager.h>
+#include <ki/protocol/dml/MessageColumns.h>
+#include <ki/protocol/dml/MessageModuleBuilder.h>
+#include <ki/protocol/exception.h>
+#include <ki/util/WorkStealingPool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 using namespace ki::protocol;
 
+/**
+ * A Session that records everything it writes, for
+ * testing the framing and queueing logic.
+ */
+class TestSession : public net::Session
+{
+public:
+	std::vector<std::string> writes;
+	net::SessionCloseErrorCode close_error = net::SessionCloseErrorCode::NONE;
+	int high_count = 0;
+	int low_count = 0;
+	int packets_received = 0;
+
+	bool is_alive() const override { return true; }
+
+	void receive(const char *data, const size_t size)
+	{
+		process_data(data, size);
+	}
+
+	void add_rtt_sample(const std::chrono::microseconds rtt)
+	{
+		m_counters.add_rtt_sample(rtt);
+	}
+protected:
+	void on_control_message(const net::PacketHeader &) override
+	{
+		packets_received++;
+	}
+
+	void send_packet_data(const char *data, const size_t size) override
+	{
+		writes.push_back(std::string(data, size));
+	}
+
+	void close(const net::SessionCloseErrorCode error) override
+	{
+		close_error = error;
+	}
+
+	void on_send_queue_high() override { high_count++; }
+	void on_send_queue_low() override { low_count++; }
+};
+
 TEST_CASE("Control Message Serialization", "[control]")
 {
 	std::ostringstream oss;
@@ -186,3 +247,1133 @@ TEST_CASE("Control Message Deserialization", "[control]")
 		REQUIRE(keep_alive.get_timestamp() == 0xAABBCCDD);
 	}
 }
+
+TEST_CASE("Work Stealing Pool", "[util]")
+{
+	ki::util::WorkStealingPool pool(4);
+	std::atomic<int> counter(0);
+
+	SECTION("Every submitted task is executed")
+	{
+		for (int i = 0; i < 1000; ++i)
+			pool.submit([&counter]() { counter++; });
+		pool.wait_idle();
+		REQUIRE(counter == 1000);
+	}
+
+	SECTION("Tasks submitted from inside a task are executed")
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			pool.submit([&pool, &counter]()
+			{
+				pool.submit([&counter]() { counter++; });
+				counter++;
+			});
+		}
+		pool.wait_idle();
+		REQUIRE(counter == 200);
+	}
+}
+
+/**
+ * A path in the system's temporary directory, for files that
+ * tests generate. The file is deleted when this goes out of scope.
+ */
+class TemporaryFile
+{
+public:
+	explicit TemporaryFile(const std::string &name)
+	{
+		const char *directory = std::getenv("TMPDIR");
+		if (!directory)
+			directory = std::getenv("TEMP");
+		m_path = std::string(directory ? directory : "/tmp") + "/ki-" + name;
+	}
+
+	~TemporaryFile()
+	{
+		std::remove(m_path.c_str());
+	}
+
+	TemporaryFile(const TemporaryFile &) = delete;
+	TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+	const std::string &get_path() const { return m_path; }
+private:
+	std::string m_path;
+};
+
+/**
+ * Loads a small DML module with the protocol type "TEST".
+ */
+void load_test_module(dml::MessageManager &manager)
+{
+	REQUIRE(manager.load_module("samples/test-module.xml"));
+}
+
+TEST_CASE("Message Template Metadata", "[dml]")
+{
+	auto *record = new ki::dml::Record();
+	record->add_field<ki::dml::STR>("_MsgHandler", false)->set_value("MSG_Handler");
+	record->add_field<ki::dml::UBYT>("_MsgAccessLvl", false)->set_value(2);
+	record->add_field<ki::dml::INT>("Value")->set_value(5);
+	record->add_field<ki::dml::STR>("_MsgTransferable")->set_value("Kept");
+	record->add_field<ki::dml::STR>("Secret", false)->set_value("Kept");
+	dml::MessageTemplate message_template("MSG_TEST", 1, 7, record);
+
+	SECTION("Metadata is read from the record")
+	{
+		REQUIRE(message_template.get_handler() == "MSG_Handler");
+		REQUIRE(message_template.get_access_level() == 2);
+		REQUIRE(&message_template.get_message_record() == &message_template.get_record());
+	}
+
+	SECTION("Metadata follows changes to the template")
+	{
+		message_template.set_handler("MSG_Other");
+		REQUIRE(message_template.get_handler() == "MSG_Other");
+		REQUIRE(message_template.get_record().get_field<ki::dml::STR>("_MsgHandler")->get_value() == "MSG_Other");
+
+		message_template.set_access_level(4);
+		REQUIRE(message_template.get_access_level() == 4);
+		REQUIRE(message_template.get_record().get_field<ki::dml::UBYT>("_MsgAccessLvl")->get_value() == 4);
+
+		// Without metadata, the handler is the template's name
+		message_template.set_record(new ki::dml::Record());
+		REQUIRE(message_template.get_handler() == "MSG_TEST");
+		REQUIRE(message_template.get_access_level() == 0);
+		delete record;
+
+		// An empty _MsgHandler is still the handler
+		message_template.set_handler("");
+		REQUIRE(message_template.get_handler().empty());
+	}
+
+	SECTION("Name and type are taken from the record")
+	{
+		auto *named_record = new ki::dml::Record();
+		named_record->add_field<ki::dml::STR>("_MsgName", false)->set_value("MSG_NAMED");
+		named_record->add_field<ki::dml::UBYT>("_MsgOrder", false)->set_value(9);
+		dml::MessageTemplate named_template("MSG_TEST", 1, 7, named_record);
+		REQUIRE(named_template.get_name() == "MSG_NAMED");
+		REQUIRE(named_template.get_type() == 9);
+		REQUIRE(named_template.get_handler() == "MSG_NAMED");
+	}
+
+	SECTION("Stripping only removes non-transferable metadata")
+	{
+		std::unique_ptr<dml::Message> original(message_template.create_message());
+		std::ostringstream original_data;
+		original->write_to(original_data);
+
+		message_template.set_metadata_stripped(true);
+		REQUIRE(message_template.is_metadata_stripped());
+		const auto &message_record = message_template.get_message_record();
+		REQUIRE(&message_record != &message_template.get_record());
+		REQUIRE(message_record.get_field_count() == 3);
+		REQUIRE_FALSE(message_record.has_field("_MsgHandler"));
+		REQUIRE_FALSE(message_record.has_field("_MsgAccessLvl"));
+		REQUIRE(message_record.get_field<ki::dml::INT>("Value")->get_value() == 5);
+		REQUIRE(message_record.get_field<ki::dml::STR>("_MsgTransferable")->get_value() == "Kept");
+		REQUIRE(message_record.get_field<ki::dml::STR>("Secret")->get_value() == "Kept");
+
+		// The metadata is still available, and messages look the same on the wire
+		REQUIRE(message_template.get_handler() == "MSG_Handler");
+		REQUIRE(message_template.get_access_level() == 2);
+		std::unique_ptr<dml::Message> stripped(message_template.create_message());
+		std::ostringstream stripped_data;
+		stripped->write_to(stripped_data);
+		REQUIRE(stripped_data.str() == original_data.str());
+		REQUIRE(stripped->get_size() == original->get_size());
+		REQUIRE(stripped->get_handler() == "MSG_Handler");
+
+		// Changing the metadata keeps the message record stripped
+		message_template.set_handler("MSG_Other");
+		REQUIRE_FALSE(message_template.get_message_record().has_field("_MsgHandler"));
+
+		message_template.set_metadata_stripped(false);
+		REQUIRE(&message_template.get_message_record() == &message_template.get_record());
+	}
+}
+
+TEST_CASE("DML Batch Decoding", "[dml]")
+{
+	dml::MessageManager manager;
+	load_test_module(manager);
+
+	// Alternate between runs of both message types
+	std::ostringstream oss;
+	const int message_count = 1000;
+	for (int i = 0; i < message_count; ++i)
+	{
+		auto *message = manager.create_message("TEST", (i / 10) % 2 ? "MSG_B" : "MSG_A");
+		if (message->get_record()->has_field<ki::dml::INT>("Value"))
+			message->get_record()->get_field<ki::dml::INT>("Value")->set_value(i);
+		else
+			message->get_record()->get_field<ki::dml::STR>("Name")->set_value(std::to_string(i));
+		message->write_to(oss);
+		delete message;
+	}
+	const auto data = oss.str();
+
+	SECTION("Every message is decoded in order")
+	{
+		ki::util::WorkStealingPool pool(4);
+		const auto messages = manager.decode_batch(data.data(), data.size(), &pool);
+		REQUIRE(messages.size() == message_count);
+		for (int i = 0; i < message_count; ++i)
+		{
+			const auto *record = messages[i]->get_record();
+			if ((i / 10) % 2)
+				REQUIRE(record->get_field<ki::dml::STR>("Name")->get_value() == std::to_string(i));
+			else
+				REQUIRE(record->get_field<ki::dml::INT>("Value")->get_value() == i);
+			delete messages[i];
+		}
+	}
+
+	SECTION("Truncated buffers are rejected")
+	{
+		REQUIRE_THROWS_AS(manager.decode_batch(data.data(), data.size() - 1), parse_error);
+	}
+}
+
+TEST_CASE("Message Columns", "[dml]")
+{
+	dml::MessageManager manager;
+	load_test_module(manager);
+	const auto *message_template = manager.get_module("TEST")->get_message_template("MSG_C");
+	dml::MessageColumns columns(*message_template);
+	REQUIRE(columns.get_column_count() == 4);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		auto *message = message_template->create_message();
+		auto *record = message->get_record();
+		record->get_field<ki::dml::GID>("Id")->set_value(0x8899AABBCCDDEEFF + i);
+		record->get_field<ki::dml::STR>("Name")->set_value(std::string(i, 'A'));
+		record->get_field<ki::dml::WSTR>("DisplayName")->set_value(u"Test");
+		record->get_field<ki::dml::SHRT>("Health")->set_value(-i);
+		columns.append(*message);
+		delete message;
+	}
+
+	SECTION("Values are stored column-wise")
+	{
+		const auto *id = columns.get_column("Id");
+		REQUIRE(id->data.size() == 24);
+		REQUIRE(id->get_value<ki::dml::GID>(2) == 0x8899AABBCCDDEEFF + 2);
+
+		const auto *name = columns.get_column("Name");
+		REQUIRE_FALSE(name->is_fixed_size());
+		REQUIRE(name->offsets == std::vector<uint32_t>({ 0, 0, 1, 3 }));
+		REQUIRE(name->get_string(2) == "AA");
+
+		const auto *display_name = columns.get_column("DisplayName");
+		REQUIRE(display_name->get_string(1) == std::string("T\0e\0s\0t\0", 8));
+		REQUIRE(columns.get_column("Health")->get_value<ki::dml::SHRT>(1) == -1);
+		REQUIRE(columns.get_column("_MsgHandler") == nullptr);
+	}
+
+	SECTION("Columns can be serialized and read back")
+	{
+		std::stringstream ss;
+		columns.write_to(ss);
+		REQUIRE(ss.str().size() == columns.get_size());
+
+		dml::MessageColumns read_columns;
+		read_columns.read_from(ss);
+		REQUIRE(read_columns.get_row_count() == 3);
+		REQUIRE(read_columns.get_column(3).type_name == "SHRT");
+		REQUIRE(read_columns.get_column("Name")->get_string(1) == "A");
+	}
+
+	SECTION("Messages from other templates are rejected")
+	{
+		auto *message = manager.create_message("TEST", "MSG_A");
+		REQUIRE_THROWS_AS(columns.append(*message), value_error);
+		REQUIRE(columns.get_row_count() == 3);
+		delete message;
+	}
+}
+
+TEST_CASE("Message Module XML Export", "[dml]")
+{
+	dml::MessageManager manager;
+	load_test_module(manager);
+	const auto *module = manager.get_module("TEST");
+	const TemporaryFile exported_file("module-export.xml");
+	{
+		std::ofstream ofs(exported_file.get_path());
+		module->write_xml(ofs);
+	}
+
+	dml::MessageManager exported_manager;
+	const auto *exported = exported_manager.load_module(exported_file.get_path());
+	REQUIRE(exported->get_service_id() == module->get_service_id());
+	REQUIRE(exported->get_protocol_type() == "TEST");
+	REQUIRE(std::distance(exported->templates_begin(), exported->templates_end()) == 3);
+
+	const auto *message_template = exported->get_message_template("MSG_C");
+	REQUIRE(message_template->get_type() == module->get_message_template("MSG_C")->get_type());
+	REQUIRE(message_template->get_handler() == "MSG_Test");
+	REQUIRE(message_template->get_record().get_size() ==
+		module->get_message_template("MSG_C")->get_record().get_size());
+}
+
+TEST_CASE("Message Module Loading", "[dml]")
+{
+	dml::MessageManager manager;
+
+	SECTION("Modules that end on a page boundary are loaded")
+	{
+		const auto *module = manager.load_module("samples/page-module.xml");
+		REQUIRE(module->get_service_id() == 9);
+		REQUIRE(module->get_protocol_desription() == "Fish & Chips <3");
+
+		const auto &record = module->get_message_template("MSG_A")->get_record();
+		REQUIRE(record.get_field_count() == 1);
+		REQUIRE(record.get_field<ki::dml::INT>("Value")->get_value() == -7);
+	}
+
+	SECTION("Templates can be loaded lazily")
+	{
+		// Both with and without a null terminator after the file
+		const char *filepaths[] = { "samples/lazy-module.xml", "samples/lazy-module-page.xml" };
+		for (const auto *filepath : filepaths)
+		{
+			dml::MessageManager lazy_manager;
+			lazy_manager.set_load_templates_lazily(true);
+			lazy_manager.set_strip_template_metadata(true);
+			const auto *module = lazy_manager.load_module(filepath);
+			REQUIRE(module->get_protocol_desription() == "Fish & Chips");
+
+			const auto *renamed = module->get_message_template(3);
+			REQUIRE(renamed->get_name() == "MSG_RENAMED");
+			REQUIRE(renamed->get_handler() == "Msg&Handler");
+			REQUIRE(renamed->get_access_level() == 3);
+			REQUIRE(!renamed->is_record_loaded());
+			REQUIRE(module->get_message_template("MSG_B")->get_type() == 1);
+			REQUIRE(module->get_message_template("MSG_C")->get_type() == 2);
+
+			// Every thread sees the same record, which is only built once
+			std::vector<const ki::dml::Record *> records(4);
+			std::vector<std::thread> threads;
+			for (size_t j = 0; j < records.size(); ++j)
+				threads.emplace_back([&records, renamed, j]()
+				{
+					records[j] = &renamed->get_record();
+				});
+			for (auto &thread : threads)
+				thread.join();
+			for (const auto *record : records)
+				REQUIRE(record == records[0]);
+			REQUIRE(renamed->is_record_loaded());
+			REQUIRE(records[0]->get_field<ki::dml::STR>("Text")->get_value() == "<RECORD>");
+			REQUIRE(renamed->get_message_record().get_field_count() == 1);
+
+			REQUIRE(module->get_message_template("MSG_B")->get_record().get_field_count() == 0);
+			const auto &record = module->get_message_template("MSG_C")->get_record();
+			REQUIRE(record.get_field<ki::dml::INT>("RECORDS")->get_value() == -7);
+		}
+	}
+
+	SECTION("Lazily loaded templates translate entities in their metadata")
+	{
+		dml::MessageManager lazy_manager;
+		lazy_manager.set_load_templates_lazily(true);
+		const auto *lazy_template = lazy_manager.load_module("samples/lazy-module.xml")
+			->get_message_template("MSG_RENAMED");
+		const auto *template_ = manager.load_module("samples/lazy-module.xml")
+			->get_message_template("MSG_RENAMED");
+		REQUIRE(lazy_template->get_handler() == template_->get_handler());
+		REQUIRE(lazy_template->get_name() == template_->get_name());
+	}
+
+	SECTION("Missing and empty files are rejected")
+	{
+		REQUIRE_THROWS_AS(manager.load_module("missing-module.xml"), value_error);
+
+		REQUIRE_THROWS_AS(manager.load_module("samples/empty-module.xml"), parse_error);
+	}
+}
+
+/**
+ * Writes a module with one INT field per template to a file.
+ */
+static void write_reload_module(const std::string &filepath,
+	const std::vector<std::pair<std::string, int>> &templates)
+{
+	std::ofstream ofs(filepath, std::ios::binary);
+	ofs << "<Messages><_ProtocolInfo><RECORD>"
+		"<ServiceID TYPE=\"UBYT\">11</ServiceID>"
+		"<ProtocolType TYPE=\"STR\">RELOAD</ProtocolType>"
+		"</RECORD></_ProtocolInfo>\n";
+	for (const auto &message_template : templates)
+		ofs << "<" << message_template.first << "><RECORD><Value TYPE=\"INT\">"
+			<< message_template.second << "</Value></RECORD></"
+			<< message_template.first << ">\n";
+	ofs << "</Messages>\n";
+}
+
+TEST_CASE("Message Module Reloading", "[dml]")
+{
+	const TemporaryFile module_file("module-reload.xml");
+	write_reload_module(module_file.get_path(), { { "MSG_A", 1 }, { "MSG_B", 2 }, { "MSG_C", 3 } });
+	dml::MessageManager manager;
+	const auto *original = manager.load_module(module_file.get_path());
+
+	SECTION("Templates are compared with the replaced module")
+	{
+		std::unique_ptr<dml::Message> message(manager.create_message("RELOAD", "MSG_B"));
+		REQUIRE(message->get_template()->get_message_count() == 1);
+
+		write_reload_module(module_file.get_path(), { { "MSG_A", 1 }, { "MSG_B", 20 }, { "MSG_D", 4 } });
+		const auto diff = manager.reload_module(module_file.get_path());
+		REQUIRE(diff.added == std::vector<std::string>{ "MSG_D" });
+		REQUIRE(diff.removed == std::vector<std::string>{ "MSG_C" });
+		REQUIRE(diff.changed == std::vector<std::string>{ "MSG_B" });
+
+		const auto *reloaded = manager.get_module(11);
+		REQUIRE(reloaded != original);
+		REQUIRE(manager.get_module("RELOAD") == reloaded);
+		REQUIRE(manager.get_modules().size() == 1);
+		REQUIRE(reloaded->get_message_template("MSG_D")->get_type() == 3);
+
+		// The replaced module is kept until its last message is gone
+		REQUIRE(manager.collect_retired() == 1);
+		REQUIRE(message->get_template()->get_name() == "MSG_B");
+		REQUIRE(message->get_record()->get_field<ki::dml::INT>("Value")->get_value() == 2);
+		message.reset();
+		REQUIRE(manager.collect_retired() == 0);
+	}
+
+	SECTION("Modules can be reloaded on another thread")
+	{
+		manager.set_load_templates_lazily(true);
+		auto future = manager.reload_module_async(module_file.get_path());
+		const auto diff = future.get();
+		REQUIRE(diff.added.empty());
+		REQUIRE(diff.removed.empty());
+		REQUIRE(diff.changed.empty());
+		REQUIRE(manager.get_module(11)->get_load_time().count() >= 0);
+		REQUIRE(manager.collect_retired() == 0);
+	}
+
+	SECTION("Retired modules can be collected while other threads create messages")
+	{
+		std::atomic<bool> stop(false);
+		std::atomic<size_t> created(0);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&manager, &stop, &created]()
+			{
+				while (!stop.load())
+				{
+					std::unique_ptr<dml::Message> message(manager.create_message("RELOAD", "MSG_A"));
+					if (message->get_record()->get_field<ki::dml::INT>("Value")->get_value() == 1)
+						++created;
+				}
+			});
+		}
+
+		// Keep going until the other threads have had a chance to run
+		for (int i = 0; i < 50 || created.load() < 100; ++i)
+		{
+			manager.reload_module(module_file.get_path());
+			manager.collect_retired();
+		}
+		stop = true;
+		for (auto &thread : threads)
+			thread.join();
+
+		REQUIRE(manager.collect_retired() == 0);
+	}
+
+	SECTION("Lazily loaded templates don't read from their file again")
+	{
+		dml::MessageManager lazy_manager;
+		lazy_manager.set_load_templates_lazily(true);
+		const auto *lazy_original = lazy_manager.load_module(module_file.get_path());
+
+		// An edit that keeps the file the same length
+		write_reload_module(module_file.get_path(), { { "MSG_A", 1 }, { "MSG_B", 7 }, { "MSG_C", 3 } });
+		const auto diff = lazy_manager.reload_module(module_file.get_path());
+		REQUIRE(diff.changed == std::vector<std::string>{ "MSG_B" });
+		const auto &original_record = lazy_original->get_message_template("MSG_B")->get_record();
+		REQUIRE(original_record.get_field<ki::dml::INT>("Value")->get_value() == 2);
+
+		// An edit that truncates the file
+		write_reload_module(module_file.get_path(), { { "MSG_A", 1 } });
+		const auto &truncated_record = lazy_original->get_message_template("MSG_C")->get_record();
+		REQUIRE(truncated_record.get_field<ki::dml::INT>("Value")->get_value() == 3);
+	}
+
+	SECTION("Modules that would replace two others are rejected")
+	{
+		manager.add_module(new dml::MessageModule(12, "OTHER"));
+		REQUIRE_THROWS_AS(manager.replace_module(new dml::MessageModule(11, "OTHER")), value_error);
+		REQUIRE(manager.get_module(11) == original);
+
+		const auto diff = manager.replace_module(new dml::MessageModule(13, "NEW"));
+		REQUIRE(diff.added.empty());
+		REQUIRE(manager.get_module("NEW")->get_service_id() == 13);
+	}
+}
+
+TEST_CASE("Fingerprint Tables", "[dml]")
+{
+	dml::MessageManager manager;
+	manager.load_module("samples/reload-module.xml");
+	const dml::FingerprintTable table(manager);
+	REQUIRE(table.get_fingerprint() == manager.get_fingerprint());
+	REQUIRE(table.get_module_fingerprint(11) == manager.get_module(11)->get_fingerprint());
+	REQUIRE(table.get_template_fingerprint(11, 2) ==
+		manager.get_module(11)->get_message_template("MSG_B")->get_fingerprint());
+	REQUIRE(table.get_template_fingerprint(11, 3) == 0);
+	REQUIRE(table.get_module_fingerprint(12) == 0);
+
+	SECTION("Lazily loaded templates have the same fingerprints")
+	{
+		dml::MessageManager lazy_manager;
+		lazy_manager.set_load_templates_lazily(true);
+		lazy_manager.load_module("samples/reload-module.xml");
+		REQUIRE(lazy_manager.get_fingerprint() == manager.get_fingerprint());
+		REQUIRE(!lazy_manager.get_module(11)->get_message_template(1)->is_record_loaded());
+	}
+
+	SECTION("Tables can be sent to another process")
+	{
+		std::stringstream ss;
+		table.write_to(ss);
+		REQUIRE(ss.str().size() == table.get_size());
+
+		dml::FingerprintTable received;
+		received.read_from(ss);
+		REQUIRE(received.get_fingerprint() == table.get_fingerprint());
+		REQUIRE(received.get_template_fingerprint(11, 1) == table.get_template_fingerprint(11, 1));
+		REQUIRE(table.compare(received).empty());
+
+		std::istringstream truncated(ss.str().substr(0, 20));
+		REQUIRE_THROWS_AS(received.read_from(truncated), parse_error);
+		REQUIRE(received.get_fingerprint() == table.get_fingerprint());
+	}
+
+	SECTION("Differences are found by service ID and message type")
+	{
+		dml::MessageManager other_manager;
+		other_manager.load_module("samples/reload-changed-module.xml");
+		other_manager.add_module(new dml::MessageModule(12, "OTHER"));
+		const auto mismatches = table.compare(dml::FingerprintTable(other_manager));
+		REQUIRE(mismatches.size() == 3);
+		REQUIRE(mismatches[0].service_id == 11);
+		REQUIRE(mismatches[0].message_type == 2);
+		REQUIRE(mismatches[1].message_type == 3);
+		REQUIRE(mismatches[2].service_id == 12);
+		REQUIRE(mismatches[2].message_type == 0);
+	}
+}
+
+TEST_CASE("Message Module Builder", "[dml]")
+{
+	dml::MessageModuleBuilder builder(12, "BUILT");
+	for (int i = 99; i >= 0; --i)
+	{
+		auto *record = new ki::dml::Record();
+		record->add_field<ki::dml::INT>("Value")->set_value(i);
+		builder.add_message_template("MSG_" + std::to_string(1000 + i), record);
+	}
+	REQUIRE(builder.get_template_count() == 100);
+
+	SECTION("Unordered templates are typed in alphabetical order")
+	{
+		std::unique_ptr<dml::MessageModule> module(builder.build());
+		REQUIRE(builder.get_template_count() == 0);
+		REQUIRE(module->get_service_id() == 12);
+		REQUIRE(module->get_message_template("MSG_1000")->get_type() == 1);
+		REQUIRE(module->get_message_template(100)->get_name() == "MSG_1099");
+	}
+
+	SECTION("Modules can be added to a manager")
+	{
+		dml::MessageManager manager;
+		const auto *module = manager.add_module(builder.build());
+		REQUIRE(module == manager.get_module("BUILT"));
+
+		auto *message = manager.create_message(12, "MSG_1042");
+		REQUIRE(message->get_record()->get_field<ki::dml::INT>("Value")->get_value() == 42);
+		delete message;
+
+		REQUIRE_THROWS_AS(manager.add_module(new dml::MessageModule(12, "OTHER")), value_error);
+	}
+
+	SECTION("Invalid message orders are rejected")
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			auto *record = new ki::dml::Record();
+			record->add_field<ki::dml::UBYT>("_MsgOrder", false)->set_value(200);
+			builder.add_message_template("MSG_ORDERED_" + std::to_string(i), record);
+		}
+		REQUIRE_THROWS_AS(builder.build(), value_error);
+		REQUIRE(builder.get_template_count() == 0);
+	}
+}
+
+TEST_CASE("Session Send Queue", "[net]")
+{
+	// Each keep alive is framed into 14 bytes.
+	TestSession session;
+	control::ServerKeepAlive keep_alive(0xAABBCCDD);
+
+	SECTION("Packets are written immediately when the queue is disabled")
+	{
+		session.send_packet(true, 3, keep_alive);
+		REQUIRE(session.writes.size() == 1);
+		REQUIRE(session.writes[0].size() == 14);
+		REQUIRE(session.writes[0].substr(0, 4) == std::string("\x0D\xF0\x0A\x00", 4));
+	}
+
+	SECTION("Queued packets are coalesced into a single write")
+	{
+		session.set_send_queue_enabled(true);
+		for (int i = 0; i < 3; ++i)
+			session.send_packet(true, 3, keep_alive);
+		REQUIRE(session.writes.empty());
+		REQUIRE(session.get_queued_packets() == 3);
+		REQUIRE(session.get_queued_bytes() == 42);
+
+		REQUIRE(session.flush_send_queue(30) == 28);
+		REQUIRE(session.flush_send_queue() == 14);
+		REQUIRE(session.writes.size() == 2);
+		REQUIRE(session.get_queued_bytes() == 0);
+	}
+
+	SECTION("The DROP policy discards packets until the queue drains")
+	{
+		session.set_send_queue_enabled(true);
+		session.set_send_queue_limits(28, 100, 0);
+		session.set_send_queue_policy(net::SendQueuePolicy::DROP);
+		for (int i = 0; i < 4; ++i)
+			session.send_packet(true, 3, keep_alive);
+		REQUIRE(session.get_queued_packets() == 2);
+		REQUIRE(session.high_count == 1);
+
+		session.flush_send_queue();
+		REQUIRE(session.low_count == 1);
+		REQUIRE_FALSE(session.is_send_queue_over_limits());
+	}
+
+	SECTION("Small packets are coalesced until the threshold is reached")
+	{
+		session.set_coalescing(std::chrono::seconds(10), 40);
+		session.send_packet(false, 0, keep_alive);
+		session.send_packet(false, 0, keep_alive);
+		REQUIRE(session.writes.empty());
+
+		session.send_packet(false, 0, keep_alive);
+		REQUIRE(session.writes.size() == 1);
+		REQUIRE(session.writes[0].size() == 42);
+	}
+
+	SECTION("Urgent packets are written along with coalesced packets")
+	{
+		session.set_coalescing(std::chrono::seconds(10), 1000);
+		session.send_packet(false, 0, keep_alive);
+		REQUIRE(session.writes.empty());
+		REQUIRE_FALSE(session.flush_expired());
+
+		session.send_packet(false, 0, keep_alive, true);
+		REQUIRE(session.writes.size() == 1);
+		REQUIRE(session.writes[0].size() == 28);
+	}
+
+	SECTION("The CLOSE policy closes the session")
+	{
+		session.set_send_queue_enabled(true);
+		session.set_send_queue_limits(1000, 1, 0);
+		session.set_send_queue_policy(net::SendQueuePolicy::CLOSE);
+		session.send_packet(true, 3, keep_alive);
+		session.send_packet(true, 3, keep_alive);
+		REQUIRE(session.close_error == net::SessionCloseErrorCode::SEND_QUEUE_OVERFLOW);
+	}
+}
+
+/**
+ * A DMLSession that records everything it writes, and the
+ * "Value" of every message that it handles.
+ */
+class TestDMLSession : public net::DMLSession
+{
+public:
+	explicit TestDMLSession(const dml::MessageManager &manager)
+		: Session(0), DMLSession(0, manager) {}
+
+	~TestDMLSession()
+	{
+		stop_dispatch();
+	}
+
+	bool is_alive() const override { return true; }
+
+	void receive(const char *data, const size_t size)
+	{
+		process_data(data, size);
+	}
+
+	std::vector<std::string> writes;
+	size_t handled_messages = 0;
+	std::vector<int32_t> handled_values;
+	std::vector<std::thread::id> handler_threads;
+	std::atomic<size_t> posted_notifications { 0 };
+
+	// Whether handled messages are sent back with post_message
+	bool echo = false;
+protected:
+	void send_packet_data(const char *data, const size_t size) override
+	{
+		writes.push_back(std::string(data, size));
+	}
+
+	void close(const net::SessionCloseErrorCode) override {}
+
+	void on_message(const dml::Message *message) override
+	{
+		handled_messages++;
+		handler_threads.push_back(std::this_thread::get_id());
+		const auto *value = message->get_record()->get_field<ki::dml::INT>("Value");
+		if (value)
+			handled_values.push_back(value->get_value());
+		if (echo)
+			post_message(*message);
+	}
+
+	void on_messages_posted() override
+	{
+		posted_notifications++;
+	}
+};
+
+/**
+ * Frames count MSG_A messages from the "TEST" module, with
+ * values from first onwards, into a single buffer.
+ */
+std::string write_test_packets(const dml::MessageManager &manager,
+	const int first, const int count)
+{
+	TestDMLSession sender(manager);
+	std::unique_ptr<dml::Message> message(manager.create_message("TEST", "MSG_A"));
+	for (int i = first; i < first + count; ++i)
+	{
+		message->get_record()->get_field<ki::dml::INT>("Value")->set_value(i);
+		sender.send_message(*message);
+	}
+
+	std::string data;
+	for (const auto &write : sender.writes)
+		data += write;
+	return data;
+}
+
+TEST_CASE("DML Dispatch Pools", "[net]")
+{
+	dml::MessageManager manager;
+	load_test_module(manager);
+	ki::util::WorkStealingPool pool(4);
+	TestDMLSession session(manager);
+	session.set_dispatch_pool(&pool);
+	REQUIRE(session.get_dispatch_pool() == &pool);
+
+	SECTION("Messages from one session are handled in order")
+	{
+		const auto data = write_test_packets(manager, 0, 500);
+
+		// Deliver the data in small pieces, as a transport would
+		for (size_t i = 0; i < data.size(); i += 7)
+			session.receive(data.data() + i, std::min<size_t>(7, data.size() - i));
+		session.wait_for_dispatch();
+
+		REQUIRE(session.handled_values.size() == 500);
+		for (int i = 0; i < 500; ++i)
+			REQUIRE(session.handled_values[i] == i);
+		for (const auto &thread : session.handler_threads)
+			REQUIRE(thread != std::this_thread::get_id());
+	}
+
+	SECTION("Handlers post messages to be flushed by the transport")
+	{
+		session.echo = true;
+		const auto data = write_test_packets(manager, 0, 20);
+		session.receive(data.data(), data.size());
+		session.wait_for_dispatch();
+		REQUIRE(session.writes.empty());
+		REQUIRE(session.posted_notifications == 1);
+
+		session.flush_posted_messages();
+		REQUIRE(session.writes.size() == 20);
+		std::string sent;
+		for (const auto &write : session.writes)
+			sent += write;
+		REQUIRE(sent == data);
+
+		// Flushing again sends nothing, and the next post notifies again
+		session.flush_posted_messages();
+		REQUIRE(session.writes.size() == 20);
+		session.receive(data.data(), data.size());
+		session.wait_for_dispatch();
+		REQUIRE(session.posted_notifications == 2);
+	}
+
+	SECTION("Switching pools handles every queued message first")
+	{
+		const auto first = write_test_packets(manager, 0, 200);
+		session.receive(first.data(), first.size());
+
+		ki::util::WorkStealingPool other_pool(2);
+		session.set_dispatch_pool(&other_pool);
+		REQUIRE(session.handled_values.size() == 200);
+
+		const auto second = write_test_packets(manager, 200, 200);
+		session.receive(second.data(), second.size());
+		session.stop_dispatch();
+		REQUIRE(session.get_dispatch_pool() == nullptr);
+		REQUIRE(session.handled_values.size() == 400);
+
+		// Without a pool, messages are handled before receive returns
+		const auto third = write_test_packets(manager, 400, 1);
+		session.receive(third.data(), third.size());
+		REQUIRE(session.handled_values.size() == 401);
+		REQUIRE(session.handler_threads.back() == std::this_thread::get_id());
+		for (int i = 0; i < 401; ++i)
+			REQUIRE(session.handled_values[i] == i);
+	}
+}
+
+TEST_CASE("DML Handler Tables", "[net]")
+{
+	dml::MessageManager manager;
+	load_test_module(manager);
+	const auto *test_module = manager.get_module("TEST");
+	const auto type_a = test_module->get_message_template("MSG_A")->get_type();
+	const auto type_b = test_module->get_message_template("MSG_B")->get_type();
+	const auto type_c = test_module->get_message_template("MSG_C")->get_type();
+
+	std::vector<std::string> calls;
+	net::DMLHandlerTable table;
+	table.register_handler("MSG_A", [&calls](net::DMLSession &, const dml::Message &message)
+	{
+		calls.push_back("A:" + std::to_string(message.get_record()->get_field<ki::dml::INT>("Value")->get_value()));
+	});
+	table.register_handler("MSG_Test", [&calls](net::DMLSession &, const dml::Message &message)
+	{
+		calls.push_back("C:" + std::to_string(message.get_type()));
+	});
+
+	SECTION("Handlers are bound by service ID and message type")
+	{
+		REQUIRE(table.get_handler(7, type_a) == nullptr);
+		table.bind(manager);
+		REQUIRE(table.get_handler(7, type_a) != nullptr);
+		REQUIRE(table.get_handler(7, type_c) != nullptr);
+		REQUIRE(table.get_handler(7, type_a) != table.get_handler(7, type_c));
+		REQUIRE(table.get_handler(7, type_b) == nullptr);
+		REQUIRE(table.get_handler(8, type_a) == nullptr);
+	}
+
+	SECTION("Unregistered handlers are caught when binding")
+	{
+		try
+		{
+			table.bind(manager, true);
+			FAIL("bind should have thrown");
+		}
+		catch (value_error &e)
+		{
+			REQUIRE(e.get_error_code() == value_error::DML_UNREGISTERED_HANDLER);
+		}
+		REQUIRE(table.get_handler(7, type_a) == nullptr);
+
+		table.register_handler("MSG_B", [](net::DMLSession &, const dml::Message &) {});
+		table.bind(manager, true);
+		REQUIRE(table.get_handler(7, type_b) != nullptr);
+	}
+
+	SECTION("Handlers that no template uses are rejected")
+	{
+		table.register_handler("MSG_Typo", [](net::DMLSession &, const dml::Message &) {});
+		try
+		{
+			table.bind(manager);
+			FAIL("bind should have thrown");
+		}
+		catch (value_error &e)
+		{
+			REQUIRE(e.get_error_code() == value_error::DML_UNKNOWN_HANDLER);
+		}
+	}
+
+	SECTION("Sessions route messages through the table")
+	{
+		table.bind(manager);
+		TestDMLSession sender(manager);
+		std::unique_ptr<dml::Message> message_a(manager.create_message("TEST", "MSG_A"));
+		message_a->get_record()->get_field<ki::dml::INT>("Value")->set_value(42);
+		std::unique_ptr<dml::Message> message_b(manager.create_message("TEST", "MSG_B"));
+		std::unique_ptr<dml::Message> message_c(manager.create_message("TEST", "MSG_C"));
+		sender.send_message(*message_a);
+		sender.send_message(*message_b);
+		sender.send_message(*message_c);
+
+		TestDMLSession session(manager);
+		REQUIRE(session.get_handler_table() == nullptr);
+		for (const auto &write : sender.writes)
+			session.receive(write.data(), write.size());
+		REQUIRE(calls.empty());
+		REQUIRE(session.handled_messages == 3);
+
+		// Only messages without a bound handler fall back to on_message
+		session.set_handler_table(&table);
+		REQUIRE(session.get_handler_table() == &table);
+		for (const auto &write : sender.writes)
+			session.receive(write.data(), write.size());
+		REQUIRE(calls == std::vector<std::string>({ "A:42", "C:" + std::to_string(type_c) }));
+		REQUIRE(session.handled_messages == 4);
+	}
+
+	SECTION("Registered handlers take effect when the table is bound again")
+	{
+		table.bind(manager);
+		TestDMLSession session(manager);
+		std::unique_ptr<dml::Message> message(manager.create_message("TEST", "MSG_A"));
+		table.register_handler("MSG_A", [&calls](net::DMLSession &, const dml::Message &)
+		{
+			calls.push_back("new");
+		});
+		REQUIRE(table.dispatch(session, *message));
+		table.bind(manager);
+		table.collect_retired();
+		REQUIRE(table.dispatch(session, *message));
+		REQUIRE(calls == std::vector<std::string>({ "A:0", "new" }));
+	}
+
+	SECTION("Tables bound before a module is replaced are out of date")
+	{
+		REQUIRE_FALSE(table.is_current(manager));
+		table.bind(manager);
+		REQUIRE(table.is_current(manager));
+
+		dml::MessageManager other_manager;
+		load_test_module(other_manager);
+		REQUIRE_FALSE(table.is_current(other_manager));
+
+		manager.replace_module(new dml::MessageModule(12, "OTHER"));
+		REQUIRE_FALSE(table.is_current(manager));
+		table.bind(manager);
+		REQUIRE(table.is_current(manager));
+	}
+
+	SECTION("Tables can be bound again while messages are dispatched")
+	{
+		std::atomic<size_t> handled(0);
+		net::DMLHandlerTable concurrent_table;
+		concurrent_table.register_handler("MSG_A", [&handled](net::DMLSession &, const dml::Message &)
+		{
+			++handled;
+		});
+		concurrent_table.bind(manager);
+
+		TestDMLSession session(manager);
+		std::unique_ptr<dml::Message> message(manager.create_message("TEST", "MSG_A"));
+		std::atomic<bool> stop(false);
+		std::atomic<bool> missed(false);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&]()
+			{
+				while (!stop.load())
+				{
+					if (!concurrent_table.dispatch(session, *message))
+						missed = true;
+				}
+			});
+		}
+
+		// Keep going until the other threads have had a chance to run
+		for (int i = 0; i < 50 || handled.load() < 100; ++i)
+		{
+			concurrent_table.bind(manager);
+			concurrent_table.collect_retired();
+		}
+		stop = true;
+		for (auto &thread : threads)
+			thread.join();
+
+		REQUIRE_FALSE(missed.load());
+	}
+}
+
+TEST_CASE("Session Statistics", "[net]")
+{
+	TestSession session;
+	control::ServerKeepAlive keep_alive(0xAABBCCDD);
+
+	SECTION("Frames and bytes are counted in both directions")
+	{
+		session.send_packet(true, 3, keep_alive);
+		session.send_packet(false, 0, keep_alive);
+		session.receive(session.writes[0].data(), session.writes[0].size());
+		session.receive("\x00\x00", 2);
+
+		const auto statistics = session.get_statistics();
+		REQUIRE(statistics.frames_sent == 2);
+		REQUIRE(statistics.bytes_sent == 28);
+		REQUIRE(statistics.control_messages_sent == 1);
+		REQUIRE(statistics.application_messages_sent == 1);
+		REQUIRE(statistics.frames_received == 1);
+		REQUIRE(statistics.bytes_received == 16);
+		REQUIRE(statistics.control_messages_received == 1);
+		REQUIRE(statistics.application_messages_received == 0);
+		REQUIRE(statistics.invalid_packets == 1);
+	}
+
+	SECTION("Round trip times are smoothed and bucketed")
+	{
+		REQUIRE(session.get_statistics().get_rtt_percentile(0.5).count() == 0);
+		session.add_rtt_sample(std::chrono::microseconds(1000));
+		session.add_rtt_sample(std::chrono::microseconds(2000));
+
+		const auto statistics = session.get_statistics();
+		REQUIRE(statistics.rtt_samples == 2);
+		REQUIRE(statistics.last_rtt.count() == 2000);
+		REQUIRE(statistics.smoothed_rtt.count() == 1125);
+		REQUIRE(statistics.rtt_jitter.count() == 625);
+		REQUIRE(statistics.rtt_histogram[9] == 1);
+		REQUIRE(statistics.rtt_histogram[10] == 1);
+		REQUIRE(statistics.get_rtt_percentile(0.5).count() == 1024);
+		REQUIRE(statistics.get_rtt_percentile(1.0).count() == 2048);
+	}
+
+	SECTION("Decode errors are counted by error code")
+	{
+		dml::MessageManager manager;
+		TestDMLSession dml_session(manager);
+
+		// An application packet for a service that doesn't exist
+		dml_session.receive("\x0D\xF0\x08\x00\x00\x00\x00\x00\x63\x01\x04\x00", 12);
+		const auto statistics = dml_session.get_statistics();
+		REQUIRE(statistics.application_messages_received == 1);
+		REQUIRE(statistics.get_decode_errors(net::InvalidDMLMessageErrorCode::INVALID_SERVICE) == 1);
+		REQUIRE(statistics.get_decode_errors(net::InvalidDMLMessageErrorCode::INVALID_MESSAGE_DATA) == 0);
+	}
+}
+
+TEST_CASE("DML Message Statistics", "[net]")
+{
+	dml::MessageManager manager;
+	manager.load_module("samples/reload-module.xml");
+
+	net::DMLStatistics statistics;
+	TestDMLSession session(manager);
+	session.set_message_statistics(&statistics);
+	REQUIRE(session.get_message_statistics() == &statistics);
+
+	std::unique_ptr<dml::Message> message(manager.create_message("RELOAD", "MSG_B"));
+	session.send_message(*message);
+	session.send_message(*message);
+	session.receive(session.writes[0].data(), session.writes[0].size());
+	REQUIRE(session.handled_messages == 1);
+
+	SECTION("Messages are counted by service ID and type")
+	{
+		const auto snapshot = statistics.get_snapshot();
+		REQUIRE(snapshot.size() == 1);
+		REQUIRE(snapshot[0].service_id == 11);
+		REQUIRE(snapshot[0].message_type == 2);
+		REQUIRE(snapshot[0].messages_decoded == 1);
+		REQUIRE(snapshot[0].bytes_decoded == message->get_size());
+		REQUIRE(snapshot[0].messages_handled == 1);
+		REQUIRE(snapshot[0].messages_encoded == 2);
+		REQUIRE(snapshot[0].bytes_encoded == 2 * message->get_size());
+	}
+
+	SECTION("Sessions without statistics are not counted")
+	{
+		session.set_message_statistics(nullptr);
+		session.send_message(*message);
+		session.receive(session.writes[0].data(), session.writes[0].size());
+		REQUIRE(session.handled_messages == 2);
+
+		const auto snapshot = statistics.get_snapshot();
+		REQUIRE(snapshot[0].messages_decoded == 1);
+		REQUIRE(snapshot[0].messages_encoded == 2);
+	}
+
+	SECTION("Messages dropped by the send queue are not counted")
+	{
+		session.set_send_queue_enabled(true);
+		session.set_send_queue_policy(net::SendQueuePolicy::DROP);
+		session.set_send_queue_limits(1024, 1, 0);
+		session.send_message(*message);
+		session.send_message(*message);
+		session.post_message(*message);
+		session.flush_posted_messages();
+		REQUIRE(session.get_queued_packets() == 1);
+
+		const auto snapshot = statistics.get_snapshot();
+		REQUIRE(snapshot[0].messages_encoded == 3);
+		REQUIRE(snapshot[0].bytes_encoded == 3 * message->get_size());
+	}
+
+	SECTION("Snapshots can be exported")
+	{
+		std::ostringstream json;
+		statistics.write_json(json, &manager);
+		REQUIRE(json.str().find(
+			"{\"service_id\":11,\"message_type\":2,\"protocol_type\":\"RELOAD\","
+			"\"message_name\":\"MSG_B\",\"messages_decoded\":1,\"bytes_decoded\":8,") == 1);
+		REQUIRE(json.str().find("\"messages_encoded\":2,\"bytes_encoded\":16}]") != std::string::npos);
+
+		std::ostringstream text;
+		statistics.write_text(text, &manager);
+		REQUIRE(text.str().find("RELOAD::MSG_B") != std::string::npos);
+	}
+}
+
+TEST_CASE("Packet Capture", "[net]")
+{
+	control::ServerKeepAlive keep_alive(0xAABBCCDD);
+	const TemporaryFile capture_file("capture.kicap");
+	{
+		net::CaptureWriter writer(capture_file.get_path());
+		TestSession session;
+		session.set_capture_writer(&writer);
+		for (int i = 0; i < 3; ++i)
+			session.send_packet(true, 3, keep_alive);
+
+		// Deliver the packets back to ourselves one byte at a time
+		std::string data;
+		for (auto it = session.writes.begin(); it != session.writes.end(); ++it)
+			data += *it;
+		for (size_t i = 0; i < data.size(); ++i)
+			session.receive(&data[i], 1);
+		REQUIRE(writer.get_frame_count() == 6);
+	}
+
+	net::CaptureReader reader(capture_file.get_path());
+	net::CaptureFrame frame;
+	TestSession replay;
+	for (int i = 0; i < 6; ++i)
+	{
+		REQUIRE(reader.next(frame));
+		REQUIRE(frame.size == 14);
+		REQUIRE(frame.direction == (i < 3 ?
+			net::CaptureDirection::OUTBOUND : net::CaptureDirection::INBOUND));
+		replay.receive(frame.data, frame.size);
+	}
+	REQUIRE_FALSE(reader.next(frame));
+	REQUIRE_FALSE(reader.is_truncated());
+	REQUIRE(replay.packets_received == 6);
+}